@@ -6,7 +6,13 @@
 
 #include <iostream>
 #include <string>
+#include <vector>
+#include <memory>
+#include <thread>
 #include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
 #include <sys/ioctl.h>
 #include <unistd.h>
 #include <termios.h>
@@ -16,10 +22,20 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 using namespace std;
 
 // ====================== 常量定义 ======================
 const string kTerminalResetSequence = "\033[0m";  // 重置终端颜色和样式
+const string kClearScreenSequence = "\033[H\033[2J\033[3J";  // 光标回到左上角，清屏并清除回滚缓冲区(与clear命令相同)
+const string kEraseLineSequence = "\033[K";       // 清除光标到行尾
+const int kImageTopRow = 3;                        // 图片从第3行开始，前两行是信息行
+const int kMinRowsPerThread = 8;                   // 缩放时每个线程至少处理的目标行数，行太少时不值得开线程
+const string kUpperHalfBlock = "\u2580";            // 上半块字符"▀"，前景色画上半格，背景色画下半格
+const int32_t kDefaultColor = -1;                  // 终端默认颜色
 
 // ====================== 终端控制相关 ======================
 
@@ -68,96 +84,644 @@ bool CheckForEscapeKeyPress() {
     return escape_pressed;
 }
 
+// ====================== 帧缓冲相关 ======================
+
+/**
+ * @brief 0-255的十进制表示表，不补零，例如 7 -> "7"
+ */
+struct DecimalDigitTable {
+    char digits[256][3];     // 各位数字，左对齐
+    unsigned char length[256]; // 位数
+};
+
+/**
+ * @brief 在编译期生成十进制表，格式化颜色分量时只需拷贝最多3个字节
+ * @return 生成的表
+ */
+constexpr DecimalDigitTable BuildDecimalDigitTable() {
+    DecimalDigitTable table = {};
+    for (int value = 0; value < 256; ++value) {
+        int length = value >= 100 ? 3 : value >= 10 ? 2 : 1;
+        int remaining = value;
+        for (int i = length - 1; i >= 0; --i) {
+            table.digits[value][i] = static_cast<char>('0' + remaining % 10);
+            remaining /= 10;
+        }
+        table.length[value] = static_cast<unsigned char>(length);
+    }
+    return table;
+}
+
+constexpr DecimalDigitTable kDecimalDigits = BuildDecimalDigitTable();
+
+/**
+ * @brief 帧合成器：把一整帧的文本和转义码写进一块预先分配的缓冲区，再用一次write(2)输出
+ * @details 合成过程中不做堆分配，也不经过iostream，重绘的耗时只取决于终端的吞吐量；
+ *          记住终端当前的前景色和背景色，颜色没有变化时不重复输出转义序列
+ */
+class FrameComposer {
+public:
+    /**
+     * @brief 清空缓冲区并保证至少能容纳指定字节数，已有的容量会保留给下一帧
+     * @param capacity 本帧预计的最大字节数
+     */
+    void Begin(size_t capacity) {
+        if (buffer_.size() < capacity) {
+            buffer_.resize(capacity);
+        }
+        size_ = 0;
+        foreground_ = kDefaultColor;
+        background_ = kDefaultColor;
+    }
+
+    /**
+     * @brief 追加任意字节
+     * @param data 数据起始地址
+     * @param length 字节数
+     */
+    void Append(const char* data, size_t length) {
+        Reserve(length);
+        memcpy(buffer_.data() + size_, data, length);
+        size_ += length;
+    }
+
+    /**
+     * @brief 追加字符串
+     * @param text 要追加的文本
+     */
+    void Append(const string& text) {
+        Append(text.data(), text.size());
+    }
+
+    /**
+     * @brief 追加一个非负整数的十进制表示（不补零）
+     * @param value 要追加的数
+     */
+    void AppendNumber(int value) {
+        char digits[16];
+        int count = 0;
+        do {
+            digits[count++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value > 0 && count < 16);
+        Reserve(count);
+        while (count > 0) {
+            buffer_[size_++] = digits[--count];
+        }
+    }
+
+    /**
+     * @brief 把RGB打包成一个颜色值
+     * @param pixel RGB三个字节
+     * @return 0xRRGGBB
+     */
+    static int32_t PackColor(const unsigned char* pixel) {
+        return (pixel[0] << 16) | (pixel[1] << 8) | pixel[2];
+    }
+
+    /**
+     * @brief 设置之后输出的字符的前景色和背景色，只输出有变化的部分，两者都变时合并成一个转义序列
+     * @param foreground 前景色(0xRRGGBB)，kDefaultColor为终端默认颜色
+     * @param background 背景色(0xRRGGBB)，kDefaultColor为终端默认颜色
+     */
+    void SetColors(int32_t foreground, int32_t background) {
+        bool foreground_changed = foreground != foreground_;
+        bool background_changed = background != background_;
+        if (!foreground_changed && !background_changed) {
+            return;
+        }
+        Reserve(kMaxColorSequenceLength);
+        char* out = buffer_.data() + size_;
+        *out++ = '\033';
+        *out++ = '[';
+        if (foreground_changed) {
+            out = WriteColor(out, '3', foreground);
+        }
+        if (foreground_changed && background_changed) {
+            *out++ = ';';
+        }
+        if (background_changed) {
+            out = WriteColor(out, '4', background);
+        }
+        *out++ = 'm';
+        size_ = out - buffer_.data();
+        foreground_ = foreground;
+        background_ = background;
+    }
+
+    /**
+     * @brief 把光标移到指定位置
+     * @param row 行号，从1开始
+     * @param col 列号，从1开始
+     */
+    void MoveCursor(int row, int col) {
+        Append("\033[", 2);
+        AppendNumber(row);
+        Append(";", 1);
+        AppendNumber(col);
+        Append("H", 1);
+    }
+
+    /**
+     * @brief 恢复终端默认颜色（已经是默认颜色时不输出）
+     */
+    void ResetColors() {
+        if (foreground_ != kDefaultColor || background_ != kDefaultColor) {
+            Append(kTerminalResetSequence);
+            foreground_ = kDefaultColor;
+            background_ = kDefaultColor;
+        }
+    }
+
+    /**
+     * @brief 用write(2)把缓冲区写到标准输出，处理部分写入和信号中断
+     * @return 全部写出返回true，写入出错返回false
+     */
+    bool Flush() {
+        size_t written = 0;
+        while (written < size_) {
+            ssize_t result = write(STDOUT_FILENO, buffer_.data() + written, size_ - written);
+            if (result < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            written += static_cast<size_t>(result);
+        }
+        size_ = 0;
+        return true;
+    }
+
+    // 一个颜色转义序列的最大字节数："\033[38;2;RRR;GGG;BBB;48;2;RRR;GGG;BBBm"
+    static const size_t kMaxColorSequenceLength = 36;
+
+private:
+    vector<char> buffer_;                   // 帧缓冲区
+    size_t size_ = 0;                       // 已写入的字节数
+    int32_t foreground_ = kDefaultColor;    // 终端当前的前景色
+    int32_t background_ = kDefaultColor;    // 终端当前的背景色
+
+    /**
+     * @brief 写出一个颜色参数："38;2;R;G;B"、"48;2;R;G;B"，默认颜色为"39"、"49"
+     * @param out 写入位置
+     * @param layer '3'为前景色，'4'为背景色
+     * @param color 颜色值
+     * @return 写完后的位置
+     */
+    static char* WriteColor(char* out, char layer, int32_t color) {
+        *out++ = layer;
+        if (color == kDefaultColor) {
+            *out++ = '9';
+            return out;
+        }
+        memcpy(out, "8;2", 3);
+        out += 3;
+        for (int shift = 16; shift >= 0; shift -= 8) {
+            int component = (color >> shift) & 0xFF;
+            *out++ = ';';
+            memcpy(out, kDecimalDigits.digits[component], 3);
+            out += kDecimalDigits.length[component];
+        }
+        return out;
+    }
+
+    /**
+     * @brief 保证还能再写入length字节，预估不足时按倍数扩容
+     * @param length 将要写入的字节数
+     */
+    void Reserve(size_t length) {
+        if (size_ + length > buffer_.size()) {
+            buffer_.resize(max(buffer_.size() * 2, size_ + length));
+        }
+    }
+};
+
+// ====================== 图片缓存相关 ======================
+
+/**
+ * @brief 图片金字塔中的一级：RGB三通道，按行连续存放
+ */
+struct ImageLevel {
+    int width = 0;                         // 宽度(像素)
+    int height = 0;                        // 高度(像素)
+    const unsigned char* pixels = nullptr; // 像素数据，指向下面两种存储之一
+    vector<unsigned char> storage;         // 缩小得到的各级自己保存像素
+};
+
+/**
+ * @brief 解码一次的图片缓存：第0级是原图，之后每级宽高各缩小一半(2x2取平均)，直到1x1
+ * @details 整个查看期间只读一次文件、解码一次；窗口大小变化时从不小于目标尺寸的最小一级重新采样，
+ *          采样量与终端大小而不是原图大小成正比，所有级加起来只比原图多约1/3的内存
+ */
+class ImagePyramid {
+public:
+    /**
+     * @brief 读取并解码图片，建立各级缩小图
+     * @param image_path 图片文件路径
+     * @return 成功返回true，无法加载返回false
+     */
+    bool Load(const string& image_path) {
+        int width, height, color_channels;
+        unsigned char* pixel_data = stbi_load(
+            image_path.c_str(),
+            &width,
+            &height,
+            &color_channels,
+            3  // 强制加载为RGB三通道
+        );
+        if (!pixel_data) {
+            return false;
+        }
+        original_.reset(pixel_data);
+
+        levels_.clear();
+        levels_.emplace_back();
+        levels_[0].width = width;
+        levels_[0].height = height;
+        levels_[0].pixels = pixel_data;
+        while (levels_.back().width > 1 || levels_.back().height > 1) {
+            levels_.emplace_back();
+            DownscaleByHalf(levels_[levels_.size() - 2], levels_.back());
+        }
+        return true;
+    }
+
+    /**
+     * @brief 原图
+     * @return 第0级
+     */
+    const ImageLevel& Original() const {
+        return levels_[0];
+    }
+
+    /**
+     * @brief 选择宽高都不小于目标尺寸的最小一级，从它采样既不丢细节又读得最少
+     * @param target_width 目标宽度
+     * @param target_height 目标高度
+     * @return 选中的级
+     */
+    const ImageLevel& LevelFor(int target_width, int target_height) const {
+        size_t chosen = 0;
+        while (chosen + 1 < levels_.size() &&
+               levels_[chosen + 1].width >= target_width &&
+               levels_[chosen + 1].height >= target_height) {
+            ++chosen;
+        }
+        return levels_[chosen];
+    }
+
+private:
+    unique_ptr<unsigned char, void (*)(void*)> original_{ nullptr, stbi_image_free };  // stbi解码出的原图
+    vector<ImageLevel> levels_;  // 各级，levels_[0]指向原图
+
+    /**
+     * @brief 宽高各缩小一半，每个目标像素取源图2x2块的平均值，奇数边的最后一行(列)与自身平均
+     * @param source 源级
+     * @param[out] target 目标级
+     */
+    static void DownscaleByHalf(const ImageLevel& source, ImageLevel& target) {
+        target.width = (source.width + 1) / 2;
+        target.height = (source.height + 1) / 2;
+        target.storage.resize(static_cast<size_t>(target.width) * target.height * 3);
+        size_t source_stride = static_cast<size_t>(source.width) * 3;
+
+        for (int y = 0; y < target.height; ++y) {
+            const unsigned char* top = source.pixels + static_cast<size_t>(2 * y) * source_stride;
+            const unsigned char* bottom = 2 * y + 1 < source.height ? top + source_stride : top;
+            unsigned char* out = target.storage.data() + static_cast<size_t>(y) * target.width * 3;
+            for (int x = 0; x < target.width; ++x) {
+                int left = 2 * x * 3;
+                int right = 2 * x + 1 < source.width ? left + 3 : left;
+                for (int channel = 0; channel < 3; ++channel) {
+                    int sum = top[left + channel] + top[right + channel] +
+                              bottom[left + channel] + bottom[right + channel];
+                    out[x * 3 + channel] = static_cast<unsigned char>((sum + 2) / 4);
+                }
+            }
+        }
+        target.pixels = target.storage.data();
+    }
+};
+
+// ====================== 图片缩放相关 ======================
+
+/**
+ * @brief 把一行源像素的各字节按位置累加到32位累加器：sums[i] += row[i]
+ * @param[in,out] sums 累加器，长度为length
+ * @param row 源图一行的字节(RGB交错)
+ * @param length 字节数
+ * @details 缩放时对每个目标行把它覆盖的源行逐行累加，源图按行顺序读取；SSE2下一次处理16字节
+ */
+void AccumulateRow(uint32_t* sums, const unsigned char* row, size_t length) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= length; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+        __m128i low = _mm_unpacklo_epi8(bytes, zero);   // 前8个字节扩展为16位
+        __m128i high = _mm_unpackhi_epi8(bytes, zero);  // 后8个字节扩展为16位
+        __m128i* out = reinterpret_cast<__m128i*>(sums + i);
+        _mm_storeu_si128(out, _mm_add_epi32(_mm_loadu_si128(out), _mm_unpacklo_epi16(low, zero)));
+        _mm_storeu_si128(out + 1, _mm_add_epi32(_mm_loadu_si128(out + 1), _mm_unpackhi_epi16(low, zero)));
+        _mm_storeu_si128(out + 2, _mm_add_epi32(_mm_loadu_si128(out + 2), _mm_unpacklo_epi16(high, zero)));
+        _mm_storeu_si128(out + 3, _mm_add_epi32(_mm_loadu_si128(out + 3), _mm_unpackhi_epi16(high, zero)));
+    }
+#endif
+    for (; i < length; ++i) {
+        sums[i] += row[i];
+    }
+}
+
+/**
+ * @brief 计算每个目标像素在源图一个方向上覆盖的范围 [begins[i], ends[i])，缩小时各范围首尾相接、覆盖整个源图
+ * @param source_length 源图在该方向上的像素数
+ * @param target_length 目标在该方向上的像素数
+ * @param[out] begins 每个目标像素覆盖范围的起点
+ * @param[out] ends 每个目标像素覆盖范围的终点(不含)，放大时至少覆盖一个像素
+ */
+void ComputeSpans(int source_length, int target_length, vector<int>& begins, vector<int>& ends) {
+    begins.resize(target_length);
+    ends.resize(target_length);
+    for (int i = 0; i < target_length; ++i) {
+        begins[i] = min(static_cast<int>(static_cast<int64_t>(i) * source_length / target_length), source_length - 1);
+        ends[i] = max(static_cast<int>(static_cast<int64_t>(i + 1) * source_length / target_length), begins[i] + 1);
+    }
+}
+
+/**
+ * @brief 面积平均缩放：每个目标像素取它在源图中覆盖的矩形内所有像素的平均值
+ * @param source 源图
+ * @param target_width 目标宽度
+ * @param target_height 目标高度
+ * @param[out] target 目标像素(RGB三通道)，跨帧复用
+ * @details 源图的每个像素都参与平均，不会像最近邻采样那样产生锯齿；
+ *          目标行按块分给多个线程，每个线程先把覆盖的源行竖向累加，再按列横向求和
+ */
+void ResampleAreaAverage(const ImageLevel& source, int target_width, int target_height, vector<unsigned char>& target) {
+    target.resize(static_cast<size_t>(target_width) * target_height * 3);
+    if (target_width <= 0 || target_height <= 0) {
+        return;
+    }
+
+    vector<int> x_begins, x_ends, y_begins, y_ends;
+    ComputeSpans(source.width, target_width, x_begins, x_ends);
+    ComputeSpans(source.height, target_height, y_begins, y_ends);
+    size_t source_stride = static_cast<size_t>(source.width) * 3;
+
+    // 处理目标行 [first_row, last_row)
+    auto resample_rows = [&](int first_row, int last_row) {
+        vector<uint32_t> column_sums(source_stride);  // 当前目标行覆盖的源行逐列累加的结果
+        for (int row = first_row; row < last_row; ++row) {
+            fill(column_sums.begin(), column_sums.end(), 0);
+            for (int y = y_begins[row]; y < y_ends[row]; ++y) {
+                AccumulateRow(column_sums.data(), source.pixels + static_cast<size_t>(y) * source_stride, source_stride);
+            }
+            uint64_t rows = y_ends[row] - y_begins[row];
+            unsigned char* out = target.data() + static_cast<size_t>(row) * target_width * 3;
+            for (int col = 0; col < target_width; ++col) {
+                uint64_t red = 0, green = 0, blue = 0;
+                for (int x = x_begins[col]; x < x_ends[col]; ++x) {
+                    red += column_sums[x * 3];
+                    green += column_sums[x * 3 + 1];
+                    blue += column_sums[x * 3 + 2];
+                }
+                uint64_t area = rows * (x_ends[col] - x_begins[col]);
+                out[col * 3] = static_cast<unsigned char>((red + area / 2) / area);
+                out[col * 3 + 1] = static_cast<unsigned char>((green + area / 2) / area);
+                out[col * 3 + 2] = static_cast<unsigned char>((blue + area / 2) / area);
+            }
+        }
+    };
+
+    // 按目标行均分给各线程，第一块由当前线程处理
+    int thread_count = static_cast<int>(thread::hardware_concurrency());
+    thread_count = max(1, min(thread_count, target_height / kMinRowsPerThread));
+    vector<thread> workers;
+    for (int t = 1; t < thread_count; ++t) {
+        workers.emplace_back(resample_rows,
+            static_cast<int>(static_cast<int64_t>(t) * target_height / thread_count),
+            static_cast<int>(static_cast<int64_t>(t + 1) * target_height / thread_count));
+    }
+    resample_rows(0, target_height / thread_count);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
 // ====================== 图片渲染相关 ======================
 
 /**
- * @brief 将RGB值格式化为3位数字字符串
- * @param color_value RGB分量值(0-255)
- * @return 3位数字字符串，不足前面补零
+ * @brief 终端上一个字符格的颜色，字形由渲染模式决定(半块模式为"▀"，否则为两个空格)
+ */
+struct ScreenCell {
+    int32_t foreground = kDefaultColor;  // 前景色
+    int32_t background = kDefaultColor;  // 背景色
+
+    bool operator==(const ScreenCell& other) const {
+        return foreground == other.foreground && background == other.background;
+    }
+
+    bool operator!=(const ScreenCell& other) const {
+        return !(*this == other);
+    }
+
+    /**
+     * @brief 是否为空白格(默认颜色，没有画图片)
+     */
+    bool IsBlank() const {
+        return foreground == kDefaultColor && background == kDefaultColor;
+    }
+};
+
+/**
+ * @brief 一帧图片占用的字符格，按行存放
  */
-string FormatColorComponent(int color_value) {
-    string component = to_string(color_value);
-    while (component.size() < 3) {
-        component = "0" + component;
+struct ScreenGrid {
+    int width = 0;              // 每行字符格数
+    int rows = 0;               // 行数
+    vector<ScreenCell> cells;   // width * rows 个字符格
+
+    /**
+     * @brief 取一个字符格，超出范围的位置视为空白格
+     * @param row 行
+     * @param col 列
+     * @return 字符格
+     */
+    ScreenCell At(int row, int col) const {
+        if (row >= rows || col >= width) {
+            return ScreenCell();
+        }
+        return cells[static_cast<size_t>(row) * width + col];
+    }
+
+    /**
+     * @brief 清空(视为屏幕上什么也没有)
+     */
+    void Clear() {
+        width = 0;
+        rows = 0;
+        cells.clear();
     }
-    return component;
+};
+
+/**
+ * @brief 把缩放后的像素转换成字符格
+ * @param pixels 缩放后的像素(RGB三通道)
+ * @param width 像素宽度
+ * @param height 像素高度
+ * @param half_block true时每个字符格是上下两个像素，否则是一个像素
+ * @param[out] grid 字符格，跨帧复用
+ */
+void BuildScreenGrid(const vector<unsigned char>& pixels, int width, int height, bool half_block, ScreenGrid& grid) {
+    grid.width = width;
+    grid.rows = half_block ? (height + 1) / 2 : height;
+    grid.cells.resize(static_cast<size_t>(grid.width) * grid.rows);
+    for (int row = 0; row < grid.rows; ++row) {
+        for (int col = 0; col < width; ++col) {
+            ScreenCell& cell = grid.cells[static_cast<size_t>(row) * width + col];
+            if (half_block) {
+                // 上半格用前景色，下半格用背景色；像素行数为奇数时最后一行的下半格保持默认背景
+                cell.foreground = FrameComposer::PackColor(&pixels[(static_cast<size_t>(2 * row) * width + col) * 3]);
+                cell.background = kDefaultColor;
+                if (2 * row + 1 < height) {
+                    cell.background = FrameComposer::PackColor(&pixels[(static_cast<size_t>(2 * row + 1) * width + col) * 3]);
+                }
+            }
+            else {
+                cell.foreground = kDefaultColor;
+                cell.background = FrameComposer::PackColor(&pixels[(static_cast<size_t>(row) * width + col) * 3]);
+            }
+        }
+    }
+}
+
+/**
+ * @brief 只重画与上一帧不同的字符格
+ * @param frame 帧合成器
+ * @param current 本帧的字符格
+ * @param previous 上一帧屏幕上的字符格，清屏后为空
+ * @param half_block true时字形为"▀"(占1列)，否则为两个空格(占2列)
+ * @details 不同的格先用光标定位(紧接着上一个重画的格时省略)，再设置颜色和输出字形；
+ *          上一帧有而本帧没有的格用默认颜色的空格擦掉；颜色与前一个输出的格相同时不输出转义序列
+ */
+void ComposeDelta(FrameComposer& frame, const ScreenGrid& current, const ScreenGrid& previous, bool half_block) {
+    int columns_per_cell = half_block ? 1 : 2;
+    int rows = max(current.rows, previous.rows);
+    int width = max(current.width, previous.width);
+    int cursor_row = 0, cursor_col = 0;  // 光标当前位置，0表示未知
+
+    for (int row = 0; row < rows; ++row) {
+        for (int col = 0; col < width; ++col) {
+            ScreenCell cell = current.At(row, col);
+            if (cell == previous.At(row, col)) {
+                continue;
+            }
+            int screen_row = kImageTopRow + row;
+            int screen_col = 1 + col * columns_per_cell;
+            if (screen_row != cursor_row || screen_col != cursor_col) {
+                frame.MoveCursor(screen_row, screen_col);
+            }
+            frame.SetColors(cell.foreground, cell.background);
+            if (cell.IsBlank()) {
+                frame.Append("  ", columns_per_cell);
+            }
+            else if (half_block) {
+                frame.Append(kUpperHalfBlock);
+            }
+            else {
+                frame.Append("  ", 2);
+            }
+            cursor_row = screen_row;
+            cursor_col = screen_col + columns_per_cell;
+        }
+    }
+    frame.ResetColors();
+
+    // 光标停在图片下一行，退出后的输出不会覆盖图片
+    frame.MoveCursor(kImageTopRow + current.rows, 1);
 }
 
 /**
  * @brief 在终端中渲染图片
  * @param image_path 要渲染的图片文件路径
+ * @param half_block 是否用半块字符渲染(纵向分辨率加倍)
  */
-void RenderImageInTerminal(const string& image_path) {
+void RenderImageInTerminal(const string& image_path, bool half_block) {
     bool should_quit = false;
+    FrameComposer frame;  // 整帧输出缓冲区，跨帧复用
+
+    // 只加载、解码一次，窗口大小变化时复用
+    ImagePyramid image;
+    if (!image.Load(image_path)) {
+        cerr << "错误: 无法加载图片文件: " << image_path << endl;
+        return;
+    }
+    int image_width = image.Original().width;
+    int image_height = image.Original().height;
+    vector<unsigned char> scaled_pixels;  // 缩放后的像素，跨帧复用
+    ScreenGrid screen, previous_screen;   // 本帧和上一帧屏幕上的字符格
+    int previous_width = 0, previous_height = 0;  // 上一帧的终端尺寸，0表示还没有画过
     
     while (!should_quit) {
         // 获取当前终端尺寸
         int terminal_width, terminal_height;
         GetTerminalDimensions(terminal_width, terminal_height);
         
-        // 加载图片数据
-        int image_width, image_height, color_channels;
-        unsigned char* pixel_data = stbi_load(
-            image_path.c_str(), 
-            &image_width, 
-            &image_height, 
-            &color_channels, 
-            3  // 强制加载为RGB三通道
-        );
-        
-        if (!pixel_data) {
-            cerr << "错误: 无法加载图片文件: " << image_path << endl;
-            return;
+        // 计算保持宽高比的缩放比例：半块模式下每行字符显示两行像素，否则每个像素占两列
+        int available_columns = half_block ? terminal_width : terminal_width / 2;
+        int available_rows = terminal_height - kImageTopRow;  // 为信息行和最后的光标预留空间
+        if (half_block) {
+            available_rows *= 2;
         }
-        
-        // 计算保持宽高比的缩放比例
         float scale_factor = min(
-            static_cast<float>(terminal_width) / image_width,
-            static_cast<float>(terminal_height - 3) / image_height  // 为信息行预留空间
+            static_cast<float>(available_columns) / image_width,
+            static_cast<float>(available_rows) / image_height
         );
         
         int scaled_width = static_cast<int>(image_width * scale_factor);
         int scaled_height = static_cast<int>(image_height * scale_factor);
-        
-        // 清屏并显示图片信息
-        system("clear");
-        cout << "图片信息: 原始尺寸 " << image_width << "x" << image_height 
-             << ", 缩放后尺寸 " << scaled_width << "x" << scaled_height << endl;
-        cout << "操作提示: 按ESC键退出，调整窗口大小可重新渲染..." << endl;
-        
-        // 逐行渲染图片
-        for (int row = 0; row < scaled_height; ++row) {
-            for (int col = 0; col < scaled_width; ++col) {
-                // 计算原始图片中的对应位置
-                int original_x = min(
-                    static_cast<int>(col / scale_factor),
-                    image_width - 1  // 防止数组越界
-                );
-                int original_y = min(
-                    static_cast<int>(row / scale_factor),
-                    image_height - 1
-                );
-                
-                // 获取RGB像素值
-                int pixel_index = (original_y * image_width + original_x) * 3;
-                int red = pixel_data[pixel_index];
-                int green = pixel_data[pixel_index + 1];
-                int blue = pixel_data[pixel_index + 2];
-                
-                // 生成ANSI背景色转义序列
-                string color_sequence = "\033[48;2;" + 
-                    FormatColorComponent(red) + ";" +
-                    FormatColorComponent(green) + ";" +
-                    FormatColorComponent(blue) + "m";
-                
-                // 输出两个空格作为像素点
-                cout << color_sequence << "  " << kTerminalResetSequence;
-            }
-            cout << endl;  // 换行到下一行像素
+
+        // 从不小于缩放后尺寸的最小一级按面积平均缩放
+        ResampleAreaAverage(image.LevelFor(scaled_width, scaled_height), scaled_width, scaled_height, scaled_pixels);
+        BuildScreenGrid(scaled_pixels, scaled_width, scaled_height, half_block, screen);
+
+        // 按最坏情况（每个格都要定位光标、换颜色）预先分配缓冲区
+        size_t cell_length = 16 + FrameComposer::kMaxColorSequenceLength + (half_block ? kUpperHalfBlock.size() : 2);
+        size_t cell_count = static_cast<size_t>(max(screen.width, previous_screen.width)) * max(screen.rows, previous_screen.rows);
+        frame.Begin(cell_count * cell_length + 512);
+
+        // 第一次绘制或终端变小(终端可能已重排或滚动屏幕内容)时清屏重画，否则只重画变化的格
+        bool repaint = previous_width == 0 || terminal_width < previous_width || terminal_height < previous_height;
+        if (repaint) {
+            frame.Append(kClearScreenSequence);
+            previous_screen.Clear();
+        }
+
+        // 图片信息
+        frame.MoveCursor(1, 1);
+        frame.Append("图片信息: 原始尺寸 ");
+        frame.AppendNumber(image_width);
+        frame.Append("x", 1);
+        frame.AppendNumber(image_height);
+        frame.Append(", 缩放后尺寸 ");
+        frame.AppendNumber(scaled_width);
+        frame.Append("x", 1);
+        frame.AppendNumber(scaled_height);
+        frame.Append(kEraseLineSequence);
+        if (repaint) {
+            frame.MoveCursor(2, 1);
+            frame.Append("操作提示: 按ESC键退出，调整窗口大小可重新渲染...");
         }
         
-        // 释放图片内存
-        stbi_image_free(pixel_data);
+        // 合成与上一帧的差异
+        ComposeDelta(frame, screen, previous_screen, half_block);
+
+        // 一次写出整帧
+        frame.Flush();
+        swap(screen, previous_screen);
+        previous_width = terminal_width;
+        previous_height = terminal_height;
         
         // 等待用户操作或窗口大小变化
         while (true) {
@@ -189,15 +753,33 @@ void RenderImageInTerminal(const string& image_path) {
  * @return 程序退出状态码
  */
 int main(int argc, char* argv[]) {
+    // 解析命令行参数
+    bool half_block = false;
+    string image_path;
+    for (int i = 1; i < argc; ++i) {
+        string argument = argv[i];
+        if (argument == "--half-block") {
+            half_block = true;
+        }
+        else if (image_path.empty() && argument.compare(0, 2, "--") != 0) {
+            image_path = argument;
+        }
+        else {
+            image_path.clear();
+            break;
+        }
+    }
+
     // 验证命令行参数
-    if (argc != 2) {
-        cout << "使用方法: " << argv[0] << " <图片路径>" << endl;
+    if (image_path.empty()) {
+        cout << "使用方法: " << argv[0] << " [--half-block] <图片路径>" << endl;
         cout << "示例: " << argv[0] << " ~/Pictures/example.jpg" << endl;
+        cout << "  --half-block  用半块字符\"▀\"渲染，每个字符显示上下两个像素，纵向分辨率加倍" << endl;
         return EXIT_FAILURE;
     }
     
     // 开始渲染图片
-    RenderImageInTerminal(argv[1]);
+    RenderImageInTerminal(image_path, half_block);
     
     return EXIT_SUCCESS;
 }
\ No newline at end of file
@@ -5,6 +5,15 @@
 #include <random>
 #include <string>
 #include <chrono>
+#include <algorithm>
+#include <set>
+#include <map>
+#include <unordered_map>
+
+#include "../common/AsyncLog.h"
+#include "../common/AllocBench.h"
+#include "../common/AllocTrace.h"
+#include "../common/TlsfAllocator.h"
 
 using namespace std;
 
@@ -20,6 +29,42 @@ int active_processor_count = 0;                     // 当前活跃的处理器
 long long total_memory_capacity = 0;                // 系统总内存容量（字节）
 const int INT_MAX=2147483647;
 
+// ===================== 分配器引擎选择 =====================
+/**
+ * @brief 内存分配器引擎
+ *
+ * FirstFit 为首次适应算法，按地址有序的空闲区间表查找第一个能放下对齐块的空洞，
+ * Buddy 为伙伴系统，按阶维护空闲链表，分配与释放均为 O(log N)；
+ * Tlsf 为两级分离适配，以 TLSF_GRANULE 字节为单位，分配与释放均为 O(1)，大块只按粒度对齐。
+ */
+enum class AllocatorEngine {
+    FirstFit,
+    Buddy,
+    Tlsf
+};
+
+AllocatorEngine active_allocator_engine = AllocatorEngine::Buddy; // 当前使用的分配器引擎
+bool slab_cache_enabled = true;     // 是否启用每线程小对象 slab 缓存
+
+constexpr long long TLSF_GRANULE = 16;                 // TLSF 引擎的分配粒度（字节）
+constexpr long long TLSF_ALIGNED_MAX_SIZE = 64LL * 1024; // TLSF 引擎仍按对齐要求对齐的最大请求，覆盖 slab 的批量申请
+
+/**
+ * @brief 分配器引擎的名称
+ * @param engine 引擎
+ * @return const char* 用于输出的名称
+ */
+const char* allocator_engine_name(AllocatorEngine engine) {
+    switch (engine) {
+    case AllocatorEngine::Buddy:
+        return "伙伴系统";
+    case AllocatorEngine::Tlsf:
+        return "TLSF";
+    default:
+        return "首次适应";
+    }
+}
+
 // ===================== 内存管理数据结构 =====================
 /**
  * @brief 内存块描述符
@@ -29,6 +74,7 @@ const int INT_MAX=2147483647;
 struct MemoryBlockDescriptor {
     long long base_address;  // 内存块起始地址
     long long block_size;    // 内存块大小（字节）
+    bool from_slab_cache = false; // 是否由线程本地 slab 缓存分配
     
     /**
      * @brief 构造函数
@@ -53,51 +99,335 @@ struct MemoryBlockDescriptor {
     }
 };
 
-// 已分配内存块记录表
-vector<MemoryBlockDescriptor> allocated_memory_blocks;
+// 已分配内存块记录表（首次适应），起始地址 -> 块大小
+map<long long, long long> allocated_memory_blocks;
+
+// 空闲区间表（首次适应），起始地址 -> 结束地址（不含），相邻区间总是合并
+map<long long, long long> free_memory_extents;
+
+// 按长度分级的空闲区间：第 k 级保存长度在 [2^k, 2^(k+1)) 内的区间（起始地址, 结束地址），按地址有序。
+// 查找时直接跳过太短的级别，对齐留下的大量小碎片不会被逐个扫描
+constexpr int FREE_EXTENT_CLASSES = 64;
+vector<set<pair<long long, long long>>> free_extents_by_class(FREE_EXTENT_CLASSES);
+
+// 从上面几张表中摘下的树节点，插入时优先复用，分配和释放的常见路径不再调用 new/delete
+vector<map<long long, long long>::node_type> spare_map_nodes;
+vector<set<pair<long long, long long>>::node_type> spare_set_nodes;
 
 // 内存管理互斥锁，确保内存操作的原子性
 mutex memory_management_mutex;
 
+// 全局分配器当前占用的字节数（伙伴系统按块大小计，首次适应按请求大小计），受 memory_management_mutex 保护
+long long global_memory_footprint = 0;
+
+// ===================== 伙伴系统分配器 =====================
+/**
+ * @brief 伙伴系统分配器
+ *
+ * 每一阶 k 维护一个大小为 2^k 字节、起始地址按 2^k 对齐的空闲块集合。
+ * 分配时从不小于请求阶的最小非空阶取出地址最低的块并逐级对半拆分，
+ * 释放时与伙伴块（地址异或 2^k）逐级合并。块天然按自身大小对齐，
+ * 因此满足"返回地址对齐到不小于请求大小的最小 2 的幂"的约定。
+ */
+class BuddyAllocator {
+public:
+    /**
+     * @brief 初始化分配器
+     *
+     * 容量不一定是 2 的幂，按地址从低到高拆成若干个最大的对齐块放入空闲集合。
+     * 地址 0 所在的 1 字节块被预留，与首次适应算法从 alignment 开始搜索的行为保持一致。
+     *
+     * @param capacity 管理的内存总字节数
+     */
+    void initialize(long long capacity) {
+        max_order = 0;
+        while ((1LL << (max_order + 1)) <= capacity) {
+            ++max_order;
+        }
+        free_lists.assign(max_order + 1, set<long long>());
+
+        // 预留地址 0：把位于 0 的最大块逐级拆分到 0 阶并保留该 0 阶块
+        for (int order = max_order; order > 0; --order) {
+            free_lists[order - 1].insert(1LL << (order - 1));
+        }
+
+        long long address = 1LL << max_order;
+        while (address < capacity) {
+            int order = max_order;
+            // 找到既按 2^order 对齐、又不越过容量上界的最大块
+            while (order > 0 && ((address & ((1LL << order) - 1)) != 0 ||
+                                 address + (1LL << order) > capacity)) {
+                --order;
+            }
+            free_lists[order].insert(address);
+            address += 1LL << order;
+        }
+    }
+
+    /**
+     * @brief 分配一个 2^order 字节的块
+     * @param order 块的阶
+     * @return long long 块起始地址，失败返回 -1
+     */
+    long long allocate(int order) {
+        if (order > max_order) {
+            return -1;
+        }
+
+        // 找到最小的非空阶
+        int current_order = order;
+        while (current_order <= max_order && free_lists[current_order].empty()) {
+            ++current_order;
+        }
+        if (current_order > max_order) {
+            return -1;
+        }
+
+        // 取出该阶地址最低的块
+        long long address = *free_lists[current_order].begin();
+        free_lists[current_order].erase(free_lists[current_order].begin());
+
+        // 逐级拆分，高地址的一半放回低一阶的空闲集合
+        while (current_order > order) {
+            --current_order;
+            free_lists[current_order].insert(address + (1LL << current_order));
+        }
+
+        return address;
+    }
+
+    /**
+     * @brief 释放一个 2^order 字节的块并与伙伴合并
+     * @param address 块起始地址
+     * @param order 块的阶
+     */
+    void release(long long address, int order) {
+        while (order < max_order) {
+            long long buddy_address = address ^ (1LL << order);
+            auto buddy = free_lists[order].find(buddy_address);
+            if (buddy == free_lists[order].end()) {
+                break; // 伙伴块不空闲，停止合并
+            }
+            free_lists[order].erase(buddy);
+            address = min(address, buddy_address);
+            ++order;
+        }
+        free_lists[order].insert(address);
+    }
+
+    /**
+     * @brief 计算容纳指定大小所需的阶
+     * @param size 字节数
+     * @return int 满足 2^order >= size 的最小阶
+     */
+    static int order_for_size(long long size) {
+        int order = 0;
+        while ((1LL << order) < size) {
+            ++order;
+        }
+        return order;
+    }
+
+private:
+    int max_order = 0;                  // 最高阶，2^max_order <= 容量
+    vector<set<long long>> free_lists;  // 每一阶的空闲块起始地址，按地址有序
+};
+
+// 伙伴系统分配器实例，由 memory_management_mutex 保护
+BuddyAllocator buddy_allocator;
+
+// TLSF 分配器实例，地址和长度以 TLSF_GRANULE 字节为单位，由 memory_management_mutex 保护
+TlsfAllocator tlsf_allocator;
+
 // ===================== 内存管理函数 =====================
 
 /**
- * @brief 检查内存区域是否可用
- * 
- * 检查从指定起始地址开始指定大小的内存区域是否与已分配区域重叠
- * 
- * @param proposed_base 提议的起始地址
- * @param proposed_size 提议的内存大小
- * @return true 内存区域可用
- * @return false 内存区域已被占用
+ * @brief 计算长度所在的级别
+ * @param length 字节数（大于 0）
+ * @return int 满足 2^k <= length 的最大 k
  */
-bool is_memory_region_available(long long proposed_base, long long proposed_size) {
-    // 计算提议区域的结束地址（包含边界）
-    long long proposed_end = proposed_base + proposed_size - 1;
-    
-    // 遍历所有已分配的内存块
-    for (const auto& allocated_block : allocated_memory_blocks) {
-        long long allocated_start = allocated_block.base_address;
-        long long allocated_end = allocated_block.base_address + allocated_block.block_size - 1;
-        
-        // 检查地址范围是否有重叠
-        if (proposed_end >= allocated_start && proposed_base <= allocated_end) {
-            return false; // 发现重叠，区域不可用
+int free_extent_class(long long length) {
+    int extent_class = 0;
+    while ((length >> (extent_class + 1)) != 0) {
+        ++extent_class;
+    }
+    return extent_class;
+}
+
+/**
+ * @brief 向映射表插入一项，复用回收的节点
+ * @param table 目标表
+ * @param key 键
+ * @param value 值
+ */
+void insert_with_spare_node(map<long long, long long>& table, long long key, long long value) {
+    if (spare_map_nodes.empty()) {
+        table.emplace(key, value);
+        return;
+    }
+    auto node = move(spare_map_nodes.back());
+    spare_map_nodes.pop_back();
+    node.key() = key;
+    node.mapped() = value;
+    table.insert(move(node));
+}
+
+/**
+ * @brief 从映射表摘下一项，节点留作复用
+ * @param table 所在的表
+ * @param entry 指向要摘下的项
+ * @return 下一项
+ */
+map<long long, long long>::iterator erase_to_spare_node(map<long long, long long>& table,
+                                                        map<long long, long long>::iterator entry) {
+    auto next = std::next(entry);
+    spare_map_nodes.push_back(table.extract(entry));
+    return next;
+}
+
+/**
+ * @brief 加入一个空闲区间（调用者保证它不与已有空闲区间相邻或重叠）
+ * @param start 起始地址
+ * @param end 结束地址（不含）
+ */
+void insert_free_extent(long long start, long long end) {
+    if (start >= end) {
+        return;
+    }
+    insert_with_spare_node(free_memory_extents, start, end);
+    auto& extents = free_extents_by_class[free_extent_class(end - start)];
+    if (spare_set_nodes.empty()) {
+        extents.emplace(start, end);
+        return;
+    }
+    auto node = move(spare_set_nodes.back());
+    spare_set_nodes.pop_back();
+    node.value() = { start, end };
+    extents.insert(move(node));
+}
+
+/**
+ * @brief 移除一个空闲区间
+ * @param extent 指向 free_memory_extents 中的区间
+ * @return 下一个区间
+ */
+map<long long, long long>::iterator erase_free_extent(map<long long, long long>::iterator extent) {
+    auto& extents = free_extents_by_class[free_extent_class(extent->second - extent->first)];
+    spare_set_nodes.push_back(extents.extract({ extent->first, extent->second }));
+    return erase_to_spare_node(free_memory_extents, extent);
+}
+
+/**
+ * @brief 初始化首次适应分配器
+ *
+ * 清空已分配记录，整个容量作为一个空闲区间。地址 0 不会被分配，因为候选地址至少为 alignment。
+ *
+ * @param capacity 管理的内存总字节数
+ */
+void initialize_first_fit(long long capacity) {
+    allocated_memory_blocks.clear();
+    free_memory_extents.clear();
+    free_extents_by_class.assign(FREE_EXTENT_CLASSES, set<pair<long long, long long>>());
+    insert_free_extent(0, capacity);
+}
+
+/**
+ * @brief 首次适应分配
+ *
+ * 返回所有放得下对齐块的空闲区间中地址最低的一个里的第一个对齐地址，与逐个探测对齐槽位的结果相同。
+ * 长度不小于 requested_size + alignment - 1 的区间一定放得下，这些级别只需看地址最低的区间；
+ * 更短的级别逐个检查，但只检查地址低于当前最优结果的区间。太短的级别整个跳过。
+ *
+ * @param requested_size 请求的内存大小
+ * @param alignment 对齐要求（2 的幂）
+ * @return long long 块起始地址，失败返回 -1
+ */
+long long first_fit_allocate(long long requested_size, long long alignment) {
+    long long best_start = -1;       // 选中区间的起始地址
+    long long best_candidate = -1;   // 选中区间内的对齐地址
+    int lowest_class = free_extent_class(requested_size); // 更低级别的区间都比请求短
+    for (int extent_class = FREE_EXTENT_CLASSES - 1; extent_class >= lowest_class; --extent_class) {
+        for (const auto& extent : free_extents_by_class[extent_class]) {
+            if (best_start >= 0 && extent.first >= best_start) {
+                break; // 后面的区间地址更高
+            }
+            long long candidate_address = max(alignment, (extent.first + alignment - 1) & ~(alignment - 1));
+            if (candidate_address + requested_size <= extent.second) {
+                best_start = extent.first;
+                best_candidate = candidate_address;
+                break; // 本级地址最低的可用区间
+            }
         }
     }
-    
-    return true; // 无重叠，区域可用
+    if (best_start < 0) {
+        return -1;
+    }
+
+    // 切出 [best_candidate, best_candidate + requested_size)，两侧剩余部分放回
+    auto extent = free_memory_extents.find(best_start);
+    long long extent_end = extent->second;
+    erase_free_extent(extent);
+    insert_free_extent(best_start, best_candidate);
+    insert_free_extent(best_candidate + requested_size, extent_end);
+    insert_with_spare_node(allocated_memory_blocks, best_candidate, requested_size);
+    return best_candidate;
 }
 
 /**
- * @brief 内存分配函数
+ * @brief 首次适应释放，与前后相邻的空闲区间合并
+ * @param base_address 块起始地址
+ * @param block_size 块大小
+ * @return true 释放成功
+ * @return false 没有这样的已分配块
+ */
+bool first_fit_release(long long base_address, long long block_size) {
+    auto allocated = allocated_memory_blocks.find(base_address);
+    if (allocated == allocated_memory_blocks.end() || allocated->second != block_size) {
+        return false;
+    }
+    erase_to_spare_node(allocated_memory_blocks, allocated);
+
+    long long start = base_address;
+    long long end = base_address + block_size;
+    auto next = free_memory_extents.lower_bound(start);
+    if (next != free_memory_extents.end() && next->first == end) {
+        end = next->second;
+        next = erase_free_extent(next);
+    }
+    if (next != free_memory_extents.begin()) {
+        auto previous = prev(next);
+        if (previous->second == start) {
+            start = previous->first;
+            erase_free_extent(previous);
+        }
+    }
+    insert_free_extent(start, end);
+    return true;
+}
+
+/**
+ * @brief 按当前引擎初始化全局分配器，所有内存空闲
+ * @param capacity 管理的内存总字节数
+ */
+void initialize_allocator_engine(long long capacity) {
+    if (active_allocator_engine == AllocatorEngine::Buddy) {
+        buddy_allocator.initialize(capacity);
+    } else if (active_allocator_engine == AllocatorEngine::Tlsf) {
+        tlsf_allocator.Init(1, capacity / TLSF_GRANULE - 1); // 第 0 个粒度不分配，地址 0 表示空
+    } else {
+        initialize_first_fit(capacity);
+    }
+}
+
+/**
+ * @brief 全局内存分配函数
  * 
- * 按照对齐要求分配指定大小的内存块
+ * 在 memory_management_mutex 保护下，按照对齐要求从全局分配器引擎分配指定大小的内存块
  * 
  * @param requested_size 请求的内存大小
  * @return MemoryBlockDescriptor* 分配的内存块描述符指针，失败返回nullptr
  */
-MemoryBlockDescriptor* allocate_memory(long long requested_size) {
+MemoryBlockDescriptor* allocate_global_memory(long long requested_size) {
     // 自动加锁，函数返回时自动释放
     lock_guard<mutex> lock_guard(memory_management_mutex);
     
@@ -114,32 +444,46 @@ MemoryBlockDescriptor* allocate_memory(long long requested_size) {
         // 由于16MB限制，无需担心溢出
     }
     
-    // 按照对齐要求搜索可用内存区域
-    for (long long candidate_address = alignment_requirement; 
-         candidate_address <= total_memory_capacity - requested_size; 
-         candidate_address += alignment_requirement) {
-        
-        if (is_memory_region_available(candidate_address, requested_size)) {
-            // 找到可用区域，创建内存块描述符
-            MemoryBlockDescriptor* new_block = new MemoryBlockDescriptor(candidate_address, requested_size);
-            allocated_memory_blocks.push_back(*new_block); // 记录分配信息
-            
-            return new_block;
+    // 伙伴系统：块大小即对齐要求，直接按阶分配
+    if (active_allocator_engine == AllocatorEngine::Buddy) {
+        int order = BuddyAllocator::order_for_size(requested_size);
+        long long block_address = buddy_allocator.allocate(order);
+        if (block_address < 0) {
+            return nullptr;
+        }
+        global_memory_footprint += 1LL << order;
+        return new MemoryBlockDescriptor(block_address, requested_size);
+    }
+    
+    // TLSF：不超过 TLSF_ALIGNED_MAX_SIZE 的请求仍按对齐要求对齐（slab 依赖此对齐），更大的只按粒度对齐
+    if (active_allocator_engine == AllocatorEngine::Tlsf) {
+        long long granules = (requested_size + TLSF_GRANULE - 1) / TLSF_GRANULE;
+        long long granule_alignment = requested_size <= TLSF_ALIGNED_MAX_SIZE ? max(1LL, alignment_requirement / TLSF_GRANULE) : 1;
+        long long first_granule = tlsf_allocator.Allocate(granules, granule_alignment);
+        if (first_granule < 0) {
+            return nullptr;
         }
+        global_memory_footprint += granules * TLSF_GRANULE;
+        return new MemoryBlockDescriptor(first_granule * TLSF_GRANULE, requested_size);
     }
     
-    // 内存不足，分配失败
-    return nullptr;
+    // 首次适应：在空闲区间表中查找第一个能放下对齐块的空洞
+    long long block_address = first_fit_allocate(requested_size, alignment_requirement);
+    if (block_address < 0) {
+        return nullptr; // 内存不足，分配失败
+    }
+    global_memory_footprint += requested_size;
+    return new MemoryBlockDescriptor(block_address, requested_size);
 }
 
 /**
- * @brief 内存释放函数
+ * @brief 全局内存释放函数
  * 
- * 释放之前分配的内存块
+ * 在 memory_management_mutex 保护下，把内存块归还给全局分配器引擎
  * 
  * @param block_to_free 要释放的内存块描述符指针
  */
-void deallocate_memory(MemoryBlockDescriptor* block_to_free) {
+void deallocate_global_memory(MemoryBlockDescriptor* block_to_free) {
     if (block_to_free == nullptr) {
         return; // 空指针检查
     }
@@ -147,21 +491,207 @@ void deallocate_memory(MemoryBlockDescriptor* block_to_free) {
     // 自动加锁，确保线程安全
     lock_guard<mutex> lock_guard(memory_management_mutex);
     
-    // 在已分配记录中查找并移除对应块
-    for (auto iterator = allocated_memory_blocks.begin(); 
-         iterator != allocated_memory_blocks.end(); 
-         ++iterator) {
-        
-        if (*iterator == *block_to_free) {
-            allocated_memory_blocks.erase(iterator);
-            break;
-        }
+    if (active_allocator_engine == AllocatorEngine::Buddy) {
+        int order = BuddyAllocator::order_for_size(block_to_free->block_size);
+        buddy_allocator.release(block_to_free->base_address, order);
+        global_memory_footprint -= 1LL << order;
+        delete block_to_free;
+        return;
+    }
+    
+    if (active_allocator_engine == AllocatorEngine::Tlsf) {
+        long long granules = (block_to_free->block_size + TLSF_GRANULE - 1) / TLSF_GRANULE;
+        tlsf_allocator.Release(block_to_free->base_address / TLSF_GRANULE, granules);
+        global_memory_footprint -= granules * TLSF_GRANULE;
+        delete block_to_free;
+        return;
+    }
+    
+    // 在已分配记录中查找并移除对应块，空间归还空闲区间表
+    if (first_fit_release(block_to_free->base_address, block_to_free->block_size)) {
+        global_memory_footprint -= block_to_free->block_size;
     }
     
     // 释放描述符内存
     delete block_to_free;
 }
 
+// ===================== 每线程 slab 缓存 =====================
+// 1 字节到 4KB 的小对象按 2 的幂划分大小类，每个线程从全局分配器一次批量取得
+// 一个 64KB 的 slab 并切分成同类对象，之后的分配与释放只访问线程本地数据，
+// 不再竞争 memory_management_mutex。
+
+constexpr long long SLAB_MIN_OBJECT_SIZE = 16;          // 最小大小类（字节）
+constexpr long long SLAB_MAX_OBJECT_SIZE = 4096;        // 走 slab 缓存的最大请求（字节）
+constexpr long long SLAB_BYTES = 64LL * 1024;           // 每次批量申请的 slab 大小（字节）
+constexpr int SLAB_SIZE_CLASS_COUNT = 9;                // 大小类数量：16, 32, ..., 4096
+
+/**
+ * @brief slab 描述
+ *
+ * 一个 slab 是从全局分配器取得的 SLAB_BYTES 字节块，按 object_size 切分。
+ * 全局分配器保证该块按 SLAB_BYTES 对齐，因此每个对象也按 object_size 对齐，
+ * 满足对齐到不小于请求大小的最小 2 的幂的约定。
+ */
+struct Slab {
+    MemoryBlockDescriptor* backing_block = nullptr; // 从全局分配器取得的块
+    long long object_size = 0;                      // 对象大小（大小类）
+    int live_objects = 0;                           // 已分配出去的对象数
+    long long next_unused = 0;                      // 尚未切分过的下一个对象地址
+    vector<long long> free_objects;                 // 已释放、可复用的对象地址
+
+    /**
+     * @brief 判断 slab 是否已没有可分配的对象
+     * @return true 已满
+     */
+    bool is_full() const {
+        return free_objects.empty() &&
+               next_unused >= backing_block->base_address + SLAB_BYTES;
+    }
+};
+
+/**
+ * @brief 线程本地的 slab 缓存
+ *
+ * 只能由所属线程访问；processor_work_routine 总是在分配内存的线程上释放内存。
+ * 线程退出时析构函数把所有 slab 归还全局分配器。
+ */
+class ThreadSlabCache {
+public:
+    ~ThreadSlabCache() {
+        for (auto& entry : slabs_by_base) {
+            deallocate_global_memory(entry.second->backing_block);
+            delete entry.second;
+        }
+    }
+
+    /**
+     * @brief 从缓存分配一个小对象
+     * @param requested_size 请求的内存大小（不超过 SLAB_MAX_OBJECT_SIZE）
+     * @return MemoryBlockDescriptor* 内存块描述符，无法补充 slab 时返回nullptr
+     */
+    MemoryBlockDescriptor* allocate(long long requested_size) {
+        int size_class = size_class_for(requested_size);
+        vector<Slab*>& partial = partial_slabs[size_class];
+
+        // 没有可用 slab 时从全局分配器批量补充
+        if (partial.empty()) {
+            MemoryBlockDescriptor* backing_block = allocate_global_memory(SLAB_BYTES);
+            if (backing_block == nullptr) {
+                return nullptr;
+            }
+            Slab* slab = new Slab();
+            slab->backing_block = backing_block;
+            slab->object_size = SLAB_MIN_OBJECT_SIZE << size_class;
+            slab->next_unused = backing_block->base_address;
+            slabs_by_base[backing_block->base_address] = slab;
+            partial.push_back(slab);
+        }
+
+        Slab* slab = partial.back();
+        long long object_address;
+        if (!slab->free_objects.empty()) {
+            object_address = slab->free_objects.back();
+            slab->free_objects.pop_back();
+        } else {
+            object_address = slab->next_unused;
+            slab->next_unused += slab->object_size;
+        }
+        ++slab->live_objects;
+
+        if (slab->is_full()) {
+            partial.pop_back();
+        }
+
+        MemoryBlockDescriptor* block = new MemoryBlockDescriptor(object_address, requested_size);
+        block->from_slab_cache = true;
+        return block;
+    }
+
+    /**
+     * @brief 把小对象归还缓存
+     *
+     * slab 中对象全部空闲且同一大小类还有其他可用 slab 时，把该 slab 归还全局分配器。
+     *
+     * @param block 由本缓存分配的内存块描述符
+     */
+    void release(MemoryBlockDescriptor* block) {
+        Slab* slab = slabs_by_base.at(block->base_address & ~(SLAB_BYTES - 1));
+        vector<Slab*>& partial = partial_slabs[size_class_for(slab->object_size)];
+
+        bool was_full = slab->is_full();
+        slab->free_objects.push_back(block->base_address);
+        --slab->live_objects;
+
+        if (was_full) {
+            partial.push_back(slab);
+        }
+
+        if (slab->live_objects == 0 && partial.size() > 1) {
+            partial.erase(find(partial.begin(), partial.end(), slab));
+            slabs_by_base.erase(slab->backing_block->base_address);
+            deallocate_global_memory(slab->backing_block);
+            delete slab;
+        }
+    }
+
+private:
+    /**
+     * @brief 计算请求大小对应的大小类下标
+     * @param size 请求字节数
+     * @return int 满足 (SLAB_MIN_OBJECT_SIZE << k) >= size 的最小 k
+     */
+    static int size_class_for(long long size) {
+        int size_class = 0;
+        while ((SLAB_MIN_OBJECT_SIZE << size_class) < size) {
+            ++size_class;
+        }
+        return size_class;
+    }
+
+    vector<Slab*> partial_slabs[SLAB_SIZE_CLASS_COUNT]; // 每个大小类中尚有空闲对象的 slab
+    unordered_map<long long, Slab*> slabs_by_base;      // slab 起始地址到 slab 的映射
+};
+
+// 每个处理器线程独立的 slab 缓存
+thread_local ThreadSlabCache thread_slab_cache;
+
+// ===================== 内存分配接口 =====================
+
+/**
+ * @brief 内存分配函数
+ * 
+ * 小对象优先走线程本地 slab 缓存，其余请求（以及缓存无法补充时）走全局分配器
+ * 
+ * @param requested_size 请求的内存大小
+ * @return MemoryBlockDescriptor* 分配的内存块描述符指针，失败返回nullptr
+ */
+MemoryBlockDescriptor* allocate_memory(long long requested_size) {
+    if (slab_cache_enabled && requested_size <= SLAB_MAX_OBJECT_SIZE) {
+        MemoryBlockDescriptor* block = thread_slab_cache.allocate(requested_size);
+        if (block != nullptr) {
+            return block;
+        }
+    }
+    return allocate_global_memory(requested_size);
+}
+
+/**
+ * @brief 内存释放函数
+ * 
+ * 释放之前分配的内存块
+ * 
+ * @param block_to_free 要释放的内存块描述符指针
+ */
+void deallocate_memory(MemoryBlockDescriptor* block_to_free) {
+    if (block_to_free != nullptr && block_to_free->from_slab_cache) {
+        thread_slab_cache.release(block_to_free);
+        delete block_to_free;
+        return;
+    }
+    deallocate_global_memory(block_to_free);
+}
+
 // ===================== 工具函数 =====================
 
 /**
@@ -178,17 +708,34 @@ int generate_thread_safe_random() {
     return distribution(random_engine);
 }
 
-// 控制台输出互斥锁，避免多线程输出混乱
-mutex console_output_mutex;
+// 控制台日志：各线程写入自己的环形缓冲区，由后台线程批量输出，避免多线程争用输出锁
+AsyncLog console_log;
 
 /**
  * @brief 线程安全的控制台输出函数
  * 
+ * 低于当前日志级别的消息直接丢弃；否则拷贝进本线程的日志缓冲区后立即返回。
+ * 
  * @param message 要输出的消息
+ * @param level 日志级别，默认为 Info
+ */
+void thread_safe_print(const string& message, LogLevel level = LogLevel::Info) {
+    console_log.Write(level, message);
+}
+
+// 分配轨迹：--record=FILE 时记录每次分配和释放，供 --bench-trace 回放
+TraceWriter allocation_trace;
+
+// 轨迹时间戳的起点
+chrono::steady_clock::time_point trace_start_time;
+
+/**
+ * @brief 自开始录制以来的毫秒数
+ * 
+ * @return uint64_t 轨迹时间戳
  */
-void thread_safe_print(const string& message) {
-    lock_guard<mutex> lock_guard(console_output_mutex);
-    cout << message << endl;
+uint64_t trace_timestamp() {
+    return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - trace_start_time).count();
 }
 
 // ===================== 处理器工作函数 =====================
@@ -228,22 +775,33 @@ void processor_work_routine(int processor_id) {
         }
         
         // 尝试内存分配
-        log_message = "处理器 [" + to_string(processor_id) + "] 请求分配 " + 
-                     to_string(allocation_size) + " 字节内存";
-        thread_safe_print(log_message);
+        if (console_log.Enabled(LogLevel::Debug)) {
+            log_message = "处理器 [" + to_string(processor_id) + "] 请求分配 " + 
+                         to_string(allocation_size) + " 字节内存";
+            thread_safe_print(log_message, LogLevel::Debug);
+        }
         
         MemoryBlockDescriptor* memory_block = allocate_memory(allocation_size);
         
         if (memory_block == nullptr) {
             log_message = "处理器 [" + to_string(processor_id) + "] 内存分配失败";
-            thread_safe_print(log_message);
+            thread_safe_print(log_message, LogLevel::Warn);
             continue;
         }
         
-        log_message = "处理器 [" + to_string(processor_id) + "] 分配成功: " +
-                     "起始地址=" + to_string(memory_block->base_address) + 
-                     ", 大小=" + to_string(memory_block->block_size);
-        thread_safe_print(log_message);
+        uint32_t trace_id = 0;
+        if (allocation_trace.IsOpen()) {
+            trace_id = allocation_trace.NextId();
+            allocation_trace.Record(TraceEvent::Allocate, trace_timestamp(), processor_id, trace_id,
+                                    (uint32_t)allocation_size);
+        }
+        
+        if (console_log.Enabled(LogLevel::Debug)) {
+            log_message = "处理器 [" + to_string(processor_id) + "] 分配成功: " +
+                         "起始地址=" + to_string(memory_block->base_address) + 
+                         ", 大小=" + to_string(memory_block->block_size);
+            thread_safe_print(log_message, LogLevel::Debug);
+        }
         
         // 模拟内存使用时间（1-5秒）
         int usage_duration = generate_thread_safe_random() % 5 + 1;
@@ -251,8 +809,12 @@ void processor_work_routine(int processor_id) {
         
         // 释放内存
         deallocate_memory(memory_block);
+        if (trace_id != 0) {
+            allocation_trace.Record(TraceEvent::Free, trace_timestamp(), processor_id, trace_id,
+                                    (uint32_t)allocation_size);
+        }
         log_message = "处理器 [" + to_string(processor_id) + "] 已释放内存块";
-        thread_safe_print(log_message);
+        thread_safe_print(log_message, LogLevel::Debug);
     }
     
     // 记录处理器完成
@@ -260,6 +822,74 @@ void processor_work_routine(int processor_id) {
     thread_safe_print(log_message);
 }
 
+// ===================== 内存基准测试 =====================
+
+/**
+ * @brief 基准测试适配器
+ *
+ * 把 allocate_memory / deallocate_memory 包装成 AllocBench 的接口，
+ * 每轮开始前按指定的引擎和 slab 开关把全局分配器重置为 capacity 字节的空闲内存。
+ * slab 缓存是线程本地的，测试线程退出时由析构函数归还。
+ */
+class MemoryManagerBenchAllocator : public BenchAllocator {
+public:
+    MemoryManagerBenchAllocator(AllocatorEngine engine, bool use_slab, long long capacity)
+        : engine(engine), use_slab(use_slab), capacity(capacity) {}
+
+    string Name() const override {
+        return string(allocator_engine_name(engine)) + (use_slab ? " + slab 缓存" : "");
+    }
+
+    void Reset() override {
+        lock_guard<mutex> lock_guard(memory_management_mutex);
+        active_allocator_engine = engine;
+        slab_cache_enabled = use_slab;
+        total_memory_capacity = capacity;
+        global_memory_footprint = 0;
+        initialize_allocator_engine(total_memory_capacity);
+    }
+
+    long long Allocate(long long Size) override {
+        return reinterpret_cast<long long>(allocate_memory(Size));
+    }
+
+    void Release(long long Handle, long long) override {
+        deallocate_memory(reinterpret_cast<MemoryBlockDescriptor*>(Handle));
+    }
+
+    long long FootprintBytes() override {
+        lock_guard<mutex> lock_guard(memory_management_mutex);
+        return global_memory_footprint;
+    }
+
+private:
+    AllocatorEngine engine; // 被测引擎
+    bool use_slab;          // 是否启用 slab 缓存
+    long long capacity;     // 每轮测试的内存容量（字节）
+};
+
+/**
+ * @brief 内存分配基准测试
+ *
+ * 用固定种子的操作序列，对三种引擎（各自带或不带 slab 缓存）从 1 到 MaxThreads 个线程逐轮测试，
+ * 输出吞吐量、延迟百分位、峰值占用、碎片率和失败次数。内存容量默认为 MAX_MEMORY_CAPACITY，
+ * 可用 --bench-capacity 调小以比较各引擎在内存紧张时的失败次数。
+ *
+ * @param options 基准测试参数
+ */
+void run_memory_benchmark(const BenchOptions& options) {
+    AllocBench bench(options);
+    long long capacity = options.CapacityMB > 0 ? options.CapacityMB * 1024 * 1024 : MAX_MEMORY_CAPACITY;
+    for (AllocatorEngine engine : { AllocatorEngine::Buddy, AllocatorEngine::FirstFit, AllocatorEngine::Tlsf }) {
+        for (bool use_slab : { false, true }) {
+            MemoryManagerBenchAllocator allocator(engine, use_slab, capacity);
+            if (!bench.Run(allocator)) {
+                return;
+            }
+        }
+    }
+}
+
 // ===================== 主函数 =====================
 
 /**
@@ -267,9 +897,67 @@ void processor_work_routine(int processor_id) {
  * 
  * 模拟多处理器环境下的内存分配测试
  * 
+ * @param argc 命令行参数个数
+ * @param argv 命令行参数数组，可用 --alloc=buddy|first-fit|tlsf 选择分配器引擎，
+ *             --slab=on|off 开关小对象 slab 缓存，
+ *             --log=sync|text|binary 选择日志输出方式，
+ *             --log-level=debug|info|warn|off 设置日志级别，
+ *             --record=FILE 把分配和释放录制为二进制轨迹，
+ *             --bench-memory 只运行内存分配基准测试（--bench-* 设置其参数）
  * @return int 程序退出码
  */
-int main() {
+int main(int argc, char* argv[]) {
+    // 解析命令行参数
+    bool bench_memory = false;
+    BenchOptions bench_options;
+    for (int i = 1; i < argc; ++i) {
+        string argument = argv[i];
+        if (argument == "--alloc=buddy") {
+            active_allocator_engine = AllocatorEngine::Buddy;
+        } else if (argument == "--alloc=first-fit") {
+            active_allocator_engine = AllocatorEngine::FirstFit;
+        } else if (argument == "--alloc=tlsf") {
+            active_allocator_engine = AllocatorEngine::Tlsf;
+        } else if (argument == "--slab=on") {
+            slab_cache_enabled = true;
+        } else if (argument == "--slab=off") {
+            slab_cache_enabled = false;
+        } else if (argument == "--log=sync") {
+            console_log.Mode = LogMode::Sync;
+        } else if (argument == "--log=text") {
+            console_log.Mode = LogMode::Text;
+        } else if (argument == "--log=binary") {
+            console_log.Mode = LogMode::Binary;
+        } else if (argument == "--log-level=debug") {
+            console_log.Level = LogLevel::Debug;
+        } else if (argument == "--log-level=info") {
+            console_log.Level = LogLevel::Info;
+        } else if (argument == "--log-level=warn") {
+            console_log.Level = LogLevel::Warn;
+        } else if (argument == "--log-level=off") {
+            console_log.Level = LogLevel::Off;
+        } else if (argument.rfind("--record=", 0) == 0) {
+            if (!allocation_trace.Open(argument.substr(9))) {
+                cout << "无法创建轨迹文件: " << argument.substr(9) << endl;
+                return 1;
+            }
+            trace_start_time = chrono::steady_clock::now();
+        } else if (argument == "--bench-memory") {
+            bench_memory = true;
+        } else if (!bench_options.Parse(argument)) {
+            cout << "使用方法: " << argv[0] << " [--alloc=buddy|first-fit|tlsf] [--slab=on|off]"
+                 << " [--log=sync|text|binary] [--log-level=debug|info|warn|off]"
+                 << " [--record=FILE] [--bench-memory]"
+                 << BenchOptions::Usage() << endl;
+            return 1;
+        }
+    }
+    
+    if (bench_memory) {
+        run_memory_benchmark(bench_options);
+        return 0;
+    }
+    
     // 初始化随机系统配置
     active_processor_count = generate_thread_safe_random() % MAX_CPU_COUNT + 1;
     cout << "系统配置: " << active_processor_count << " 个处理器" << endl;
@@ -280,6 +968,10 @@ int main() {
     cout << "内存容量: " << total_memory_capacity << " 字节 (" 
          << static_cast<double>(total_memory_capacity) / (1024 * 1024) << " MB)" << endl;
     
+    initialize_allocator_engine(total_memory_capacity);
+    cout << "分配器引擎: " << allocator_engine_name(active_allocator_engine) << endl;
+    cout << "slab 缓存: " << (slab_cache_enabled ? "开启" : "关闭") << endl;
+    
     // 创建处理器线程
     vector<thread> processor_threads;
     for (int i = 0; i < active_processor_count; ++i) {
@@ -291,5 +983,9 @@ int main() {
         thread.join();
     }
     
+    // 输出剩余日志和轨迹记录
+    console_log.Stop();
+    allocation_trace.Close();
+    
     return 0;
 }
\ No newline at end of file
@@ -10,14 +10,38 @@ int GetRandomIntThreadSafe() {
     return dist(gen);  // 生成并返回随机数
 }
 
+// 按任务的内存需求分布随机生成一个大小
+// 60% 为 1-128 字节，35% 为 4KB，5% 为 4KB-16MB
+long long RandomTaskSize() {
+    // 随机决定任务类型（基于内存大小分布）
+    int RandType = GetRandomIntThreadSafe() % 100 + 1;  // 生成1-100的随机数
+
+    // 按预设比例分配内存大小
+    if (RandType <= 60) {
+        // 60%概率：小内存任务 (1-128字节)
+        return (GetRandomIntThreadSafe() % 128LL) + 1;
+    }
+    else if (RandType <= 95) {
+        // 35%概率：中等内存任务 (固定4KB)
+        return 4LL * 1024;
+    }
+    else {
+        // 5%概率：大内存任务 (4KB-16MB范围随机)
+        return (GetRandomIntThreadSafe() % (16LL * 1024 * 1024 - 4 * 1024 + 1)) + 4LL * 1024;
+    }
+}
+
 // ===================== Memory 类成员函数实现 =====================
 
 // 内存系统初始化函数
 // 负责设置内存页面数量并初始化所有页面的状态
 bool Memory::Init() {
-    // 随机生成页面数量，范围在MIN_PAGES到MAX_PAGES之间
+    // 随机生成页面数量，范围在MIN_PAGES到MAX_PAGES之间（--pages 指定时使用指定值）
     int SizeOfStack = 0;
     SizeOfStack = GetRandomIntThreadSafe() % (MAX_PAGES - MIN_PAGES + 1) + MIN_PAGES;
+    if (InitPages > 0) {
+        SizeOfStack = (int)InitPages;
+    }
 
     string Console;  // 日志消息缓冲区
 
@@ -25,17 +49,15 @@ bool Memory::Init() {
     Console = "内存初始化开始。";
     os.Print(Console);
     
-    // 输出详细的内存配置信息到控制台
-    cout << "随机的页面数量为：" << to_string(SizeOfStack) << " 页，约 " 
-         << to_string((float)SizeOfStack * PAGE_SIZE / 1048576) << " MB" << endl;
+    // 输出详细的内存配置信息
+    Console = "页面数量为：" + to_string(SizeOfStack) + " 页，约 " +
+        to_string((float)SizeOfStack * PAGE_SIZE / 1048576) + " MB";
+    os.Print(Console);
     
-    // 初始化所有内存页面
-    for (int i = 0; i < SizeOfStack; i++) {
-        Page p;  // 创建新的页面对象
-        p.PageNumber = i;  // 设置页面编号
-        p.OccupiedTask = nullptr;  // 初始状态为空闲
-        Pages.push_back(p);  // 添加到页面列表
-    }
+    // 初始化页面占用位图，所有页面初始为空闲
+    Reset(SizeOfStack);
+    Console = "页表位图占用 " + to_string(Pages.FootprintBytes()) + " 字节";
+    os.Print(Console);
 
     // 输出初始化完成日志
     Console = "内存初始化完成。";
@@ -44,6 +66,50 @@ bool Memory::Init() {
     return 1;  // 返回成功状态
 }
 
+// 内存重置函数
+// 参数：PageCount - 页面数量
+// 功能：重建页面占用位图、每个节点的 TLSF 空闲页段索引，并清空占用者索引
+void Memory::Reset(long long PageCount) {
+    Pages.Init(PageCount);
+    for (int Node = 0; Node < NodeCount; Node++) {
+        long long First = max(1LL, NodeFirstPage(Node));  // 0 号页不分配，地址 0 表示未分配
+        Tlsf[Node].Init(First, NodeFirstPage(Node + 1) - First);
+    }
+    HugeSlackPages = 0;
+    CompactCursor = 0;
+    for (auto& Shard : Owners) {
+        Shard.Runs.clear();
+    }
+}
+
+// 节点首页号函数
+// 参数：Node - NUMA 节点编号，可以等于 NodeCount（此时返回总页数）
+// 返回值：该节点第一个页面的页号，页面按编号平均分给各节点
+long long Memory::NodeFirstPage(int Node) {
+    return Pages.PageCount() * Node / NodeCount;
+}
+
+// 页面所在节点函数
+// 参数：Page - 页号
+// 返回值：该页面所属的 NUMA 节点
+int Memory::NodeOf(long long Page) {
+    int Node = (int)(Page * NodeCount / Pages.PageCount());
+    while (Node + 1 < NodeCount && Page >= NodeFirstPage(Node + 1)) {
+        Node++;  // 整除取整的边界修正
+    }
+    while (Node > 0 && Page < NodeFirstPage(Node)) {
+        Node--;
+    }
+    return Node;
+}
+
+// 占用者索引分片查找函数
+// 参数：FirstPage - 页段首页号
+// 返回值：该页段所在区域对应的分片
+OwnerShard& Memory::ShardOf(long long FirstPage) {
+    return Owners[(FirstPage / OWNER_REGION_PAGES) % OWNER_SHARD_COUNT];
+}
+
 // 检查指定内存区域是否可用（未被占用）
 // 参数：Start - 起始地址，Size - 内存大小
 // 返回值：true-可用，false-已被占用
@@ -53,45 +119,414 @@ bool Memory::CheckMemory(long long Start, long long Size) {
     // 计算结束页面编号，减1是为了处理边界情况（包含起始地址+Size-1的页面）
     long long EndPageNumber = (Start + Size - 1) / PAGE_SIZE;
 
-    // 遍历所有相关的页面
-    for (long long i = StartPageNumber; i <= EndPageNumber; i++) {
-        // 检查页面是否已被任务占用
-        if (Pages[i].OccupiedTask != nullptr) {
-            return 0;  // 发现被占用的页面，返回不可用
+    // 逐字检查相关页面是否都空闲
+    return Pages.IsRangeFree(StartPageNumber, EndPageNumber - StartPageNumber + 1);
+}
+
+// 内存分配函数
+// 参数：Size - 内存大小，Owner - 占用这些页面的任务
+// 返回值：分配到的起始地址，失败返回 0
+// 功能：搜索满足对齐要求的空闲区域并标记占用。GlobalLock 模式下全程持有内存锁；
+//       Concurrent 模式下不加锁搜索，再用 CAS 占用页段，被其他 CPU 抢先时重新搜索；
+//       Tlsf 模式下持有内存锁，从 TLSF 索引直接取出一个足够长的空闲页段，
+//       不超过 SLAB_SIZE 的请求仍按请求大小对齐（slab 靠地址对齐判断归属），更大的只按页对齐
+long long Memory::Allocate(long long Size, Task* Owner, int PreferredNode) {
+    // Concurrent 模式以外都需要全局内存锁，unique_lock 在返回时自动释放
+    unique_lock<mutex> lock(MemoryLock, defer_lock);
+    if (Mode != MemoryMode::Concurrent) {
+        lock.lock();
+    }
+    return AllocateLocked(Size, Owner, PreferredNode);
+}
+
+// 内存分配函数（GlobalLock 和 Tlsf 模式下调用者需持有 MemoryLock）
+// 参数：Size - 内存大小，Owner - 占用这些页面的任务，PreferredNode - 优先使用的 NUMA 节点（-1 表示不限）
+// 返回值：分配到的起始地址，失败返回 0
+// 功能：先算出页数和对齐要求；启用大页时，不小于 HUGE_PAGE_MIN_SIZE 的请求先尝试按整 2MB 大页分配，
+//       找不到对齐的空闲大页时回退到 4KB 页。普通请求失败时先拆分大页、归还尾部多余的页面再试一次
+long long Memory::AllocateLocked(long long Size, Task* Owner, int PreferredNode) {
+    // 检查内存大小是否超过单次分配上限（16MB）
+    if (Size > ((long long)16 * 1024 * 1024)) {
+        return 0;  // 超过限制，分配失败
+    }
+
+    long long PageCount = (Size + PAGE_SIZE - 1) / PAGE_SIZE;
+    long long PageAlign = 1;
+    long long FirstPage = 1;
+    long long InitStart = PAGE_SIZE;
+    if (Mode == MemoryMode::Tlsf) {
+        // 不超过 SLAB_SIZE 的请求仍按请求大小对齐（slab 靠地址对齐判断归属），更大的只按页对齐
+        PageAlign = Size <= SLAB_SIZE ? PageCount : 1;
+        while ((PageAlign & (PageAlign - 1)) != 0) {
+            PageAlign++;  // 取不小于页数的 2 的幂
+        }
+    }
+    else {
+        // 计算内存对齐要求：找到不小于Size的最小2的幂
+        InitStart = 1;
+        while (1) {
+            if (InitStart >= Size) {
+                break;  // 找到合适的对齐值
+            }
+            else {
+                InitStart = InitStart * 2;  // 继续倍增
+            }
+        }
+
+        // 换算成页面粒度的对齐要求：对齐不足一页时页面本身就满足对齐，
+        // 只有 0 号页需要把起始地址放在 InitStart 处（地址 0 表示未分配）
+        PageAlign = max(1LL, InitStart / PAGE_SIZE);
+        FirstPage = InitStart < PAGE_SIZE ? 0 : InitStart / PAGE_SIZE;
+    }
+
+    // 大页：页数取整到 HUGE_PAGE_PAGES 的倍数，按 2MB 对齐
+    long long StartPageNumber = -1;
+    bool Huge = HugePages && Size >= HUGE_PAGE_MIN_SIZE;
+    if (Huge) {
+        long long HugeCount = (PageCount + HUGE_PAGE_PAGES - 1) / HUGE_PAGE_PAGES * HUGE_PAGE_PAGES;
+        StartPageNumber = ClaimRun(HugeCount, max(PageAlign, (long long)HUGE_PAGE_PAGES), FirstPage, PreferredNode);
+        if (StartPageNumber >= 0) {
+            HugeAllocations++;
+            HugeSlackPages += HugeCount - PageCount;
+            HugeSlackPeak = max(HugeSlackPeak.load(), HugeSlackPages.load());
+            RecordRun(StartPageNumber, PageRun{ HugeCount, Owner, true, PageCount });
+            return StartPageNumber * PAGE_SIZE;
         }
+        HugeFallbacks++;  // 没有对齐的空闲大页，回退到 4KB 页
     }
 
-    return 1;  // 所有页面都空闲，返回可用
+    StartPageNumber = ClaimRun(PageCount, PageAlign, FirstPage, PreferredNode);
+    if (StartPageNumber < 0 && !Huge && SplitHugePages(PageCount, PageAlign) > 0) {
+        StartPageNumber = ClaimRun(PageCount, PageAlign, FirstPage, PreferredNode);  // 拆分大页后重试
+    }
+    if (StartPageNumber < 0) {
+        return 0;  // 内存不足，分配失败
+    }
+    RecordRun(StartPageNumber, PageRun{ PageCount, Owner, false, PageCount });
+
+    return StartPageNumber == 0 ? InitStart : StartPageNumber * PAGE_SIZE;  // 分配成功
 }
 
-// ===================== Task 类成员函数实现 =====================
+// 页段占用函数（GlobalLock 和 Tlsf 模式下调用者需持有 MemoryLock）
+// 参数：Count - 页数，Align - 起始页号的对齐（页），FirstPage - 最小起始页号，PreferredNode - 优先的节点（-1 表示不限）
+// 返回值：占用的起始页号，失败返回 -1
+// 功能：先在优先节点内找，找不到再依次尝试编号更大的节点（回绕），页段不跨节点；不限节点时在整个位图中搜索。
+//       Tlsf 模式从该节点的 TLSF 索引取页段；GlobalLock 模式搜索位图后直接标记；
+//       Concurrent 模式乐观搜索后用 CAS 占用，被其他 CPU 抢先时重新搜索
+long long Memory::ClaimRun(long long Count, long long Align, long long FirstPage, int PreferredNode) {
+    bool AnyNode = PreferredNode < 0 && Mode != MemoryMode::Tlsf;
+    int Tries = AnyNode ? 1 : NodeCount;
+    for (int i = 0; i < Tries; i++) {
+        int Node = (max(PreferredNode, 0) + i) % NodeCount;
+        if (Mode == MemoryMode::Tlsf) {
+            long long StartPageNumber = Tlsf[Node].Allocate(Count, Align);
+            if (StartPageNumber >= 0) {
+                Pages.SetRange(StartPageNumber, Count);  // 位图仍然记录占用，供占用统计和 CheckMemory 使用
+                return StartPageNumber;
+            }
+            continue;
+        }
 
-// 任务构造函数
-// 参数：s - 任务标识符字符串
-// 功能：根据随机概率分布初始化任务的内存需求和执行时间
-Task::Task(string s) {
-    TaskId = s;  // 设置任务标识符
+        long long From = AnyNode ? FirstPage : max(FirstPage, NodeFirstPage(Node));
+        long long Limit = AnyNode ? Pages.PageCount() : NodeFirstPage(Node + 1);
+        while (1) {
+            // 在位图中逐字搜索第一个满足对齐要求的空闲页段
+            long long StartPageNumber = Pages.FindFreeRun(Count, Align, From, Limit);
+            if (StartPageNumber < 0) {
+                break;  // 该节点内存不足，换下一个节点
+            }
 
-    // 随机决定任务类型（基于内存大小分布）
-    int RandType = GetRandomIntThreadSafe() % 100 + 1;  // 生成1-100的随机数
+            // 标记页面为被占用
+            if (Mode == MemoryMode::GlobalLock) {
+                Pages.SetRange(StartPageNumber, Count);
+                return StartPageNumber;
+            }
+            if (Pages.TryClaimRange(StartPageNumber, Count)) {
+                return StartPageNumber;
+            }
+            // 搜索到占用之间被其他 CPU 抢先，重新搜索
+        }
+    }
+    return -1;  // 所有节点都不足
+}
 
-    // 按预设比例分配内存大小
-    if (RandType <= 60) {
-        // 60%概率：小内存任务 (1-128字节)
-        Size = (GetRandomIntThreadSafe() % 128LL) + 1;
+// 在占用者索引中记录页段
+void Memory::RecordRun(long long StartPageNumber, const PageRun& Run) {
+    OwnerShard& Shard = ShardOf(StartPageNumber);
+    lock_guard<mutex> ShardLock(Shard.Lock);
+    Shard.Runs[StartPageNumber] = Run;
+}
+
+// 大页拆分函数（GlobalLock 和 Tlsf 模式下调用者需持有 MemoryLock）
+// 参数：PageCount - 调用者需要的页数，PageAlign - 起始页号的对齐（页）
+// 返回值：归还的页面数
+// 功能：按需拆分尾部有多余页面的大页：降级为普通页段，只保留请求实际需要的页面，多余的页面归还；
+//       归还的尾部本身已能放下调用者的请求时立即停止。没有多余页面的大页不受影响，仍按大页映射
+long long Memory::SplitHugePages(long long PageCount, long long PageAlign) {
+    if (HugeSlackPages.load() == 0) {
+        return 0;  // 没有可以归还的尾部
     }
-    else if (RandType <= 95) {
-        // 35%概率：中等内存任务 (固定4KB)
-        Size = 4LL * 1024;
+    long long Returned = 0;
+    for (auto& Shard : Owners) {
+        lock_guard<mutex> ShardLock(Shard.Lock);
+        for (auto& Entry : Shard.Runs) {
+            PageRun& Run = Entry.second;
+            if (!Run.Huge || Run.NeededPages == Run.PageCount) {
+                continue;  // 不是大页，或者大页没有多余的尾部
+            }
+
+            // 先缩短页段记录，再清位图，页面重新可分配时记录已经一致
+            long long TailStart = Entry.first + Run.NeededPages;
+            long long TailCount = Run.PageCount - Run.NeededPages;
+            Run.Huge = false;
+            Run.PageCount = Run.NeededPages;
+            Pages.ClearRange(TailStart, TailCount);
+            if (Mode == MemoryMode::Tlsf) {
+                Tlsf[NodeOf(TailStart)].Release(TailStart, TailCount);
+            }
+            HugeSlackPages -= TailCount;
+            Returned += TailCount;
+            HugeSplits++;
+
+            // 尾部中第一个满足对齐的位置放得下请求，就不再拆分其他大页
+            long long AlignedStart = (TailStart + PageAlign - 1) / PageAlign * PageAlign;
+            if (AlignedStart + PageCount <= TailStart + TailCount) {
+                return Returned;
+            }
+        }
     }
-    else {
-        // 5%概率：大内存任务 (4KB-16MB范围随机)
-        Size = (GetRandomIntThreadSafe() % (16LL * 1024 * 1024 - 4 * 1024 + 1)) + 4LL * 1024;
+    return Returned;
+}
+
+// 内存区间释放函数（GlobalLock 和 Tlsf 模式下调用者需持有 MemoryLock）
+// 参数：Start - 起始地址，Size - 内存大小
+// 功能：根据内存块自身的起始地址和大小算出页段，只清除这些页面，代价与页段长度成正比；
+//       大页的页段比请求长，按页段记录中的页数释放
+void Memory::ReleaseLocked(long long Start, long long Size) {
+    long long StartPageNumber = Start / PAGE_SIZE;
+    long long EndPageNumber = (Start + Size - 1) / PAGE_SIZE;
+    long long Count = EndPageNumber - StartPageNumber + 1;
+
+    // 先移除占用者记录，再清位图，保证页面重新可分配时旧记录已不存在
+    OwnerShard& Shard = ShardOf(StartPageNumber);
+    {
+        lock_guard<mutex> ShardLock(Shard.Lock);
+        auto Found = Shard.Runs.find(StartPageNumber);
+        if (Found != Shard.Runs.end()) {
+            if (Found->second.Huge) {
+                Count = Found->second.PageCount;
+                HugeSlackPages -= Found->second.PageCount - Found->second.NeededPages;
+            }
+            Shard.Runs.erase(Found);
+        }
+    }
+    Pages.ClearRange(StartPageNumber, Count);
+    if (Mode == MemoryMode::Tlsf) {
+        Tlsf[NodeOf(StartPageNumber)].Release(StartPageNumber, Count);  // 与同一节点中相邻的空闲页段合并
+    }
+}
+
+// 内存区间释放函数
+// 参数：Start - 起始地址，Size - 内存大小
+// 功能：清除该区间覆盖的所有页面的占用标记，GlobalLock 和 Tlsf 模式下加全局内存锁
+void Memory::Release(long long Start, long long Size) {
+    unique_lock<mutex> lock(MemoryLock, defer_lock);
+    if (Mode != MemoryMode::Concurrent) {
+        lock.lock();
+    }
+    ReleaseLocked(Start, Size);
+}
+
+// 批量内存释放函数
+// 参数：Blocks - 若干 (起始地址, 大小)
+// 功能：整批只获取一次内存锁，减少多个释放之间的锁竞争
+void Memory::Release(const vector<pair<long long, long long>>& Blocks) {
+    if (Blocks.empty()) {
+        return;
+    }
+    unique_lock<mutex> lock(MemoryLock, defer_lock);
+    if (Mode != MemoryMode::Concurrent) {
+        lock.lock();
+    }
+    for (auto& Block : Blocks) {
+        ReleaseLocked(Block.first, Block.second);
+    }
+}
+
+// 内存整理函数（GlobalLock 模式，调用者需持有 MemoryLock）
+// 参数：Size - 需要腾出空间的请求大小，Movable - 允许搬移的任务，MovedPages - 累加搬移的页面数
+// 返回值：true-已腾出一段满足 Size 对齐要求的空闲页段，false-放弃
+// 功能：按对齐要求枚举候选窗口，统计窗口内页段需要搬移的页面数，选搬移最少的窗口；
+//       窗口内只要有一个页段不属于 Movable（slab、正在执行的任务、0 号页）就不能选。
+//       每次最多搬移 COMPACT_MAX_PAGES 页、检查 COMPACT_MAX_WINDOWS 个窗口，下一次从 CompactCursor 继续，
+//       每个窗口只从占用者索引中查出与它重叠的页段，所以整理是增量的，不会让其他 CPU 长时间等待
+bool Memory::CompactLocked(long long Size, const unordered_set<Task*>& Movable, long long& MovedPages) {
+    if (Size > ((long long)16 * 1024 * 1024)) {
+        return 0;  // 超过单次分配上限，整理也没有用
+    }
+
+    // 与 AllocateLocked 相同的对齐要求，窗口从 1 号页开始
+    long long InitStart = 1;
+    while (InitStart < Size) {
+        InitStart = InitStart * 2;
+    }
+    long long PageAlign = max(1LL, InitStart / PAGE_SIZE);
+    long long PageCount = (Size + PAGE_SIZE - 1) / PAGE_SIZE;
+
+    // 空闲页面总数都不够时，怎么搬也腾不出来
+    if (Pages.CountFree() < PageCount) {
+        return 0;
+    }
+
+    // 从上次停下的位置开始检查窗口，到末尾后回到开头，选搬移量最小的窗口
+    long long FirstWindow = PageAlign;
+    long long WindowCount = (Pages.PageCount() - PageCount) / PageAlign;  // 可选窗口总数
+    if (WindowCount <= 0) {
+        return 0;
+    }
+    long long Window = (CompactCursor + PageAlign - 1) / PageAlign * PageAlign;
+    long long BestWindow = -1;
+    long long BestCost = COMPACT_MAX_PAGES + 1;
+    vector<pair<long long, PageRun>> Runs;  // 当前窗口内的页段
+    for (long long Checked = 0; Checked < min(WindowCount, (long long)COMPACT_MAX_WINDOWS) && BestCost > 0; Checked++) {
+        if (Window < FirstWindow || Window + PageCount > Pages.PageCount()) {
+            Window = FirstWindow;
+        }
+        Runs.clear();
+        CollectRuns(Window, Window + PageCount, Runs);
+        long long Cost = 0;
+        long long Blocked = -1;  // 不能搬移的页段的末页号（不含）
+        for (auto& Run : Runs) {
+            if (Run.first == 0 || Movable.count(Run.second.OccupiedTask) == 0) {
+                Cost = -1;  // 有不能搬移的页段
+                Blocked = Run.first + Run.second.PageCount;
+                break;
+            }
+            Cost += Run.second.PageCount;
+            if (Cost >= BestCost) {
+                break;  // 不会比已找到的窗口更好
+            }
+        }
+        if (Cost >= 0 && Cost < BestCost) {
+            BestWindow = Window;
+            BestCost = Cost;
+        }
+        // 下一个窗口；包含不能搬移页段的窗口都不用再看，直接跳到该页段之后
+        Window += PageAlign;
+        if (Blocked > Window) {
+            Window = (Blocked + PageAlign - 1) / PageAlign * PageAlign;
+        }
+    }
+    CompactCursor = Window;
+    if (BestWindow < 0) {
+        return 0;  // 没有可以在预算内腾空的窗口
     }
 
+    // 把窗口内的页段逐个搬到窗口外，先占新页段、改占用者记录，再清旧页段
+    long long WindowEnd = BestWindow + PageCount;
+    Runs.clear();
+    CollectRuns(BestWindow, WindowEnd, Runs);
+    for (size_t i = 0; i < Runs.size(); i++) {
+        long long OldPage = Runs[i].first;
+        long long RunPages = Runs[i].second.PageCount;
+        Task* Owner = Runs[i].second.OccupiedTask;
+        // 被搬移的任务仍要满足它自己的对齐要求，大页还要按 2MB 对齐
+        long long OwnerAlign = 1;
+        while (OwnerAlign < Owner->Size) {
+            OwnerAlign = OwnerAlign * 2;
+        }
+        OwnerAlign = max(1LL, OwnerAlign / PAGE_SIZE);
+        if (Runs[i].second.Huge) {
+            OwnerAlign = max(OwnerAlign, (long long)HUGE_PAGE_PAGES);
+        }
+        // 先在原来的 NUMA 节点内找窗口外的位置，找不到再在整个内存中找
+        int OldNode = NodeOf(OldPage);
+        long long NodeStart = max(1LL, NodeFirstPage(OldNode));
+        long long NodeEnd = NodeFirstPage(OldNode + 1);
+        long long NewPage = Pages.FindFreeRun(RunPages, OwnerAlign, NodeStart, min(NodeEnd, BestWindow));
+        if (NewPage < 0) {
+            NewPage = Pages.FindFreeRun(RunPages, OwnerAlign, max(NodeStart, WindowEnd), NodeEnd);
+        }
+        if (NewPage < 0) {
+            NewPage = Pages.FindFreeRun(RunPages, OwnerAlign, 1, BestWindow);
+        }
+        if (NewPage < 0) {
+            NewPage = Pages.FindFreeRun(RunPages, OwnerAlign, WindowEnd, Pages.PageCount());
+        }
+        if (NewPage < 0) {
+            return 0;  // 窗口外放不下，已搬移的页段保持在新位置
+        }
+
+        Pages.SetRange(NewPage, RunPages);
+        {
+            OwnerShard& OldShard = ShardOf(OldPage);
+            lock_guard<mutex> ShardLock(OldShard.Lock);
+            OldShard.Runs.erase(OldPage);
+        }
+        {
+            OwnerShard& NewShard = ShardOf(NewPage);
+            lock_guard<mutex> ShardLock(NewShard.Lock);
+            NewShard.Runs[NewPage] = Runs[i].second;
+        }
+        Pages.ClearRange(OldPage, RunPages);
+        Owner->Start = NewPage * PAGE_SIZE;  // 任务的上下文保存点随页段移动
+        Owner->Node = NodeOf(NewPage);  // 可能搬到了其他节点，远程访问的代价按新节点计算
+        MovedPages += RunPages;
+    }
+    return 1;
+}
+
+// 页段收集函数（调用者需持有 MemoryLock）
+// 参数：From/To - 页面区间 [From, To)，Runs - 追加与区间重叠的页段
+// 功能：页段不超过 16 MB（OWNER_REGION_PAGES 页），所以只需查首页号在 [From - OWNER_REGION_PAGES, To)
+//       内的几个区域，每个区域在对应分片中二分查找，结果按首页号有序
+void Memory::CollectRuns(long long From, long long To, vector<pair<long long, PageRun>>& Runs) {
+    long long Low = max(0LL, From - OWNER_REGION_PAGES);
+    for (long long Region = Low / OWNER_REGION_PAGES; Region * OWNER_REGION_PAGES < To; Region++) {
+        long long RegionStart = max(Low, Region * OWNER_REGION_PAGES);
+        long long RegionEnd = min(To, (Region + 1) * OWNER_REGION_PAGES);
+        OwnerShard& Shard = ShardOf(Region * OWNER_REGION_PAGES);
+        lock_guard<mutex> ShardLock(Shard.Lock);
+        for (auto Entry = Shard.Runs.lower_bound(RegionStart); Entry != Shard.Runs.end() && Entry->first < RegionEnd; ++Entry) {
+            if (Entry->first + Entry->second.PageCount > From) {
+                Runs.push_back(*Entry);
+            }
+        }
+    }
+}
+
+// ===================== Task 类成员函数实现 =====================
+
+// 任务构造函数
+// 参数：CPUNumber - 创建任务的CPU编号，Index - 在该CPU任务池中的序号
+// 功能：根据随机概率分布初始化任务的内存需求和执行时间
+Task::Task(int CPUNumber, int Index) {
+    Id = ((uint64_t)CPUNumber << 32) | (uint32_t)Index;  // 设置任务编号，名称到输出时才格式化
+
+    // 按预设比例随机决定内存大小
+    Size = RandomTaskSize();
+
     // 随机生成任务执行时间（1-5秒）
     TotalTime = (GetRandomIntThreadSafe() % 5) + 1;
     RemainingTime = TotalTime;  // 初始化剩余时间为总时间
+
+    // 按比例随机决定任务类型（没有 I/O 密集型任务时不消耗随机数，保持原来的任务序列）
+    if (os.IoBoundPercent > 0 && GetRandomIntThreadSafe() % 100 < os.IoBoundPercent) {
+        Class = TaskClass::IoBound;
+    }
+}
+
+// 任务名称函数
+// 返回值：形如 "[CPU 0 的任务 3 ]" 的名称
+string Task::Name() const {
+    return NameOf(Id);
+}
+
+// 编号转名称函数
+// 参数：Id - 任务编号
+// 返回值：形如 "[CPU 0 的任务 3 ]" 的名称
+string Task::NameOf(uint64_t Id) {
+    return "[CPU " + to_string(Id >> 32) + " 的任务 " + to_string(Id & 0xFFFFFFFF) + " ]";
 }
 
 // 任务比较运算符重载（用于优先队列）
@@ -100,6 +535,176 @@ bool Task::operator<(const Task& other) const {
     return RemainingTime > other.RemainingTime;
 }
 
+// 就绪队列的堆比较函数：a 应排在 b 之后时返回 true，因此标准库的大顶堆算法得到的堆顶就是最先执行的任务
+// 功能：SJF 用 Task::operator<（剩余时间长的排在后面）；轮转按进入就绪队列的序号先进先出；
+//       MLFQ 先比较优先级，同级先进先出；公平调度先比较虚拟运行时间，相同时先进先出
+static bool TaskHeapLess(const Task* a, const Task* b) {
+    switch (os.Policy) {
+    case SchedulePolicy::RoundRobin:
+        return a->ReadySeq > b->ReadySeq;
+    case SchedulePolicy::Mlfq:
+        if (a->Level != b->Level) {
+            return a->Level > b->Level;
+        }
+        return a->ReadySeq > b->ReadySeq;
+    case SchedulePolicy::Fair:
+        if (a->VirtualRuntime != b->VirtualRuntime) {
+            return a->VirtualRuntime > b->VirtualRuntime;
+        }
+        return a->ReadySeq > b->ReadySeq;
+    default:
+        return *a < *b;
+    }
+}
+
+// 调度策略名称函数
+// 参数：Policy - 调度策略
+// 返回值：用于报告的名称
+static string PolicyName(SchedulePolicy Policy) {
+    switch (Policy) {
+    case SchedulePolicy::RoundRobin:
+        return "轮转（RR）";
+    case SchedulePolicy::Mlfq:
+        return "多级反馈队列（MLFQ）";
+    case SchedulePolicy::Fair:
+        return "公平调度（CFS）";
+    default:
+        return "最短作业优先（SJF）";
+    }
+}
+
+// 分布统计函数
+// 参数：Samples - 样本（时钟周期），函数内会排序
+// 返回值："平均 x，P50 x，P95 x，P99 x，最大 x" 形式的描述，分位数取最近秩，没有样本时返回 "无样本"
+static string Distribution(vector<long long>& Samples) {
+    if (Samples.empty()) {
+        return "无样本";
+    }
+    sort(Samples.begin(), Samples.end());
+    long long Total = 0;
+    for (long long Sample : Samples) {
+        Total += Sample;
+    }
+    size_t Count = Samples.size();
+    auto Percentile = [&](int P) { return to_string(Samples[(Count * P + 99) / 100 - 1]); };
+    return "平均 " + to_string((double)Total / Count) + "，P50 " + Percentile(50) + "，P95 " + Percentile(95) +
+        "，P99 " + Percentile(99) + "，最大 " + to_string(Samples.back());
+}
+
+// 分布摘要函数（直方图版本）
+// 参数：Histogram - 按桶计数的样本
+// 返回值：与上面相同格式的摘要，百分位取所在桶的下界（小于 64 的取值是精确的）
+static string Distribution(const LatencyHistogram& Histogram) {
+    if (Histogram.Total == 0) {
+        return "无样本";
+    }
+    return "平均 " + to_string((double)Histogram.Sum / Histogram.Total) + "，P50 " + to_string(Histogram.Percentile(0.50)) +
+        "，P95 " + to_string(Histogram.Percentile(0.95)) + "，P99 " + to_string(Histogram.Percentile(0.99)) +
+        "，最大 " + to_string(Histogram.Max);
+}
+
+// ===================== SlabCache 类成员函数实现 =====================
+
+// 标记被 slab 占用页面的占位任务，使这些页面不会被全局分配或被任务释放（CPU 编号 -1 不属于任何CPU）
+Task SlabPageOwner(-1, 0);
+
+// 计算大小对应的大小类下标：满足 (SLAB_MIN_OBJECT_SIZE << k) >= Size 的最小 k
+static int SlabSizeClass(long long Size) {
+    int SizeClass = 0;
+    while (((long long)SLAB_MIN_OBJECT_SIZE << SizeClass) < Size) {
+        SizeClass++;
+    }
+    return SizeClass;
+}
+
+// 判断 slab 是否已没有可分配的对象
+bool Slab::IsFull() const {
+    return FreeObjects.empty() && NextUnused >= Start + SLAB_SIZE;
+}
+
+// 从缓存分配一个小对象
+// 参数：Size - 对象大小（不超过 SLAB_MAX_OBJECT_SIZE）
+// 返回值：对象起始地址，无法从全局内存补充 slab 时返回 0
+// 功能：slab 按 SLAB_SIZE 对齐、对象大小为 2 的幂，因此对象地址天然满足对齐约定
+long long SlabCache::Allocate(long long Size) {
+    int SizeClass = SlabSizeClass(Size);
+    vector<long long>& Partial = PartialSlabs[SizeClass];
+
+    // 没有可用 slab 时，从全局内存一次性批量申请一整个 slab
+    if (Partial.empty()) {
+        long long SlabStart = os.MEMORY.Allocate(SLAB_SIZE, &SlabPageOwner, HomeNode);
+        if (SlabStart == 0) {
+            return 0;  // 全局内存不足
+        }
+        Slab& NewSlab = Slabs[SlabStart];
+        NewSlab.Start = SlabStart;
+        NewSlab.ObjectSize = (long long)SLAB_MIN_OBJECT_SIZE << SizeClass;
+        NewSlab.NextUnused = SlabStart;
+        Partial.push_back(SlabStart);
+    }
+
+    // 优先复用已释放的对象，否则切分新对象
+    Slab& Current = Slabs[Partial.back()];
+    long long Start = 0;
+    if (!Current.FreeObjects.empty()) {
+        Start = Current.FreeObjects.back();
+        Current.FreeObjects.pop_back();
+    }
+    else {
+        Start = Current.NextUnused;
+        Current.NextUnused += Current.ObjectSize;
+    }
+    Current.LiveObjects++;
+
+    // slab 已满则移出可用列表
+    if (Current.IsFull()) {
+        Partial.pop_back();
+    }
+
+    return Start;
+}
+
+// 判断地址是否属于本缓存的某个 slab
+bool SlabCache::Owns(long long Start) const {
+    return Slabs.count(Start & ~((long long)SLAB_SIZE - 1)) != 0;
+}
+
+// 释放一个对象
+// 参数：Start - 对象起始地址
+// 功能：对象放回所属 slab；slab 全空且同一大小类还有其他可用 slab 时归还全局内存
+void SlabCache::Free(long long Start) {
+    long long SlabStart = Start & ~((long long)SLAB_SIZE - 1);
+    Slab& Owner = Slabs[SlabStart];
+    vector<long long>& Partial = PartialSlabs[SlabSizeClass(Owner.ObjectSize)];
+
+    bool WasFull = Owner.IsFull();
+    Owner.FreeObjects.push_back(Start);
+    Owner.LiveObjects--;
+
+    if (WasFull) {
+        Partial.push_back(SlabStart);  // 重新变为可用
+    }
+
+    if (Owner.LiveObjects == 0 && Partial.size() > 1) {
+        Partial.erase(find(Partial.begin(), Partial.end(), SlabStart));
+        Slabs.erase(SlabStart);
+        os.MEMORY.Release(SlabStart, SLAB_SIZE);
+    }
+}
+
+// 把所有 slab 归还全局内存
+void SlabCache::Release() {
+    vector<pair<long long, long long>> Blocks;
+    for (auto& Entry : Slabs) {
+        Blocks.push_back({ Entry.first, SLAB_SIZE });
+    }
+    os.MEMORY.Release(Blocks);  // 一次加锁归还全部 slab
+    Slabs.clear();
+    for (auto& Partial : PartialSlabs) {
+        Partial.clear();
+    }
+}
+
 // ===================== CPU 类成员函数实现 =====================
 
 // CPU初始化函数
@@ -111,13 +716,23 @@ bool CPU::Init() {
     Console = "CPU " + to_string(CPUNumber) + " 初始化开始。";
     os.Print(Console);
 
-    // 初始化任务池，创建TASK_OF_EACH_CPU个任务
-    for (int i = 0; i < TASK_OF_EACH_CPU; i++) {
-        // 生成任务标识符
-        string TaskInfo = "[CPU " + to_string(CPUNumber) + " 的任务 " + to_string(i) + " ]";
-        Task task(TaskInfo);  // 创建任务对象
-        TaskPool.push_back(task);  // 添加到任务池
+    // 初始化任务池，创建TasksPerCPU个任务
+    TaskPool.reserve(os.TasksPerCPU);  // 一次性分配，之后任务地址不再变化
+    for (int i = 0; i < os.TasksPerCPU; i++) {
+        TaskPool.emplace_back(CPUNumber, i);  // 就地创建任务，编号由CPU编号和序号组成
+    }
+
+    // 所有任务进入就绪队列，线性建堆；队列预留好空间，调度循环中不再分配内存
+    ReadyQueue.clear();
+    ReadyQueue.reserve(TaskPool.size());
+    Blocked.reserve(TaskPool.size());
+    Retired.reserve(FREE_BATCH_TASKS);
+    ReleaseBuffer.reserve(FREE_BATCH_TASKS);
+    for (auto& task : TaskPool) {
+        task.ReadySeq = NextReadySeq++;
+        ReadyQueue.push_back(&task);
     }
+    make_heap(ReadyQueue.begin(), ReadyQueue.end(), TaskHeapLess);
 
     // 输出CPU初始化完成日志
     Console = "CPU " + to_string(CPUNumber) + " 初始化完成。";
@@ -126,95 +741,543 @@ bool CPU::Init() {
     return 1;  // 返回成功状态
 }
 
-// CPU工作函数（核心调度逻辑）
-// 功能：执行任务调度、内存分配和中断处理
+// 就绪队列入队函数
+// 参数：task - 要放回就绪队列的任务
+// 功能：上浮调整，O(log n)
+void CPU::PushReady(Task* task) {
+    lock_guard<mutex> Guard(QueueLock);
+    task->ReadySeq = NextReadySeq++;  // 同一优先级中排在最后
+    ReadyQueue.push_back(task);
+    push_heap(ReadyQueue.begin(), ReadyQueue.end(), TaskHeapLess);
+}
+
+// 就绪队列出队函数
+// 返回值：按调度策略最先执行的任务，队列为空时返回 nullptr
+// 功能：堆顶与末尾交换后下沉调整，O(log n)
+Task* CPU::PopReady() {
+    lock_guard<mutex> Guard(QueueLock);
+    if (ReadyQueue.empty()) {
+        return nullptr;
+    }
+    pop_heap(ReadyQueue.begin(), ReadyQueue.end(), TaskHeapLess);
+    Task* task = ReadyQueue.back();
+    ReadyQueue.pop_back();
+    return task;
+}
+
+// 就绪队列被窃取函数
+// 返回值：一个尚未分配内存的任务，没有时返回 nullptr
+// 功能：本 CPU 从堆顶取最优先的任务，窃取者则从另一端（堆的叶子）取，
+//       叶子上的任务要等得更久（SJF 下剩余时间也较长），值得迁移。只迁移尚未开始的任务，
+//       已分配内存的任务可能持有本 CPU 的 slab 对象，必须由本 CPU 释放
+Task* CPU::StealReady() {
+    lock_guard<mutex> Guard(QueueLock);
+    size_t Count = ReadyQueue.size();
+    for (size_t i = Count; i-- > Count / 2;) {  // 下标 >= Count/2 的都是叶子
+        Task* task = ReadyQueue[i];
+        if (task->Start != 0) {
+            continue;
+        }
+        // 叶子与末尾交换后删除，换过来的元素仍是叶子，只需上浮调整
+        ReadyQueue[i] = ReadyQueue.back();
+        ReadyQueue.pop_back();
+        if (i < ReadyQueue.size()) {
+            push_heap(ReadyQueue.begin(), ReadyQueue.begin() + i + 1, TaskHeapLess);
+        }
+        return task;
+    }
+    return nullptr;
+}
+
+// 就绪任务数函数
+// 返回值：就绪队列中的任务数
+size_t CPU::ReadyCount() {
+    lock_guard<mutex> Guard(QueueLock);
+    return ReadyQueue.size();
+}
+
+// CPU工作函数
+// 功能：实时模式下在本 CPU 线程中逐个时钟周期执行，直到任务池为空
 void CPU::CPUWork() {
+    BeginWork();
+
+    // 主任务执行循环，直到任务池为空
+    while (Step()) {
+    }
+
+    EndWork();
+}
+
+// CPU开始工作函数
+// 功能：输出工作开始日志
+void CPU::BeginWork() {
     string Console;  // 日志消息缓冲区
-    
+
     // 输出工作开始日志
     Console = "CPU " + to_string(CPUNumber) + " 开始工作。";
     os.Print(Console);
+}
 
-    // 主任务执行循环，直到任务池为空
-    while (!TaskPool.empty()) {
-        // 选择剩余时间最短的任务（最短作业优先调度策略）
-        auto ShortestTask = min_element(TaskPool.begin(), TaskPool.end(),
-            [](const Task& a, const Task& b) {
-                return a.RemainingTime < b.RemainingTime;
-            });
-
-        // 获取最短任务的索引位置
-        TaskNumber = (int)distance(TaskPool.begin(), ShortestTask);
-
-        // 输出任务选择信息
-        Console = "CPU " + to_string(CPUNumber) +
-            " 选择任务：" + TaskPool[TaskNumber].TaskId +
-            " （剩余时间：" + to_string(TaskPool[TaskNumber].RemainingTime) + " s）";
-        os.Print(Console);
+// CPU单步执行函数（核心调度逻辑）
+// 返回值：true-执行了一个时钟周期，false-任务池已空
+// 功能：先唤醒 I/O 已完成的任务，没有正在执行的任务时按调度策略选择任务并分配内存，
+//       然后执行一个时钟周期，检查中断（SJF 为随机中断，其他策略为时间片用完）、完成和 I/O 阻塞
+bool CPU::Step() {
+    // I/O 完成的任务回到就绪队列；MLFQ 定期提升优先级，防止低优先级的任务饿死
+    WakeBlocked();
+    if (os.Policy == SchedulePolicy::Mlfq && os.Now() - LastBoostAt >= os.MlfqBoostPeriod) {
+        BoostPriorities();
+    }
+
+    // 选择任务阶段：直到选中一个已分配内存的任务
+    while (Current == nullptr) {
+        // 从就绪队列取出堆顶的任务（按调度策略最先执行）
+        Current = PopReady();
+        if (Current == nullptr && os.Schedule == ScheduleMode::WorkStealing) {
+            // 自己的任务已经执行完，从其他 CPU 窃取
+            Current = os.Steal(*this);
+            if (Current != nullptr) {
+                os.Print(LogLevel::Debug, LogEventKind::Steal, *this);
+                // 公平调度：迁移来的任务从本 CPU 的虚拟运行时间下界开始，不能凭较小的值独占 CPU
+                Current->VirtualRuntime = max(Current->VirtualRuntime, MinVruntime);
+            }
+        }
+        if (Current == nullptr) {
+            if (Blocked.empty()) {
+                return 0;  // 没有剩余任务
+            }
+            // 剩下的任务都在等待 I/O，空转一个时钟周期；空转前先归还已完成任务的内存，不让其他 CPU 等
+            FreeRetired();
+            if (!os.VirtualTime) {
+                this_thread::sleep_for(chrono::seconds(1));
+            }
+            IdleTicks++;
+            return 1;
+        }
+
+        // 输出任务选择信息（每次调度都会输出，只记录结构化事件，输出时才格式化）
+        os.Print(LogLevel::Debug, LogEventKind::Select, *this, Current->RemainingTime);
 
         // 检查任务是否需要内存分配（Start为0表示未分配）
-        if (TaskPool[TaskNumber].Start == 0) {
-            // 请求操作系统分配内存
-            if (!os.New(*this)) {
-                // 内存分配失败，放弃该任务
-                Console = "CPU " + to_string(CPUNumber) +
-                    " 内存分配失败，跳过任务：" + TaskPool[TaskNumber].TaskId;
-                os.Print(Console);
-                TaskPool.erase(TaskPool.begin() + TaskNumber);  // 从任务池移除
+        if (Current->Start == 0) {
+            // 请求操作系统分配内存；失败时先释放攒着的已完成任务，再试一次
+            bool Allocated = os.New(*this);
+            if (!Allocated && !Retired.empty()) {
+                FreeRetired();
+                Allocated = os.New(*this);
+            }
+            if (!Allocated) {
+                // 内存分配失败，放弃该任务（不再放回就绪队列）
+                os.Print(LogLevel::Warn, LogEventKind::AllocationFailed, *this);
+                Current = nullptr;
                 continue;  // 继续处理下一个任务
             }
             // 内存分配成功，输出详细信息
-            Console = "CPU " + to_string(CPUNumber) +
-                " 分配内存起始地址：" + to_string(TaskPool[TaskNumber].Start) +
-                " (大小:" + to_string(TaskPool[TaskNumber].Size) + " B)";
-            os.Print(Console);
-        }
-
-        // 任务执行阶段：每秒递减剩余时间并检查中断
-        while (TaskPool[TaskNumber].RemainingTime > 0) {
-            this_thread::sleep_for(chrono::seconds(1));  // 模拟1秒执行时间
-            TaskPool[TaskNumber].RemainingTime--;  // 减少剩余时间
-
-            // 30%概率触发中断（模拟真实系统的中断机制）
-            if (GetRandomIntThreadSafe() % 10 < 3) {
-                os.Trap(*this);  // 调用操作系统中断处理
-
-                // 如果任务还有剩余时间，保存状态并放回任务池
-                if (TaskPool[TaskNumber].RemainingTime > 0) {
-                    Console = "CPU " + to_string(CPUNumber) +
-                        " 中断保存: " + TaskPool[TaskNumber].TaskId +
-                        " (剩余:" + to_string(TaskPool[TaskNumber].RemainingTime) + "s)";
-                    os.Print(Console);
-                }
+            os.Print(LogLevel::Debug, LogEventKind::Allocated, *this, Current->Start, Current->Size);
+        }
+
+        // 记录调度：第一次执行的时间用于响应时间，I/O 完成后等了多久才被调度用于唤醒等待
+        SliceTicks = 0;
+        if (Current->FirstRunAt < 0) {
+            Current->FirstRunAt = os.Now();
+        }
+        if (Current->ReadySince >= 0) {
+            WakeLatencies.Add((uint32_t)(os.Now() - Current->ReadySince));
+            Current->ReadySince = -1;
+        }
+        MinVruntime = max(MinVruntime, Current->VirtualRuntime);
+    }
+
+    // 任务的内存在其他NUMA节点时，每个时钟周期多花 NUMA_REMOTE_PENALTY_PERCENT% 的时间
+    bool Remote = os.MEMORY.NodeCount > 1 && Current->Node != HomeNode;
 
-                break;  // 退出当前时间片，进行任务切换
+    // 任务执行阶段：实时模式下真实等待1秒，虚拟时间模式下由事件队列推进时钟
+    if (!os.VirtualTime) {
+        this_thread::sleep_for(chrono::milliseconds(Remote ? 1000 + 10 * NUMA_REMOTE_PENALTY_PERCENT : 1000));  // 模拟1秒执行时间
+    }
+    if (Remote) {
+        RemoteTicks++;
+        StallPercent += NUMA_REMOTE_PENALTY_PERCENT;  // 虚拟时间模式下由 RunVirtual 折算成顺延的时钟周期
+        if (!os.VirtualTime) {
+            StallTicks += StallPercent / 100;  // 实时模式下已经多等待，只做统计
+            StallPercent %= 100;
+        }
+    }
+    Current->RemainingTime--;  // 减少剩余时间
+    BusyTicks++;
+    SliceTicks++;
+    Current->LevelTicks++;
+    Current->VirtualRuntime++;  // 所有任务权重相同，虚拟运行时间即执行的时钟周期数
+
+    // I/O 密集型任务在这个时钟周期内发起 I/O：主动让出 CPU（先于时钟中断），IO_WAIT_TICKS 个时钟周期后回到就绪队列
+    if (Current->RemainingTime > 0 && Current->Class == TaskClass::IoBound &&
+        GetRandomIntThreadSafe() % 100 < IO_BLOCK_PERCENT) {
+        Current->WakeAt = os.Now() + IO_WAIT_TICKS;
+        Blocked.push_back(Current);
+        Current = nullptr;
+        return 1;
+    }
+
+    // SJF 保持30%概率触发中断（模拟真实系统的中断机制）；其他策略在时间片用完时由时钟中断抢占
+    bool Interrupted = os.Policy == SchedulePolicy::Sjf ? GetRandomIntThreadSafe() % 10 < 3 : SliceExpired();
+    if (Interrupted) {
+        os.Trap(*this);  // 调用操作系统中断处理
+
+        // 如果任务还有剩余时间，保存状态并放回就绪队列，进行任务切换
+        if (Current->RemainingTime > 0) {
+            os.Print(LogLevel::Debug, LogEventKind::Preempted, *this, Current->RemainingTime);
+            PushReady(Current);
+            Current = nullptr;
+            return 1;
+        }
+    }
+
+    // 检查任务是否完成（剩余时间为0）
+    if (Current->RemainingTime == 0) {
+        // 输出任务完成信息
+        os.Print(LogLevel::Debug, LogEventKind::Completed, *this);
+
+        Current->CompletedAt = os.Now();  // 记录完成时间，用于周转时间
+        Retired.push_back(Current);  // 内存攒够一批后一起释放
+        Current = nullptr;  // 已完成任务不再放回就绪队列
+        if (Retired.size() >= FREE_BATCH_TASKS) {
+            FreeRetired();
+        }
+    }
+
+    return 1;
+}
+
+// 时间片检查函数（SJF 以外的策略在每个时钟周期结束时调用）
+// 返回值：true-当前任务应被抢占，放回就绪队列
+// 功能：轮转在用完固定时间片时抢占；公平调度把调度周期按就绪任务数平分作为时间片；
+//       MLFQ 在任务用完本级时间片时降一级（最低级只轮转），有更高优先级的任务就绪时立即抢占
+bool CPU::SliceExpired() {
+    switch (os.Policy) {
+    case SchedulePolicy::RoundRobin:
+        return SliceTicks >= os.Quantum;
+    case SchedulePolicy::Fair: {
+        long long Slice = max((long long)FAIR_MIN_GRANULARITY, (long long)(FAIR_LATENCY_TICKS / (ReadyCount() + 1)));
+        return SliceTicks >= Slice;
+    }
+    case SchedulePolicy::Mlfq: {
+        int Lowest = (int)os.MlfqQuanta.size() - 1;
+        if (Current->LevelTicks >= os.MlfqQuanta[Current->Level]) {
+            if (Current->Level < Lowest) {
+                Current->Level++;  // 用完本级的时间，说明是 CPU 密集型，降级
             }
+            Current->LevelTicks = 0;
+            return 1;
         }
+        lock_guard<mutex> Guard(QueueLock);
+        return !ReadyQueue.empty() && ReadyQueue.front()->Level < Current->Level;
+    }
+    default:
+        return 0;
+    }
+}
 
-        // 检查任务是否完成（剩余时间为0）
-        if (TaskPool[TaskNumber].RemainingTime == 0) {
-            // 输出任务完成信息
-            Console = "CPU " + to_string(CPUNumber) +
-                " 完成任务: " + TaskPool[TaskNumber].TaskId;
-            os.Print(Console);
-            
-            os.Free(*this);  // 释放任务占用的内存
-            TaskPool.erase(TaskPool.begin() + TaskNumber);  // 从任务池移除已完成任务
+// 唤醒函数
+// 功能：把 I/O 已完成的任务放回就绪队列，并记录回到就绪队列的时间。
+//       公平调度下睡眠的任务不能带着过小的虚拟运行时间回来长期独占 CPU，最多只补偿半个调度周期
+void CPU::WakeBlocked() {
+    long long Now = os.Now();
+    for (size_t i = 0; i < Blocked.size();) {
+        Task* task = Blocked[i];
+        if (task->WakeAt > Now) {
+            i++;
+            continue;
         }
+        Blocked[i] = Blocked.back();
+        Blocked.pop_back();
+        task->ReadySince = Now;
+        task->VirtualRuntime = max(task->VirtualRuntime, MinVruntime - FAIR_LATENCY_TICKS / 2);
+        PushReady(task);
     }
+}
+
+// 优先级提升函数（MLFQ）
+// 功能：把本 CPU 正在执行、等待 I/O 和就绪的任务都放回最高优先级并清零已用时间，然后重新建堆
+void CPU::BoostPriorities() {
+    LastBoostAt = os.Now();
+    Boosts++;
+    if (Current != nullptr) {
+        Current->Level = 0;
+        Current->LevelTicks = 0;
+    }
+    for (Task* task : Blocked) {
+        task->Level = 0;
+        task->LevelTicks = 0;
+    }
+
+    lock_guard<mutex> Guard(QueueLock);
+    for (Task* task : ReadyQueue) {
+        task->Level = 0;
+        task->LevelTicks = 0;
+    }
+    make_heap(ReadyQueue.begin(), ReadyQueue.end(), TaskHeapLess);
+}
+
+// 批量释放函数
+// 功能：把已完成任务的内存一次交还操作系统，页段只获取一次内存锁
+void CPU::FreeRetired() {
+    if (Retired.empty()) {
+        return;
+    }
+    os.Free(*this, Retired);
+    Retired.clear();
+}
+
+// CPU结束工作函数
+// 功能：释放剩余的已完成任务，归还 slab 缓存并输出工作结束日志
+void CPU::EndWork() {
+    string Console;  // 日志消息缓冲区
+
+    // 先释放还没释放的已完成任务，其中的 slab 对象要在归还 slab 缓存之前放回
+    FreeRetired();
+
+    // 把 slab 缓存占用的页面归还全局内存
+    Slabs.Release();
+
+    FinishedAt = os.Now();  // 记录结束时间，用于计算完成时间和利用率
 
     // 输出工作结束日志
     Console = "CPU " + to_string(CPUNumber) + " 工作结束。";
     os.Print(Console);
 }
 
+// ===================== Event 类成员函数实现 =====================
+
+// 事件比较运算符重载（用于优先队列）
+// 实现小顶堆排序，时间早的事件先处理，同一时刻按 CPU 编号处理
+bool Event::operator<(const Event& other) const {
+    if (Time != other.Time) {
+        return Time > other.Time;
+    }
+    return CPUNumber > other.CPUNumber;
+}
+
 // ===================== OS 类成员函数实现 =====================
 
+// 结构化日志格式化函数（在日志后台线程或 Sync 模式的输出时调用）
+// 参数：Event - OS::Print 记录的事件，Out - 追加输出的文本
+// 功能：还原成与原来逐条拼接时相同的文本，虚拟时间模式下带 "[T=时间] " 前缀
+static void FormatLogEvent(const LogEvent& Event, string& Out) {
+    if (Event.Time >= 0) {
+        Out += "[T=";
+        Out += to_string(Event.Time);
+        Out += "] ";
+    }
+    LogEventKind Kind = (LogEventKind)Event.Kind;
+    Out += Kind == LogEventKind::Trap ? "中断：CPU " : "CPU ";
+    Out += to_string(Event.Source);
+    switch (Kind) {
+    case LogEventKind::Steal:
+        Out += " 窃取任务：";
+        Out += Task::NameOf(Event.Subject);
+        break;
+    case LogEventKind::Select:
+        Out += " 选择任务：";
+        Out += Task::NameOf(Event.Subject);
+        Out += " （剩余时间：";
+        Out += to_string(Event.Values[0]);
+        Out += " s）";
+        break;
+    case LogEventKind::AllocationFailed:
+        Out += " 内存分配失败，跳过任务：";
+        Out += Task::NameOf(Event.Subject);
+        break;
+    case LogEventKind::Allocated:
+        Out += " 分配内存起始地址：";
+        Out += to_string(Event.Values[0]);
+        Out += " (大小:";
+        Out += to_string(Event.Values[1]);
+        Out += " B)";
+        break;
+    case LogEventKind::Preempted:
+        Out += " 中断保存: ";
+        Out += Task::NameOf(Event.Subject);
+        Out += " (剩余:";
+        Out += to_string(Event.Values[0]);
+        Out += "s)";
+        break;
+    case LogEventKind::Completed:
+        Out += " 完成任务: ";
+        Out += Task::NameOf(Event.Subject);
+        break;
+    case LogEventKind::Trap:
+        Out += "，任务 ";
+        Out += Task::NameOf(Event.Subject);
+        Out += " （剩余：";
+        Out += to_string(Event.Values[0]);
+        Out += " s）。";
+        break;
+    }
+}
+
+// 时间片列表解析函数
+// 参数：Text - 逗号分隔的正整数（如 "1,2,4"），Quanta - 输出的时间片列表
+// 返回值：true-格式正确且级数在 1 到 MLFQ_MAX_LEVELS 之间，false-格式错误
+static bool ParseQuanta(const string& Text, vector<int>& Quanta) {
+    Quanta.clear();
+    size_t Begin = 0;
+    while (Begin <= Text.size()) {
+        size_t End = Text.find(',', Begin);
+        if (End == string::npos) {
+            End = Text.size();
+        }
+        int Quantum = atoi(Text.substr(Begin, End - Begin).c_str());
+        if (Quantum <= 0) {
+            return 0;
+        }
+        Quanta.push_back(Quantum);
+        Begin = End + 1;
+    }
+    return Quanta.size() <= MLFQ_MAX_LEVELS;
+}
+
+// 命令行参数解析函数
+// 参数：argc/argv - main 的命令行参数
+// 返回值：true-参数合法，false-参数非法（已输出用法）
+bool OS::Configure(int argc, char* argv[]) {
+    vector<int> Quanta;  // --mlfq-quanta 的解析结果
+    for (int i = 1; i < argc; i++) {
+        string Argument = argv[i];
+        if (Argument == "--slab=on") {
+            SlabEnabled = true;
+        }
+        else if (Argument == "--slab=off") {
+            SlabEnabled = false;
+        }
+        else if (Argument == "--memory=global") {
+            MEMORY.Mode = MemoryMode::GlobalLock;
+        }
+        else if (Argument == "--memory=concurrent") {
+            MEMORY.Mode = MemoryMode::Concurrent;
+        }
+        else if (Argument == "--memory=tlsf") {
+            MEMORY.Mode = MemoryMode::Tlsf;
+        }
+        else if (Argument == "--schedule=static") {
+            Schedule = ScheduleMode::Static;
+        }
+        else if (Argument == "--schedule=steal") {
+            Schedule = ScheduleMode::WorkStealing;
+        }
+        else if (Argument == "--log=sync") {
+            Log.Mode = LogMode::Sync;
+        }
+        else if (Argument == "--log=text") {
+            Log.Mode = LogMode::Text;
+        }
+        else if (Argument == "--log=binary") {
+            Log.Mode = LogMode::Binary;
+        }
+        else if (Argument == "--log-level=debug") {
+            Log.Level = LogLevel::Debug;
+        }
+        else if (Argument == "--log-level=info") {
+            Log.Level = LogLevel::Info;
+        }
+        else if (Argument == "--log-level=warn") {
+            Log.Level = LogLevel::Warn;
+        }
+        else if (Argument == "--log-level=off") {
+            Log.Level = LogLevel::Off;
+        }
+        else if (Argument == "--bench-memory") {
+            BenchMemory = true;
+        }
+        else if (Argument == "--virtual") {
+            VirtualTime = true;
+        }
+        else if (Argument.rfind("--tasks=", 0) == 0 && atoi(Argument.c_str() + 8) > 0) {
+            TasksPerCPU = atoi(Argument.c_str() + 8);
+        }
+        else if (Argument.rfind("--numa=", 0) == 0 && atoi(Argument.c_str() + 7) >= 1 && atoi(Argument.c_str() + 7) <= NUMA_MAX_NODES) {
+            MEMORY.NodeCount = atoi(Argument.c_str() + 7);
+        }
+        else if (Argument == "--numa-policy=local") {
+            Numa = NumaPolicy::Local;
+        }
+        else if (Argument == "--numa-policy=interleave") {
+            Numa = NumaPolicy::Interleave;
+        }
+        else if (Argument == "--pin=on") {
+            PinThreads = true;
+        }
+        else if (Argument == "--pin=off") {
+            PinThreads = false;
+        }
+        else if (Argument == "--scheduler=sjf") {
+            Policy = SchedulePolicy::Sjf;
+        }
+        else if (Argument == "--scheduler=rr") {
+            Policy = SchedulePolicy::RoundRobin;
+        }
+        else if (Argument == "--scheduler=mlfq") {
+            Policy = SchedulePolicy::Mlfq;
+        }
+        else if (Argument == "--scheduler=cfs") {
+            Policy = SchedulePolicy::Fair;
+        }
+        else if (Argument.rfind("--quantum=", 0) == 0 && atoi(Argument.c_str() + 10) > 0) {
+            Quantum = atoi(Argument.c_str() + 10);
+        }
+        else if (Argument.rfind("--mlfq-quanta=", 0) == 0 && ParseQuanta(Argument.substr(14), Quanta)) {
+            MlfqQuanta = Quanta;
+        }
+        else if (Argument.rfind("--mlfq-boost=", 0) == 0 && atoi(Argument.c_str() + 13) > 0) {
+            MlfqBoostPeriod = atoi(Argument.c_str() + 13);
+        }
+        else if (Argument.rfind("--io-percent=", 0) == 0 && Argument.size() > 13 &&
+            atoi(Argument.c_str() + 13) >= 0 && atoi(Argument.c_str() + 13) <= 100) {
+            IoBoundPercent = atoi(Argument.c_str() + 13);
+        }
+        else if (Argument == "--huge=on") {
+            MEMORY.HugePages = true;
+        }
+        else if (Argument == "--huge=off") {
+            MEMORY.HugePages = false;
+        }
+        else if (Argument == "--compact=on") {
+            CompactEnabled = true;
+        }
+        else if (Argument == "--compact=off") {
+            CompactEnabled = false;
+        }
+        else if (Argument.rfind("--pages=", 0) == 0 && atoll(Argument.c_str() + 8) > 1) {
+            MEMORY.InitPages = atoll(Argument.c_str() + 8);
+        }
+        else if (Argument.rfind("--record=", 0) == 0) {
+            // 录制分配、释放和中断事件，供 --bench-trace 回放
+            if (!Recorder.Open(Argument.substr(9))) {
+                cout << "无法创建轨迹文件：" << Argument.substr(9) << endl;
+                return 0;
+            }
+        }
+        else if (!Bench.Parse(Argument)) {
+            cout << "使用方法: " << argv[0]
+                 << " [--slab=on|off] [--memory=global|concurrent|tlsf] [--bench-memory]"
+                 << " [--virtual] [--tasks=N] [--schedule=static|steal]"
+                 << " [--log=sync|text|binary] [--log-level=debug|info|warn|off] [--record=FILE]"
+                 << " [--compact=on|off] [--pages=N] [--huge=on|off]"
+                 << " [--numa=N] [--numa-policy=local|interleave] [--pin=on|off]"
+                 << " [--scheduler=sjf|rr|mlfq|cfs] [--quantum=N] [--mlfq-quanta=N,N,...] [--mlfq-boost=N] [--io-percent=N]"
+                 << BenchOptions::Usage() << endl;
+            return 0;
+        }
+    }
+    return 1;
+}
+
 // 操作系统初始化函数
 // 功能：初始化内存系统和所有CPU单元
 bool OS::Init() {
     string Console;  // 日志消息缓冲区
 
+    Log.Formatter = FormatLogEvent;  // 调度循环的结构化日志由后台线程格式化
+
     // 输出OS初始化开始日志
     Console = "OS初始化开始。";
     Print(Console);
@@ -230,12 +1293,30 @@ bool OS::Init() {
     Console = "随机的CPU数目为：" + to_string(NumberOfCPU);
     Print(Console);
 
-    // 初始化所有CPU单元
+    // 初始化所有CPU单元，就地构造，使就绪队列中的任务指针不因拷贝失效
     for (int i = 0; i < NumberOfCPU; i++) {
-        CPU cpu;  // 创建CPU对象
+        CPUS.emplace_back();  // 创建CPU对象并添加到CPU列表
+        CPU& cpu = CPUS.back();
         cpu.CPUNumber = i;  // 设置CPU编号
         cpu.Init();  // 初始化CPU
-        CPUS.push_back(cpu);  // 添加到CPU列表
+    }
+
+    // 工作窃取时任务会迁移到其他CPU，队列按任务总数预留，被窃取的任务放回就绪队列或阻塞时不再扩容
+    if (Schedule == ScheduleMode::WorkStealing) {
+        for (auto& cpu : CPUS) {
+            cpu.ReadyQueue.reserve((size_t)TasksPerCPU * NumberOfCPU);
+            cpu.Blocked.reserve((size_t)TasksPerCPU * NumberOfCPU);
+        }
+    }
+
+    // 把CPU按编号平均分到各个NUMA节点，slab 也从所在节点补充
+    if (MEMORY.NodeCount > 1) {
+        for (auto& cpu : CPUS) {
+            cpu.HomeNode = cpu.CPUNumber * MEMORY.NodeCount / NumberOfCPU;
+            cpu.Slabs.HomeNode = cpu.HomeNode;
+            Console = "CPU " + to_string(cpu.CPUNumber) + " 属于 NUMA 节点 " + to_string(cpu.HomeNode);
+            Print(Console);
+        }
     }
 
     // 输出OS初始化完成日志
@@ -246,15 +1327,26 @@ bool OS::Init() {
 }
 
 // 操作系统启动函数
-// 功能：创建并管理所有CPU线程的执行
+// 功能：创建并管理所有CPU线程的执行；虚拟时间模式下转交 RunVirtual
 void OS::Run() {
+    StartTime = chrono::steady_clock::now();
+    if (VirtualTime) {
+        RunVirtual();
+        return;
+    }
+
     // 创建CPU线程容器
     vector<thread>CpuThreads;
     
     // 为每个CPU创建执行线程
     for (auto& cpu : CPUS) {
         CpuThreads.push_back(std::thread(
-            [&cpu]() { cpu.CPUWork(); }  // Lambda表达式，调用CPU的工作函数
+            [&cpu]() {
+                if (os.PinThreads) {
+                    PinCurrentThread(cpu.CPUNumber);  // 绑定到主机核，真实的缓存效应才能体现出来
+                }
+                cpu.CPUWork();  // 调用CPU的工作函数
+            }
         ));
     }
 
@@ -262,108 +1354,452 @@ void OS::Run() {
     for (auto& i : CpuThreads) {
         i.join();  // 阻塞等待线程结束
     }
+
+    Report();  // 输出完成时间和利用率
+}
+
+// 虚拟时间模式启动函数
+// 功能：离散事件模拟。事件队列按虚拟时间排序，每个事件让一个 CPU 执行一个时钟周期，
+//       执行完后在下一个时钟周期重新入队，因此不需要真实等待，也不需要 CPU 线程
+void OS::RunVirtual() {
+    priority_queue<Event> Events;  // 待处理事件（小顶堆）
+
+    // 所有 CPU 在时刻 0 开始工作
+    for (auto& cpu : CPUS) {
+        cpu.BeginWork();
+        Events.push(Event{ 0, cpu.CPUNumber });
+    }
+
+    // 按时间顺序处理事件
+    while (!Events.empty()) {
+        Event Next = Events.top();
+        Events.pop();
+        VirtualNow = Next.Time;  // 推进虚拟时钟
+
+        CPU& cpu = CPUS[Next.CPUNumber];
+        if (cpu.Step()) {
+            // 下一个时钟周期，远程访问累计满一个时钟周期的开销时顺延
+            long long Stall = cpu.StallPercent / 100;
+            cpu.StallPercent %= 100;
+            cpu.StallTicks += Stall;
+            Events.push(Event{ Next.Time + 1 + Stall, Next.CPUNumber });
+        }
+        else {
+            cpu.EndWork();  // 任务池已空
+        }
+    }
+
+    // 输出模拟耗时
+    double Seconds = chrono::duration<double>(chrono::steady_clock::now() - StartTime).count();
+    string Console = "虚拟时间共 " + to_string(VirtualNow) + " 个时钟周期，实际耗时 " +
+        to_string(Seconds) + " 秒。";
+    Print(LogLevel::Report, Console);
+
+    Report();  // 输出完成时间和利用率
+}
+
+// 当前时间函数
+// 返回值：虚拟时间模式下为虚拟时钟，否则为启动以来经过的秒数
+long long OS::Now() {
+    if (VirtualTime) {
+        return VirtualNow;
+    }
+    return chrono::duration_cast<chrono::seconds>(chrono::steady_clock::now() - StartTime).count();
+}
+
+// 工作窃取函数
+// 参数：thief - 自己的就绪队列已空的CPU
+// 返回值：窃取到的任务，没有可窃取的任务时返回 nullptr
+// 功能：按就绪任务数从多到少依次尝试其他CPU，直到窃取到一个尚未开始的任务
+Task* OS::Steal(CPU& thief) {
+    bitset<CPU_MAX_NUMBER> Tried;  // 已尝试过的CPU，放在栈上，窃取时不分配内存
+    Tried[thief.CPUNumber] = true;
+
+    while (true) {
+        // 选择就绪任务最多的其他CPU
+        CPU* Victim = nullptr;
+        size_t Most = 0;
+        for (auto& cpu : CPUS) {
+            if (Tried[cpu.CPUNumber]) {
+                continue;
+            }
+            size_t Count = cpu.ReadyCount();
+            if (Count > Most) {
+                Most = Count;
+                Victim = &cpu;
+            }
+        }
+        if (Victim == nullptr) {
+            return nullptr;  // 所有CPU都没有可窃取的任务
+        }
+
+        Task* task = Victim->StealReady();
+        if (task != nullptr) {
+            thief.StolenTasks++;
+            return task;
+        }
+        Tried[Victim->CPUNumber] = true;  // 该CPU剩下的任务都已开始执行，换下一个
+    }
+}
+
+// 统计报告函数
+// 功能：输出完成时间（最后一个CPU结束工作的时间）以及每个CPU执行任务的时钟周期占完成时间的比例
+void OS::Report() {
+    long long Makespan = 0;
+    for (auto& cpu : CPUS) {
+        Makespan = max(Makespan, cpu.FinishedAt);
+    }
+
+    string Console = string("调度模式：") +
+        (Schedule == ScheduleMode::WorkStealing ? "工作窃取" : "静态划分") +
+        "，完成时间（makespan）：" + to_string(Makespan) + " 个时钟周期";
+    Print(LogLevel::Report, Console);
+
+    for (auto& cpu : CPUS) {
+        double Utilization = Makespan > 0 ? 100.0 * cpu.BusyTicks / Makespan : 0;
+        Console = "CPU " + to_string(cpu.CPUNumber) +
+            " 执行 " + to_string(cpu.BusyTicks) + " 个时钟周期，窃取 " + to_string(cpu.StolenTasks) +
+            " 个任务，利用率 " + to_string(Utilization) + "%";
+        Print(LogLevel::Report, Console);
+    }
+
+    // 调度策略的效果：所有任务在时刻 0 到达，周转时间即完成时间，响应时间即第一次执行的时间
+    vector<long long> Turnaround, Response, IoTurnaround, CpuTurnaround;
+    LatencyHistogram WakeLatencies;
+    long long IdleTicks = 0, Boosts = 0;
+    for (auto& cpu : CPUS) {
+        for (auto& task : cpu.TaskPool) {
+            if (task.CompletedAt < 0) {
+                continue;  // 分配失败被放弃的任务
+            }
+            Turnaround.push_back(task.CompletedAt);
+            Response.push_back(task.FirstRunAt);
+            (task.Class == TaskClass::IoBound ? IoTurnaround : CpuTurnaround).push_back(task.CompletedAt);
+        }
+        WakeLatencies.Merge(cpu.WakeLatencies);
+        IdleTicks += cpu.IdleTicks;
+        Boosts += cpu.Boosts;
+    }
+    size_t Completed = Turnaround.size();
+    Console = "调度策略：" + PolicyName(Policy);
+    if (Policy == SchedulePolicy::RoundRobin) {
+        Console += "，时间片 " + to_string(Quantum);
+    }
+    else if (Policy == SchedulePolicy::Mlfq) {
+        Console += "，各级时间片";
+        for (int Quantum : MlfqQuanta) {
+            Console += " " + to_string(Quantum);
+        }
+        Console += "，每 " + to_string(MlfqBoostPeriod) + " 个时钟周期提升优先级（共 " + to_string(Boosts) + " 次）";
+    }
+    Console += "，完成 " + to_string(Completed) + " 个任务（I/O 密集型 " + to_string(IoTurnaround.size()) +
+        " 个），吞吐量 " + to_string(Makespan > 0 ? (double)Completed / Makespan : 0) + " 个/时钟周期，空转 " +
+        to_string(IdleTicks) + " 个时钟周期";
+    Print(LogLevel::Report, Console);
+    Console = "周转时间：" + Distribution(Turnaround);
+    Print(LogLevel::Report, Console);
+    Console = "响应时间：" + Distribution(Response);
+    Print(LogLevel::Report, Console);
+    if (IoBoundPercent > 0) {
+        Console = "I/O 密集型任务周转时间：" + Distribution(IoTurnaround);
+        Print(LogLevel::Report, Console);
+        Console = "CPU 密集型任务周转时间：" + Distribution(CpuTurnaround);
+        Print(LogLevel::Report, Console);
+        Console = "I/O 完成到重新调度的等待：" + Distribution(WakeLatencies);
+        Print(LogLevel::Report, Console);
+    }
+
+    if (CompactEnabled) {
+        Console = "内存整理 " + to_string(CompactionRuns.load()) + " 次，搬移 " +
+            to_string(CompactedBytes.load()) + " 字节，挽救 " + to_string(RescuedAllocations.load()) + " 次分配";
+        Print(LogLevel::Report, Console);
+    }
+
+    if (MEMORY.NodeCount > 1) {
+        Console = to_string(MEMORY.NodeCount) + " 个 NUMA 节点，策略：" +
+            (Numa == NumaPolicy::Local ? "本地优先" : "交错") + "，本地分配 " + to_string(LocalAllocations.load()) +
+            " 次，远程分配 " + to_string(RemoteAllocations.load()) + " 次";
+        Print(LogLevel::Report, Console);
+        for (auto& cpu : CPUS) {
+            Console = "CPU " + to_string(cpu.CPUNumber) + "（节点 " + to_string(cpu.HomeNode) + "）远程执行 " +
+                to_string(cpu.RemoteTicks) + " 个时钟周期，因远程访问多用 " + to_string(cpu.StallTicks) + " 个时钟周期";
+            Print(LogLevel::Report, Console);
+        }
+    }
+
+    if (MEMORY.HugePages) {
+        Console = "大页分配 " + to_string(MEMORY.HugeAllocations.load()) + " 次，回退到 4KB 页 " +
+            to_string(MEMORY.HugeFallbacks.load()) + " 次，拆分 " + to_string(MEMORY.HugeSplits.load()) +
+            " 个，尾部浪费峰值 " + to_string(MEMORY.HugeSlackPeak.load() * PAGE_SIZE) + " 字节";
+        Print(LogLevel::Report, Console);
+    }
 }
 
 // 中断处理函数
 // 参数：cpu - 产生中断的CPU引用
 // 功能：记录中断信息并执行相应的中断处理程序
 void OS::Trap(CPU& cpu) {
-    // 构建中断信息消息
-    string msg = "中断：CPU " + to_string(cpu.CPUNumber) + 
-                "，任务 " + cpu.TaskPool[cpu.TaskNumber].TaskId + 
-                " （剩余：" + to_string(cpu.TaskPool[cpu.TaskNumber].RemainingTime) + " s）。";
-    Print(msg);  // 输出中断信息
+    cpu.Current->LastTrapAt = Now();  // 记录中断时间
+    if (Recorder.IsOpen()) {
+        Recorder.Record(TraceEvent::Trap, cpu.Current->LastTrapAt, cpu.CPUNumber, cpu.Current->TraceId, 0);
+    }
+
+    Print(LogLevel::Debug, LogEventKind::Trap, cpu, cpu.Current->RemainingTime);  // 输出中断信息
+}
+
+// 内存整理函数
+// 参数：task - 分配失败的任务，PreferredNode - 重新分配时优先的 NUMA 节点（-1 表示不限）
+// 返回值：整理后重新分配到的起始地址，失败返回 0
+// 功能：先取内存锁，再取所有CPU的就绪队列锁（其他地方不会在持有队列锁时申请内存，不会死锁），
+//       队列中已分配内存的任务这时不会被取出执行，可以安全地搬移它们的页段并更新 Start。
+//       只在 GlobalLock 模式下进行：Concurrent 模式没有能让其他分配暂停的锁，
+//       Tlsf 模式的空闲页段由 TLSF 索引管理，不能指定位置分配
+long long OS::Compact(Task& task, int PreferredNode) {
+    if (MEMORY.Mode != MemoryMode::GlobalLock) {
+        return 0;
+    }
+
+    lock_guard<mutex> MemoryGuard(MEMORY.MemoryLock);
+    vector<unique_lock<mutex>> QueueGuards;
+    unordered_set<Task*> Movable;
+    for (auto& cpu : CPUS) {
+        QueueGuards.emplace_back(cpu.QueueLock);
+        for (Task* Waiting : cpu.ReadyQueue) {
+            if (Waiting->Start != 0) {
+                Movable.insert(Waiting);  // 被中断后在队列中等待的任务
+            }
+        }
+    }
+
+    CompactionRuns++;
+    long long MovedPages = 0;
+    bool Success = MEMORY.CompactLocked(task.Size, Movable, MovedPages);
+    CompactedBytes += MovedPages * PAGE_SIZE;
+    if (!Success) {
+        return 0;
+    }
+
+    long long Start = MEMORY.AllocateLocked(task.Size, &task, PreferredNode);
+    if (Start != 0) {
+        RescuedAllocations++;
+    }
+    return Start;
 }
 
 // 内存分配函数（系统调用）
 // 参数：cpu - 请求内存的CPU引用
 // 返回值：true-分配成功，false-分配失败
-// 功能：为指定CPU的当前任务分配对齐的内存空间
+// 功能：为指定CPU的当前任务分配对齐的内存空间，小任务优先走本 CPU 的 slab 缓存
 bool OS::New(CPU& cpu) {
-    // 使用lock_guard自动管理互斥锁，确保内存操作的原子性
-    lock_guard<mutex> lock(MEMORY.MemoryLock);
+    Task& task = *cpu.Current;
 
-    // 获取当前任务的内存需求大小
-    long long Size = cpu.TaskPool[cpu.TaskNumber].Size;
-    
-    // 检查内存大小是否超过单次分配上限（16MB）
-    if (Size > ((long long)16 * 1024 * 1024)) {
-        return 0;  // 超过限制，分配失败
+    // NUMA：本地优先策略从本 CPU 所在节点开始找，交错策略轮流从各节点开始找
+    int PreferredNode = -1;
+    if (MEMORY.NodeCount > 1) {
+        PreferredNode = Numa == NumaPolicy::Local ? cpu.HomeNode : NextInterleaveNode++ % MEMORY.NodeCount;
     }
 
-    // 计算内存对齐要求：找到不小于Size的最小2的幂
-    long long InitStart = 1;
-    while (1) {
-        if (InitStart >= Size) {
-            break;  // 找到合适的对齐值
+    // 小对象：从本 CPU 的 slab 缓存分配，不经过全局内存锁
+    long long Start = 0;
+    if (SlabEnabled && task.Size <= SLAB_MAX_OBJECT_SIZE) {
+        Start = cpu.Slabs.Allocate(task.Size);
+    }
+
+    // 其余请求（以及 slab 无法补充时）走全局内存
+    if (Start == 0) {
+        Start = MEMORY.Allocate(task.Size, &task, PreferredNode);
+        if (Start == 0 && CompactEnabled) {
+            Start = Compact(task, PreferredNode);  // 空闲页面足够但不连续时，整理后再试一次
         }
-        else {
-            InitStart = InitStart * 2;  // 继续倍增
+        if (Start == 0) {
+            return 0;  // 内存不足，分配失败
         }
     }
 
-    // 计算总内存大小（页面数×页面大小）
-    long long total_memory_size = (long long)PAGE_SIZE * (long long)MEMORY.Pages.size();
-    
-    // 按照对齐要求搜索可用内存区域
-    for (long long Start = InitStart; Start <= total_memory_size - Size; Start = Start + InitStart) {
-        // 检查该内存区域是否可用
-        if (MEMORY.CheckMemory(Start, Size)) {
-            // 计算涉及的页面范围
-            long long StartPageNumber = Start / PAGE_SIZE;
-            long long EndPageNumber = (Start + Size - 1) / PAGE_SIZE;
-
-            // 标记所有相关页面为被当前任务占用
-            for (long long i = StartPageNumber; i <= EndPageNumber; i++) {
-                MEMORY.Pages[i].OccupiedTask = &cpu.TaskPool[cpu.TaskNumber];
-            }
-
-            // 设置任务的起始地址
-            cpu.TaskPool[cpu.TaskNumber].Start = Start;
-
-            return 1;  // 分配成功
+    // 设置任务的起始地址
+    task.Start = Start;
+    task.AllocatedAt = Now();  // 记录分配时间
+    task.Node = MEMORY.NodeOf(Start / PAGE_SIZE);
+    if (MEMORY.NodeCount > 1) {
+        if (task.Node == cpu.HomeNode) {
+            LocalAllocations++;
+        }
+        else {
+            RemoteAllocations++;
         }
     }
 
-    return 0;  // 内存不足，分配失败
+    // 录制轨迹：为这次分配编号，释放和中断时引用该编号
+    if (Recorder.IsOpen()) {
+        task.TraceId = Recorder.NextId();
+        Recorder.Record(TraceEvent::Allocate, task.AllocatedAt, cpu.CPUNumber, task.TraceId, (uint32_t)task.Size);
+    }
+
+    return 1;  // 分配成功
 }
 
 // 内存释放函数（系统调用）
-// 参数：cpu - 请求释放的CPU引用
+// 参数：cpu - 请求释放的CPU引用，Tasks - 该CPU上已完成的任务
 // 返回值：true-释放成功
-// 功能：释放指定CPU当前任务占用的所有内存页面
-bool OS::Free(CPU& cpu) {
-    // 使用lock_guard自动管理互斥锁，确保线程安全
-    lock_guard<mutex> lock(MEMORY.MemoryLock);
-
-    // 遍历所有内存页面，释放被当前任务占用的页面
-    for (auto& p : MEMORY.Pages) {
-        if (p.OccupiedTask == &cpu.TaskPool[cpu.TaskNumber]) {
-            p.OccupiedTask = nullptr;  // 清除占用标记
+// 功能：slab 对象放回本 CPU 缓存，其余页段收集到 CPU 预留的缓冲区合并成一批，只获取一次内存锁，不分配内存
+bool OS::Free(CPU& cpu, const vector<Task*>& Tasks) {
+    vector<pair<long long, long long>>& Blocks = cpu.ReleaseBuffer;
+    long long FreedAt = Now();
+    for (Task* task : Tasks) {
+        if (task->Start == 0) {
+            continue;  // 尚未分配内存
+        }
+        task->FreedAt = FreedAt;
+        if (task->TraceId != 0) {
+            Recorder.Record(TraceEvent::Free, FreedAt, cpu.CPUNumber, task->TraceId, (uint32_t)task->Size);
+            task->TraceId = 0;
+        }
+        if (cpu.Slabs.Owns(task->Start)) {
+            cpu.Slabs.Free(task->Start);
         }
+        else {
+            Blocks.push_back({ task->Start, task->Size });
+        }
+        task->Start = 0;
     }
 
-    // 重置任务的起始地址
-    cpu.TaskPool[cpu.TaskNumber].Start = 0;
+    MEMORY.Release(Blocks);
+    Blocks.clear();  // 保留容量给下一批
 
     return 1;  // 释放成功
 }
 
 // 线程安全的输出函数
 // 参数：Text - 要输出的文本内容
-// 功能：使用互斥锁确保多线程环境下的输出不会交错
+// 功能：以 Info 级别输出
 void OS::Print(string& Text) {
-    Output.lock();  // 获取输出锁
-    cout << Text << endl;  // 输出文本
-    Output.unlock();  // 释放输出锁
+    Print(LogLevel::Info, Text);
+}
+
+// 线程安全的输出函数
+// 参数：Level - 日志级别，Text - 要输出的文本内容
+// 功能：交给异步日志，写入本线程的缓冲区后立即返回，由后台线程批量输出
+void OS::Print(LogLevel Level, string& Text) {
+    if (!Log.Enabled(Level)) {
+        return;
+    }
+    if (VirtualTime) {
+        Log.Write(Level, "[T=" + to_string(VirtualNow) + "] " + Text);  // 虚拟时间模式下标注事件时间
+        return;
+    }
+    Log.Write(Level, Text);
+}
+
+// 结构化事件输出函数
+// 参数：Level - 日志级别，Kind - 事件类型，cpu - 产生事件的CPU（事件针对它的当前任务），First/Second - 事件参数
+// 功能：只把编号和参数填进定长记录交给异步日志，不拼接字符串也不分配内存，输出时由 FormatLogEvent 格式化
+void OS::Print(LogLevel Level, LogEventKind Kind, CPU& cpu, long long First, long long Second) {
+    if (!Log.Enabled(Level)) {
+        return;
+    }
+    LogEvent Event;
+    Event.Time = VirtualTime ? VirtualNow : -1;
+    Event.Subject = cpu.Current->Id;
+    Event.Values[0] = First;
+    Event.Values[1] = Second;
+    Event.Kind = (uint32_t)Kind;
+    Event.Source = cpu.CPUNumber;
+    Log.Write(Level, Event);
+}
+
+// ===================== 内存基准测试 =====================
+
+// 基准测试适配器
+// 功能：把全局内存（两种分配模式，可选每线程 slab 缓存）包装成 AllocBench 的接口
+class MemoryBenchAllocator : public BenchAllocator
+{
+public:
+    MemoryBenchAllocator(MemoryMode Mode, bool UseSlab, long long PageCount)
+        : Mode(Mode), UseSlab(UseSlab), PageCount(PageCount) {}
+
+    string Name() const override {
+        string ModeName = Mode == MemoryMode::GlobalLock ? "全局锁" : Mode == MemoryMode::Concurrent ? "并发" : "TLSF";
+        return ModeName + (UseSlab ? " + slab 缓存" : "");
+    }
+
+    // 重置为 PageCount 个空闲页面，使每轮测试的内存容量固定
+    void Reset() override {
+        os.MEMORY.Mode = Mode;
+        os.MEMORY.Reset(PageCount);
+    }
+
+    long long Allocate(long long Size) override {
+        if (UseSlab && Size <= SLAB_MAX_OBJECT_SIZE) {
+            long long Start = LocalSlabs().Allocate(Size);
+            if (Start != 0) {
+                return Start;
+            }
+        }
+        return os.MEMORY.Allocate(Size, nullptr);
+    }
+
+    void Release(long long Handle, long long Size) override {
+        if (UseSlab && LocalSlabs().Owns(Handle)) {
+            LocalSlabs().Free(Handle);
+            return;
+        }
+        os.MEMORY.Release(Handle, Size);
+    }
+
+    void ThreadExit() override {
+        if (UseSlab) {
+            LocalSlabs().Release();
+        }
+    }
+
+    // 已占用页面数乘以页大小
+    long long FootprintBytes() override {
+        return (os.MEMORY.Pages.PageCount() - os.MEMORY.Pages.CountFree()) * PAGE_SIZE;
+    }
+
+private:
+    MemoryMode Mode;  // 分配模式
+    bool UseSlab;     // 小对象是否走每线程 slab 缓存
+    long long PageCount;  // 每轮测试的页面数
+
+    // 每个测试线程自己的 slab 缓存，相当于每个 CPU 一个
+    static SlabCache& LocalSlabs() {
+        thread_local SlabCache Cache;
+        return Cache;
+    }
+};
+
+// 内存分配基准测试
+// 功能：用固定种子的操作序列，对全局锁、并发、TLSF 三种模式（各自带或不带 slab 缓存）
+//       从 1 到 MaxThreads 个线程逐轮测试，输出吞吐量、延迟百分位、峰值占用、碎片率和失败次数。
+//       内存容量默认为 MAX_PAGES 页，可用 --bench-capacity 调小以比较各模式在内存紧张时的失败次数
+void RunMemoryBenchmark() {
+    AllocBench Bench(os.Bench);
+    long long PageCount = os.Bench.CapacityMB > 0 ? os.Bench.CapacityMB * 1048576 / PAGE_SIZE : MAX_PAGES;
+    for (MemoryMode Mode : { MemoryMode::GlobalLock, MemoryMode::Concurrent, MemoryMode::Tlsf }) {
+        for (bool UseSlab : { false, true }) {
+            MemoryBenchAllocator Allocator(Mode, UseSlab, PageCount);
+            if (!Bench.Run(Allocator)) {
+                return;  // 轨迹文件无效
+            }
+        }
+    }
 }
 
 // ===================== 主函数 =====================
 
 // 程序入口点
-// 功能：创建操作系统实例并启动运行
-int main() {
+// 功能：解析命令行参数，创建操作系统实例并启动运行
+int main(int argc, char* argv[]) {
+    if (!os.Configure(argc, argv)) {
+        return 1;  // 参数非法
+    }
+    if (os.BenchMemory) {
+        RunMemoryBenchmark();  // 只运行内存基准测试
+        return 0;
+    }
     os.Init();  // 初始化操作系统
     os.Run();   // 启动操作系统运行
+    os.Recorder.Close();  // 写出剩余的轨迹记录
     return 0;   // 程序正常退出
 }
\ No newline at end of file
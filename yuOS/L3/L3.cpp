@@ -6,19 +6,21 @@ bool Memory::Init() {
 	// 随机一个页面数量
 	int SizeOfStack = 0;
 	SizeOfStack = GetRandomIntThreadSafe() % (MAX_PAGES - MIN_PAGES + 1) + MIN_PAGES; // 保证结果为64MB~4GB
+	if (InitPages > 0) {
+		SizeOfStack = (int)InitPages; // --pages 指定
+	}
 
 	string Console;
 
 	Console = "内存初始化开始。";
 	os.Print(Console);
-	cout << "随机的页面数量为：" << to_string(SizeOfStack) << " 页，约 " << to_string((float)SizeOfStack * PAGE_SIZE / 1048576) << " MB" << endl;
+	Console = "页面数量为：" + to_string(SizeOfStack) + " 页，约 " + to_string((float)SizeOfStack * PAGE_SIZE / 1048576) + " MB";
 	os.Print(Console);
 
-	for (int i = 0; i < SizeOfStack; i++) {
-		Page p;
-		p.PageNumber = i;
-		Pages.push_back(p);
-	}
+	// 所有页面初始为空闲
+	Reset(SizeOfStack);
+	Console = "页表位图占用 " + to_string(Pages.FootprintBytes()) + " 字节";
+	os.Print(Console);
 
 	Console = "内存初始化完成。";
 	os.Print(Console);
@@ -26,290 +28,1995 @@ bool Memory::Init() {
 	return 1;
 }
 
+// 按给定页面数重置内存，所有页面空闲
+void Memory::Reset(long long PageCount) {
+
+	Pages.Init(PageCount);
+	for (int Node = 0; Node < NodeCount; Node++) {
+		long long First = max(1LL, NodeFirstPage(Node)); // 0 号页不分配
+		Tlsf[Node].Init(First, NodeFirstPage(Node + 1) - First);
+	}
+	HugeSlackPages = 0;
+	CompactCursor = 0;
+	for (auto& Shard : Owners) {
+		Shard.Runs.clear();
+	}
+}
+
+// 页段首页号所在的占用者索引分片
+OwnerShard& Memory::ShardOf(long long FirstPage) {
+	return Owners[(FirstPage / OWNER_REGION_PAGES) % OWNER_SHARD_COUNT];
+}
+
+// 节点的第一个页号，页面按编号平均分给各节点
+long long Memory::NodeFirstPage(int Node) {
+	return Pages.PageCount() * Node / NodeCount;
+}
+
+// 页面所在的节点
+int Memory::NodeOf(long long Page) {
+
+	int Node = (int)(Page * NodeCount / Pages.PageCount());
+	while (Node + 1 < NodeCount && Page >= NodeFirstPage(Node + 1)) {
+		Node++; // 整除取整的边界修正
+	}
+	while (Node > 0 && Page < NodeFirstPage(Node)) {
+		Node--;
+	}
+	return Node;
+}
+
 // 检查某块内存是否已经被占用，
 bool Memory::CheckMemory(long long Start, long long Size) {
 
 	long long StartPageNumber = Start / PAGE_SIZE; // 起始页面编号
 	long long EndPageNumber = (Start + Size - 1) / PAGE_SIZE; // 结束页面编号，此处减一原因同L1
 
-	for (long long i = StartPageNumber; i <= EndPageNumber; i++) {
-		// 若有重叠
-		if (Pages[i].OccupiedTask != nullptr) {
-			return 0;
-		}
-	}
-
-	// 没有重叠
-	return 1;
+	// 逐字检查是否有重叠
+	return Pages.IsRangeFree(StartPageNumber, EndPageNumber - StartPageNumber + 1);
 }
 
-// 构造函数
-Task::Task(string s) {
+// 按对齐约定分配一段内存并标记占用者，成功返回起始地址，失败返回 0
+// Concurrent 模式下不加全局锁：乐观搜索后 CAS 占用，被抢先则重新搜索
+// Tlsf 模式下直接从 TLSF 索引取页段，不超过 SLAB_SIZE 的请求仍按大小对齐（slab 需要），更大的只按页对齐
+long long Memory::Allocate(long long Size, Task* Owner, int PreferredNode) {
 
-	TaskId = s;
+	// 因为有多个 return 路径，手动unlock会很麻烦，使用自动unlock；Concurrent 模式不加锁
+	unique_lock<mutex> lock(MemoryLock, defer_lock);
+	if (Mode != MemoryMode::Concurrent) {
+		lock.lock();
+	}
+	return AllocateLocked(Size, Owner, PreferredNode);
+}
 
-	// 随机决定分配哪种大小的内存
-	int RandType = GetRandomIntThreadSafe() % 100 + 1; // 1-100
+// 同 Allocate，GlobalLock 和 Tlsf 模式下调用者需持有 MemoryLock
+// 启用大页时，不小于 HUGE_PAGE_MIN_SIZE 的请求先按整 2MB 大页分配，没有对齐的空闲大页就回退到 4KB 页；
+// 普通请求失败时先拆分大页、归还尾部多余的页面再试一次
+long long Memory::AllocateLocked(long long Size, Task* Owner, int PreferredNode) {
 
-	// 按比例分配内存大小
-	if (RandType <= 60) {
-		// 小内存 (1-128字节)
-		Size = (GetRandomIntThreadSafe() % 128LL) + 1;
+	// 超过16MB不行
+	if (Size > ((long long)16 * 1024 * 1024)) {
+		return 0;
 	}
-	else if (RandType <= 95) {
-		// 中等内存 (4KB)
-		Size = 4LL * 1024;
+
+	long long PageCount = (Size + PAGE_SIZE - 1) / PAGE_SIZE;
+	long long PageAlign = 1;
+	long long FirstPage = 1;
+	long long InitStart = PAGE_SIZE;
+	if (Mode == MemoryMode::Tlsf) {
+		// 不超过 SLAB_SIZE 的请求仍按大小对齐（slab 需要），更大的只按页对齐
+		PageAlign = Size <= SLAB_SIZE ? PageCount : 1;
+		while ((PageAlign & (PageAlign - 1)) != 0) {
+			PageAlign++;
+		}
 	}
 	else {
-		// 大内存 (4KB-16MB)
-		Size = (GetRandomIntThreadSafe() % (16LL * 1024 * 1024 - 4 * 1024 + 1)) + 4LL * 1024;
+		// 对于大小为 s 的内存分配请求，返回的内存地址必须对齐到2^i，且 2^i >= s。
+		InitStart = 1;
+		while (1) {
+
+			if (InitStart >= Size) {
+				break;
+			}
+			else {
+				// 由于之前的16MB限制，无需担心超过 long long 的范围
+				InitStart = InitStart * 2;
+			}
+		}
+
+		// 换算成页面粒度：对齐不足一页时页面本身就满足对齐，只有 0 号页要从 InitStart 开始（地址 0 表示未分配）
+		PageAlign = max(1LL, InitStart / PAGE_SIZE);
+		FirstPage = InitStart < PAGE_SIZE ? 0 : InitStart / PAGE_SIZE;
 	}
 
-	// 随机时间，1-5秒
-	TotalTime = (GetRandomIntThreadSafe() % 5) + 1;
-	RemainingTime = TotalTime; // 初始化剩余时间
-}
+	// 大页：页数取整到 HUGE_PAGE_PAGES 的倍数，按 2MB 对齐
+	long long StartPageNumber = -1;
+	bool Huge = HugePages && Size >= HUGE_PAGE_MIN_SIZE;
+	if (Huge) {
+		long long HugeCount = (PageCount + HUGE_PAGE_PAGES - 1) / HUGE_PAGE_PAGES * HUGE_PAGE_PAGES;
+		StartPageNumber = ClaimRun(HugeCount, max(PageAlign, (long long)HUGE_PAGE_PAGES), FirstPage, PreferredNode);
+		if (StartPageNumber >= 0) {
+			HugeAllocations++;
+			HugeSlackPages += HugeCount - PageCount;
+			HugeSlackPeak = max(HugeSlackPeak.load(), HugeSlackPages.load());
+			RecordRun(StartPageNumber, PageRun{ HugeCount, Owner, true, PageCount });
+			return StartPageNumber * PAGE_SIZE;
+		}
+		HugeFallbacks++;
+	}
 
-// 比较函数用于优先队列
-bool Task::operator<(const Task& other) const {
-	return RemainingTime > other.RemainingTime; // 小顶堆
+	StartPageNumber = ClaimRun(PageCount, PageAlign, FirstPage, PreferredNode);
+	if (StartPageNumber < 0 && !Huge && SplitHugePages(PageCount, PageAlign) > 0) {
+		StartPageNumber = ClaimRun(PageCount, PageAlign, FirstPage, PreferredNode);
+	}
+	if (StartPageNumber < 0) {
+		return 0;
+	}
+	RecordRun(StartPageNumber, PageRun{ PageCount, Owner, false, PageCount });
+
+	return StartPageNumber == 0 ? InitStart : StartPageNumber * PAGE_SIZE;
 }
 
-// CPU 的初始化函数
-bool CPU::Init() {
+// 按当前模式占用一段页面，返回起始页号，失败返回 -1
+// 先在优先节点内找，再依次（回绕）尝试其他节点，页段不跨节点；不限节点时在整个位图中搜索
+// Tlsf 从节点的 TLSF 索引取；GlobalLock 搜索后标记；Concurrent 乐观搜索后 CAS 占用，被抢先则重新搜索
+long long Memory::ClaimRun(long long Count, long long Align, long long FirstPage, int PreferredNode) {
+
+	bool AnyNode = PreferredNode < 0 && Mode != MemoryMode::Tlsf;
+	int Tries = AnyNode ? 1 : NodeCount;
+	for (int i = 0; i < Tries; i++) {
+		int Node = (max(PreferredNode, 0) + i) % NodeCount;
+		if (Mode == MemoryMode::Tlsf) {
+			long long StartPageNumber = Tlsf[Node].Allocate(Count, Align);
+			if (StartPageNumber >= 0) {
+				Pages.SetRange(StartPageNumber, Count); // 位图照常记录，占用统计要用
+				return StartPageNumber;
+			}
+			continue;
+		}
 
-	string Console;
-	// 进入
-	Console = "CPU " + to_string(CPUNumber) + " 初始化开始。";
-	os.Print(Console);
+		long long From = AnyNode ? FirstPage : max(FirstPage, NodeFirstPage(Node));
+		long long Limit = AnyNode ? Pages.PageCount() : NodeFirstPage(Node + 1);
+		while (1) {
+			// 搜索可用内存
+			long long StartPageNumber = Pages.FindFreeRun(Count, Align, From, Limit);
+			if (StartPageNumber < 0) {
+				break; // 换下一个节点
+			}
 
-	// 初始化任务池
-	for (int i = 0; i < TASK_OF_EACH_CPU; i++) {
-		string TaskInfo = "[CPU " + to_string(CPUNumber) + " 的任务 " + to_string(i) + " ]";
-		Task task(TaskInfo);
-		TaskPool.push_back(task);
+			if (Mode == MemoryMode::GlobalLock) {
+				Pages.SetRange(StartPageNumber, Count);
+				return StartPageNumber;
+			}
+			if (Pages.TryClaimRange(StartPageNumber, Count)) {
+				return StartPageNumber;
+			}
+			// 被其他 CPU 抢先，重新搜索
+		}
 	}
-
-	// 结束
-	Console = "CPU " + to_string(CPUNumber) + " 初始化完成。";
-	os.Print(Console);
-
-	return 1;
+	return -1;
 }
 
-// OS 的初始化函数
-bool OS::Init() {
+// 在占用者索引中记录页段
+void Memory::RecordRun(long long StartPageNumber, const PageRun& Run) {
 
-	// 输出用
-	string Console;
+	OwnerShard& Shard = ShardOf(StartPageNumber);
+	lock_guard<mutex> ShardLock(Shard.Lock);
+	Shard.Runs[StartPageNumber] = Run;
+}
 
-	Console = "OS初始化开始。";
-	Print(Console);
+// 按需拆分大页：尾部有多余页面的大页降级为普通页段并归还多余页面，归还的尾部放得下 PageCount 页
+// （按 PageAlign 对齐）时立即停止；没有多余页面的大页保持不变。返回归还的页数
+long long Memory::SplitHugePages(long long PageCount, long long PageAlign) {
 
-	// 初始化内存
-	MEMORY.Init();
+	if (HugeSlackPages.load() == 0) {
+		return 0;
+	}
 
-	// 随机一个CPU数目
-	int NumberOfCPU = 0;
-	NumberOfCPU = GetRandomIntThreadSafe() % CPU_MAX_NUMBER + 1; // 保证结果为1~8
+	long long Returned = 0;
+	for (auto& Shard : Owners) {
+		lock_guard<mutex> ShardLock(Shard.Lock);
+		for (auto& Entry : Shard.Runs) {
+			PageRun& Run = Entry.second;
+			if (!Run.Huge || Run.NeededPages == Run.PageCount) {
+				continue;
+			}
 
-	Console = "随机的CPU数目为：" + to_string(NumberOfCPU);
-	Print(Console);
+			// 先缩短记录再清位图
+			long long TailStart = Entry.first + Run.NeededPages;
+			long long TailCount = Run.PageCount - Run.NeededPages;
+			Run.Huge = false;
+			Run.PageCount = Run.NeededPages;
+			Pages.ClearRange(TailStart, TailCount);
+			if (Mode == MemoryMode::Tlsf) {
+				Tlsf[NodeOf(TailStart)].Release(TailStart, TailCount);
+			}
+			HugeSlackPages -= TailCount;
+			Returned += TailCount;
+			HugeSplits++;
 
-	// 初始化CPU
-	for (int i = 0; i < NumberOfCPU; i++) {
-		CPU cpu;
-		cpu.CPUNumber = i;
-		cpu.Init();
-		CPUS.push_back(cpu);
+			long long AlignedStart = (TailStart + PageAlign - 1) / PageAlign * PageAlign;
+			if (AlignedStart + PageCount <= TailStart + TailCount) {
+				return Returned;
+			}
+		}
 	}
+	return Returned;
+}
 
-	Console = "OS初始化完成。";
-	Print(Console);
+// 该分配当前是否以大页映射
+bool Memory::IsHuge(long long Start) {
 
-	return 1;
+	long long StartPageNumber = Start / PAGE_SIZE;
+	OwnerShard& Shard = ShardOf(StartPageNumber);
+	lock_guard<mutex> ShardLock(Shard.Lock);
+	auto Found = Shard.Runs.find(StartPageNumber);
+	return Found != Shard.Runs.end() && Found->second.Huge;
 }
 
-// 启动函数
-void OS::Run() {
-
-	// 开启 CPU 工作流
-	vector<thread>CpuThreads;
-	for (auto& cpu : CPUS) {
-		CpuThreads.push_back(std::thread(
-			[&cpu]() { cpu.CPUWork(); } // thread 传入的函数必须显式指定对象实例
-		));
+// 只清除该内存块自身覆盖的页面，GlobalLock 和 Tlsf 模式下调用者需持有 MemoryLock
+void Memory::ReleaseLocked(long long Start, long long Size) {
+
+	long long StartPageNumber = Start / PAGE_SIZE;
+	long long EndPageNumber = (Start + Size - 1) / PAGE_SIZE;
+	long long Count = EndPageNumber - StartPageNumber + 1;
+
+	// 先删占用者记录再清位图，页面重新可分配时旧记录已不存在；大页的页段比请求长，按记录的页数释放
+	OwnerShard& Shard = ShardOf(StartPageNumber);
+	{
+		lock_guard<mutex> ShardLock(Shard.Lock);
+		auto Found = Shard.Runs.find(StartPageNumber);
+		if (Found != Shard.Runs.end()) {
+			if (Found->second.Huge) {
+				Count = Found->second.PageCount;
+				HugeSlackPages -= Found->second.PageCount - Found->second.NeededPages;
+			}
+			Shard.Runs.erase(Found);
+		}
 	}
-
-	// 等待工作
-	for (auto& i : CpuThreads) {
-		i.join();
+	Pages.ClearRange(StartPageNumber, Count);
+	if (Mode == MemoryMode::Tlsf) {
+		Tlsf[NodeOf(StartPageNumber)].Release(StartPageNumber, Count);
 	}
+}
 
+// 释放从 Start 开始、大小为 Size 的内存所覆盖的页面
+void Memory::Release(long long Start, long long Size) {
+
+	unique_lock<mutex> lock(MemoryLock, defer_lock);
+	if (Mode != MemoryMode::Concurrent) {
+		lock.lock();
+	}
+	ReleaseLocked(Start, Size);
 }
 
-// 中断函数
-void OS::Trap(CPU& cpu) {
+// 批量释放多个 (起始地址, 大小) 内存块，整批只加一次锁
+void Memory::Release(const vector<pair<long long, long long>>& Blocks) {
 
-	string msg = "中断：CPU " + to_string(cpu.CPUNumber) + "，任务 " + cpu.TaskPool[cpu.TaskNumber].TaskId + " （剩余：" + to_string(cpu.TaskPool[cpu.TaskNumber].RemainingTime) + " s）。";
-	Print(msg);
+	if (Blocks.empty()) {
+		return;
+	}
 
+	unique_lock<mutex> lock(MemoryLock, defer_lock);
+	if (Mode != MemoryMode::Concurrent) {
+		lock.lock();
+	}
+	for (auto& Block : Blocks) {
+		ReleaseLocked(Block.first, Block.second);
+	}
 }
 
-// 申请内存，输入为CPU，成功返回 1。
-bool OS::New(CPU& cpu) {
-
-	// 因为有多个 return 路径，手动unlock会很麻烦，使用自动unlock
-	lock_guard<mutex> lock(MEMORY.MemoryLock);
+// 内存整理（GlobalLock 模式，调用者持有 MemoryLock）
+// 枚举按 Size 对齐的窗口，选需要搬移页面最少的一个，把窗口里的页段搬到窗口外再返回 1；
+// 窗口里有不在 Movable 中的页段（slab、正在执行的任务）或 0 号页就跳过，一次最多搬 COMPACT_MAX_PAGES 页。
+// 每次最多看 COMPACT_MAX_WINDOWS 个窗口，下次从 CompactCursor 接着看；窗口里的页段直接从占用者索引查，不收集全部页段
+bool Memory::CompactLocked(long long Size, const unordered_set<Task*>& Movable, long long& MovedPages) {
 
-	// 超过16MB不行
-	long long Size = cpu.TaskPool[cpu.TaskNumber].Size;
 	if (Size > ((long long)16 * 1024 * 1024)) {
 		return 0;
 	}
 
-	// 对于大小为 s 的内存分配请求，返回的内存地址必须对齐到2^i，且 2^i >= s。
+	// 对齐要求同 AllocateLocked，窗口从 1 号页开始
 	long long InitStart = 1;
-	while (1) {
+	while (InitStart < Size) {
+		InitStart = InitStart * 2;
+	}
+	long long PageAlign = max(1LL, InitStart / PAGE_SIZE);
+	long long PageCount = (Size + PAGE_SIZE - 1) / PAGE_SIZE;
 
-		if (InitStart >= Size) {
-			break;
+	// 空闲页面总数都不够，怎么搬也没用
+	if (Pages.CountFree() < PageCount) {
+		return 0;
+	}
+
+	// 从上次停下的位置开始看窗口，到末尾回到开头
+	long long FirstWindow = PageAlign;
+	long long WindowCount = (Pages.PageCount() - PageCount) / PageAlign;
+	if (WindowCount <= 0) {
+		return 0;
+	}
+	long long Window = (CompactCursor + PageAlign - 1) / PageAlign * PageAlign;
+	long long BestWindow = -1;
+	long long BestCost = COMPACT_MAX_PAGES + 1;
+	vector<pair<long long, PageRun>> Runs; // 当前窗口里的页段
+	for (long long Checked = 0; Checked < min(WindowCount, (long long)COMPACT_MAX_WINDOWS) && BestCost > 0; Checked++) {
+		if (Window < FirstWindow || Window + PageCount > Pages.PageCount()) {
+			Window = FirstWindow;
 		}
-		else {
-			// 由于之前的16MB限制，无需担心超过 long long 的范围
-			InitStart = InitStart * 2;
+		Runs.clear();
+		CollectRuns(Window, Window + PageCount, Runs);
+		long long Cost = 0;
+		long long Blocked = -1; // 不能搬的页段的末页号（不含）
+		for (auto& Run : Runs) {
+			if (Run.first == 0 || Movable.count(Run.second.OccupiedTask) == 0) {
+				Cost = -1;
+				Blocked = Run.first + Run.second.PageCount;
+				break;
+			}
+			Cost += Run.second.PageCount;
+			if (Cost >= BestCost) {
+				break;
+			}
 		}
+		if (Cost >= 0 && Cost < BestCost) {
+			BestWindow = Window;
+			BestCost = Cost;
+		}
+		// 含有不能搬的页段的窗口都跳过
+		Window += PageAlign;
+		if (Blocked > Window) {
+			Window = (Blocked + PageAlign - 1) / PageAlign * PageAlign;
+		}
+	}
+	CompactCursor = Window;
+	if (BestWindow < 0) {
+		return 0;
 	}
 
-	// 搜索可用内存
-	for (long long Start = InitStart; Start <= (long long)PAGE_SIZE * (long long)MEMORY.Pages.size() - Size; Start = Start + InitStart) {
+	// 逐个搬走：先占新页段、改占用者记录，再清旧页段
+	long long WindowEnd = BestWindow + PageCount;
+	Runs.clear();
+	CollectRuns(BestWindow, WindowEnd, Runs);
+	for (size_t i = 0; i < Runs.size(); i++) {
+		long long OldPage = Runs[i].first;
+		long long RunPages = Runs[i].second.PageCount;
+		Task* Owner = Runs[i].second.OccupiedTask;
+
+		// 搬过去的位置仍要满足任务自己的对齐，大页还要按 2MB 对齐
+		long long OwnerAlign = 1;
+		while (OwnerAlign < Owner->Size) {
+			OwnerAlign = OwnerAlign * 2;
+		}
+		OwnerAlign = max(1LL, OwnerAlign / PAGE_SIZE);
+		if (Runs[i].second.Huge) {
+			OwnerAlign = max(OwnerAlign, (long long)HUGE_PAGE_PAGES);
+		}
+		// 先在原节点内找窗口外的位置，再在整个内存中找
+		int OldNode = NodeOf(OldPage);
+		long long NodeStart = max(1LL, NodeFirstPage(OldNode));
+		long long NodeEnd = NodeFirstPage(OldNode + 1);
+		long long NewPage = Pages.FindFreeRun(RunPages, OwnerAlign, NodeStart, min(NodeEnd, BestWindow));
+		if (NewPage < 0) {
+			NewPage = Pages.FindFreeRun(RunPages, OwnerAlign, max(NodeStart, WindowEnd), NodeEnd);
+		}
+		if (NewPage < 0) {
+			NewPage = Pages.FindFreeRun(RunPages, OwnerAlign, 1, BestWindow);
+		}
+		if (NewPage < 0) {
+			NewPage = Pages.FindFreeRun(RunPages, OwnerAlign, WindowEnd, Pages.PageCount());
+		}
+		if (NewPage < 0) {
+			return 0; // 放不下，已经搬过的留在新位置
+		}
 
-		// 找到可用内存
-		if (MEMORY.CheckMemory(Start, Size)) {
+		Pages.SetRange(NewPage, RunPages);
+		{
+			OwnerShard& OldShard = ShardOf(OldPage);
+			lock_guard<mutex> ShardLock(OldShard.Lock);
+			OldShard.Runs.erase(OldPage);
+		}
+		{
+			OwnerShard& NewShard = ShardOf(NewPage);
+			lock_guard<mutex> ShardLock(NewShard.Lock);
+			NewShard.Runs[NewPage] = Runs[i].second;
+		}
+		Pages.ClearRange(OldPage, RunPages);
+		if (Runs[i].second.Huge) {
+			os.ShootdownTlb(TLB_HUGE_TAG | (uint64_t)(OldPage / HUGE_PAGE_PAGES), RunPages / HUGE_PAGE_PAGES);
+		}
+		else {
+			os.ShootdownTlb(OldPage, RunPages); // 旧物理页的 TLB 项失效
+		}
+		Owner->Start = NewPage * PAGE_SIZE; // 上下文保存点跟着页段走
+		Owner->Node = NodeOf(NewPage); // 可能换了节点
+		MovedPages += RunPages;
+	}
 
-			long long StartPageNumber = Start / PAGE_SIZE; // 起始页面编号
-			long long EndPageNumber = (Start + Size - 1) / PAGE_SIZE; // 结束页面编号，此处减一原因同L1
+	return 1;
+}
 
-			for (long long i = StartPageNumber; i <= EndPageNumber; i++) {
-				MEMORY.Pages[i].OccupiedTask = &cpu.TaskPool[cpu.TaskNumber];
+// 收集与 [From, To) 重叠的页段，按首页号有序（调用者持有 MemoryLock）。
+// 页段不超过 OWNER_REGION_PAGES 页，只需在首页号落在 [From - OWNER_REGION_PAGES, To) 的几个区域里二分查找
+void Memory::CollectRuns(long long From, long long To, vector<pair<long long, PageRun>>& Runs) {
+	long long Low = max(0LL, From - OWNER_REGION_PAGES);
+	for (long long Region = Low / OWNER_REGION_PAGES; Region * OWNER_REGION_PAGES < To; Region++) {
+		long long RegionStart = max(Low, Region * OWNER_REGION_PAGES);
+		long long RegionEnd = min(To, (Region + 1) * OWNER_REGION_PAGES);
+		OwnerShard& Shard = ShardOf(Region * OWNER_REGION_PAGES);
+		lock_guard<mutex> ShardLock(Shard.Lock);
+		for (auto Entry = Shard.Runs.lower_bound(RegionStart); Entry != Shard.Runs.end() && Entry->first < RegionEnd; ++Entry) {
+			if (Entry->first + Entry->second.PageCount > From) {
+				Runs.push_back(*Entry);
 			}
+		}
+	}
+}
 
-			cpu.TaskPool[cpu.TaskNumber].Start = Start;
+// 占位任务，标记被请求调页用作页框的页面
+Task FramePageOwner(-1, 1); // CPU 编号 -1，不属于任何 CPU
 
-			return 1;
+// 创建交换文件和置换策略，Frames 为物理页框数，失败返回 0
+bool Pager::Init(long long Frames) {
+
+	SwapFile = open(SwapPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (SwapFile < 0) {
+		return 0;
+	}
+	FrameCount = Frames;
+	Policy = MakeReplacementPolicy(Kind, FrameCount);
+	Buffer.assign(PAGE_SIZE, 0);
+	return 1;
+}
+
+// 关闭并删除交换文件
+void Pager::Close() {
+
+	if (SwapFile >= 0) {
+		close(SwapFile);
+		unlink(SwapPath.c_str());
+		SwapFile = -1;
+	}
+}
+
+// 页面的键：高 32 位为地址空间编号（从 1 开始，所以键不为 0），低 32 位为虚拟页号
+uint64_t Pager::KeyOf(uint32_t SpaceId, long long Page) {
+	return ((uint64_t)SpaceId << 32) | (uint64_t)Page;
+}
+
+// 为任务建立虚拟地址空间，此时不分配任何页框，所以不会因为内存不足而失败
+void Pager::CreateSpace(Task& task) {
+
+	lock_guard<mutex> Guard(Lock);
+	task.SpaceId = ++LastSpaceId;
+	task.PageTable.assign((task.Size + PAGE_SIZE - 1) / PAGE_SIZE, PageTableEntry());
+	Spaces[task.SpaceId] = &task;
+}
+
+// 销毁任务的地址空间，页框还给 Memory，交换槽留给以后复用
+void Pager::DestroySpace(Task& task) {
+
+	lock_guard<mutex> Guard(Lock);
+	for (long long Page = 0; Page < (long long)task.PageTable.size(); Page++) {
+		PageTableEntry& Entry = task.PageTable[Page];
+		Policy->Forget(KeyOf(task.SpaceId, Page));
+		if (Entry.Frame >= 0) {
+			os.MEMORY.Release(Entry.Frame * PAGE_SIZE, PAGE_SIZE);
+		}
+		if (Entry.SwapSlot >= 0) {
+			FreeSwapSlots.push_back(Entry.SwapSlot);
+		}
+	}
+	Spaces.erase(task.SpaceId);
+	task.PageTable.clear();
+	task.SpaceId = 0;
+}
+
+// 任务执行一个时钟周期：大部分访问落在一个随执行进度滑动的热点区域（约 1/8 的页面），
+// 其余均匀分布在整个地址空间，然后统计最近 WORKING_SET_WINDOW 个周期内访问过的页面数
+void Pager::Touch(Task& task) {
+
+	lock_guard<mutex> Guard(Lock);
+	long long PageCount = (long long)task.PageTable.size();
+	int Executed = task.TotalTime - task.RemainingTime;
+	long long Hot = max(1LL, PageCount / 8);
+	long long HotStart = (Executed * max(1LL, Hot / 2)) % PageCount;
+	long long Touches = min(PageCount, (long long)PAGING_TOUCHES_PER_TICK);
+
+	for (long long i = 0; i < Touches; i++) {
+		long long Page = 0;
+		if (GetRandomIntThreadSafe() % 100 < PAGING_HOT_PERCENT) {
+			Page = (HotStart + GetRandomIntThreadSafe() % Hot) % PageCount;
+		}
+		else {
+			Page = GetRandomIntThreadSafe() % PageCount;
+		}
+
+		PageTableEntry& Entry = task.PageTable[Page];
+		References++;
+		if (Entry.Frame >= 0) {
+			Policy->Access(KeyOf(task.SpaceId, Page));
+		}
+		else if (!Fault(task, Page)) {
+			continue; // 没有页框可用，这次访问作废
+		}
+		Entry.LastTouch = Executed;
+		if (GetRandomIntThreadSafe() % 100 < PAGING_WRITE_PERCENT) {
+			Entry.Dirty = true;
 		}
 	}
 
-	return 0;
+	long long WorkingSet = 0;
+	for (auto& Entry : task.PageTable) {
+		if (Entry.LastTouch >= 0 && Entry.LastTouch > Executed - WORKING_SET_WINDOW) {
+			WorkingSet++;
+		}
+	}
+	WorkingSetSamples++;
+	WorkingSetTotal += WorkingSet;
+	WorkingSetPeak = max(WorkingSetPeak, WorkingSet);
+}
+
+// 访存模型的一次访问，与 Touch 一样计入引用、告诉置换策略并记录工作集，不在内存中的页面缺页装入
+long long Pager::Reference(Task& task, long long Page) {
+
+	PageTableEntry& Entry = task.PageTable[Page];
+	References++;
+	if (Entry.Frame >= 0) {
+		Policy->Access(KeyOf(task.SpaceId, Page));
+	}
+	else if (!Fault(task, Page)) {
+		return -1;
+	}
+	Entry.LastTouch = task.TotalTime - task.RemainingTime;
+	return Entry.Frame;
 }
 
-// 释放内存，输入为CPU，成功返回 1。
-bool OS::Free(CPU& cpu) {
+// 缺页处理：先向 Memory 申请一个页框，没有时让置换策略淘汰一个页面并接手它的页框；
+// 页面以前被换出过就从交换文件读回，并核对写出时留下的键
+bool Pager::Fault(Task& task, long long Page) {
 
-	lock_guard<mutex> lock(MEMORY.MemoryLock);
+	Faults++;
+	uint64_t Key = KeyOf(task.SpaceId, Page);
+	PageTableEntry& Entry = task.PageTable[Page];
 
-	// 从页表中移除
-	for (auto& p : MEMORY.Pages) {
-		if (p.OccupiedTask == &cpu.TaskPool[cpu.TaskNumber]) {
-			p.OccupiedTask = nullptr;
+	long long Frame = -1;
+	long long Address = os.MEMORY.Allocate(PAGE_SIZE, &FramePageOwner, task.Node);
+	if (Address != 0) {
+		Frame = Address / PAGE_SIZE;
+	}
+	else {
+		uint64_t VictimKey = Policy->Evict(Key);
+		if (VictimKey == 0) {
+			return 0;
 		}
+		PageTableEntry& Victim = Spaces[(uint32_t)(VictimKey >> 32)]->PageTable[VictimKey & 0xFFFFFFFF];
+		Evictions++;
+		if (Victim.Dirty) {
+			SwapOut(VictimKey, Victim);
+		}
+		Frame = Victim.Frame;
+		Victim.Frame = -1;
+		os.ShootdownTlb(VictimKey, 1); // 其他 CPU 上缓存的翻译已失效
 	}
 
-	cpu.TaskPool[cpu.TaskNumber].Start = 0;
+	if (Entry.SwapSlot >= 0) {
+		ssize_t Read = pread(SwapFile, Buffer.data(), PAGE_SIZE, Entry.SwapSlot * PAGE_SIZE);
+		SwapIns++;
+		uint64_t Stored = 0;
+		memcpy(&Stored, Buffer.data(), sizeof(Stored));
+		if (Read != PAGE_SIZE || Stored != Key) {
+			string Console = "交换文件读回的页面不一致：任务 " + task.Name() + " 页 " + to_string(Page);
+			os.Print(LogLevel::Warn, Console);
+		}
+	}
 
+	Entry.Frame = Frame;
+	Entry.Dirty = false; // 交换文件中的副本与内存一致，或页面从未写过（全零）
+	Policy->Admit(Key);
 	return 1;
 }
 
-// CPU函数，申请内存并工作
-void CPU::CPUWork() {
-	string Console;
-	// 进入
-	Console = "CPU " + to_string(CPUNumber) + " 开始工作。";
-	os.Print(Console);
+// 把写过的页面写入交换文件，已有槽的复用原来的槽；页面内容用它的键填充，读回时核对
+void Pager::SwapOut(uint64_t Key, PageTableEntry& Entry) {
 
-	// 工作
-	while (!TaskPool.empty()) {
-		// 选择剩余时间最短的任务
-		auto ShortestTask = min_element(TaskPool.begin(), TaskPool.end(),
-			[](const Task& a, const Task& b) {
-				return a.RemainingTime < b.RemainingTime;
-			});
-
-		TaskNumber = (int)distance(TaskPool.begin(), ShortestTask);
-
-		Console = "CPU " + to_string(CPUNumber) +
-			" 选择任务：" + TaskPool[TaskNumber].TaskId +
-			" （剩余时间：" + to_string(TaskPool[TaskNumber].RemainingTime) + " s）";
-		os.Print(Console);
-
-		// 申请内存（如果尚未分配）
-		if (TaskPool[TaskNumber].Start == 0) {
-			if (!os.New(*this)) {
-				Console = "CPU " + to_string(CPUNumber) +
-					" 内存分配失败，跳过任务：" + TaskPool[TaskNumber].TaskId;
-				os.Print(Console);
-				TaskPool.erase(TaskPool.begin() + TaskNumber);
-				continue;
-			}
-			Console = "CPU " + to_string(CPUNumber) +
-				" 分配内存起始地址：" + to_string(TaskPool[TaskNumber].Start) +
-				" (大小:" + to_string(TaskPool[TaskNumber].Size) + " B)";
-			os.Print(Console);
+	if (Entry.SwapSlot < 0) {
+		if (!FreeSwapSlots.empty()) {
+			Entry.SwapSlot = FreeSwapSlots.back();
+			FreeSwapSlots.pop_back();
+		}
+		else {
+			Entry.SwapSlot = SwapSlots++;
 		}
+	}
+	memcpy(Buffer.data(), &Key, sizeof(Key));
+	if (pwrite(SwapFile, Buffer.data(), PAGE_SIZE, Entry.SwapSlot * PAGE_SIZE) != PAGE_SIZE) {
+		string Console = "写交换文件失败：" + SwapPath;
+		os.Print(LogLevel::Warn, Console);
+	}
+	SwapOuts++;
+	Entry.Dirty = false;
+}
 
-		// 执行任务（每秒检查中断）
-		while (TaskPool[TaskNumber].RemainingTime > 0) {
-			this_thread::sleep_for(chrono::seconds(1));
-			TaskPool[TaskNumber].RemainingTime--;
+// 占位任务，标记被 slab 占用的页面
+Task SlabPageOwner(-1, 0);
 
-			// 30%概率触发中断
-			if (GetRandomIntThreadSafe() % 10 < 3) {
-				os.Trap(*this);
+// 大小类下标：满足 (SLAB_MIN_OBJECT_SIZE << k) >= Size 的最小 k
+static int SlabSizeClass(long long Size) {
+	int SizeClass = 0;
+	while (((long long)SLAB_MIN_OBJECT_SIZE << SizeClass) < Size) {
+		SizeClass++;
+	}
+	return SizeClass;
+}
 
-				// 如果还有剩余时间，放回任务池
-				if (TaskPool[TaskNumber].RemainingTime > 0) {
-					Console = "CPU " + to_string(CPUNumber) +
-						" 中断保存: " + TaskPool[TaskNumber].TaskId +
-						" (剩余:" + to_string(TaskPool[TaskNumber].RemainingTime) + "s)";
-					os.Print(Console);
-				}
+// slab 是否已没有可分配的对象
+bool Slab::IsFull() const {
+	return FreeObjects.empty() && NextUnused >= Start + SLAB_SIZE;
+}
 
-				break; // 退出当前任务执行循环
-			}
-		}
+// 分配一个小对象，slab 按 SLAB_SIZE 对齐、对象大小为 2 的幂，地址天然满足对齐约定
+long long SlabCache::Allocate(long long Size) {
 
-		// 完成任务处理
-		if (TaskPool[TaskNumber].RemainingTime == 0) {
-			Console = "CPU " + to_string(CPUNumber) +
-				" 完成任务: " + TaskPool[TaskNumber].TaskId;
-			os.Print(Console);
-			os.Free(*this);
-			TaskPool.erase(TaskPool.begin() + TaskNumber);
+	int SizeClass = SlabSizeClass(Size);
+	vector<long long>& Partial = PartialSlabs[SizeClass];
+
+	// 从全局内存批量补充一个 slab
+	if (Partial.empty()) {
+		long long SlabStart = os.MEMORY.Allocate(SLAB_SIZE, &SlabPageOwner, HomeNode);
+		if (SlabStart == 0) {
+			return 0;
 		}
+		Slab& NewSlab = Slabs[SlabStart];
+		NewSlab.Start = SlabStart;
+		NewSlab.ObjectSize = (long long)SLAB_MIN_OBJECT_SIZE << SizeClass;
+		NewSlab.NextUnused = SlabStart;
+		Partial.push_back(SlabStart);
 	}
 
-	// 退出
-	Console = "CPU " + to_string(CPUNumber) + " 工作结束。";
-	os.Print(Console);
+	// 优先复用已释放的对象
+	Slab& Current = Slabs[Partial.back()];
+	long long Start = 0;
+	if (!Current.FreeObjects.empty()) {
+		Start = Current.FreeObjects.back();
+		Current.FreeObjects.pop_back();
+	}
+	else {
+		Start = Current.NextUnused;
+		Current.NextUnused += Current.ObjectSize;
+	}
+	Current.LiveObjects++;
+
+	if (Current.IsFull()) {
+		Partial.pop_back();
+	}
+
+	return Start;
 }
 
-// 多线程安全的随机正int数生成器
-int GetRandomIntThreadSafe() {
-	thread_local mt19937 gen(random_device{}());
-	uniform_int_distribution<int> dist(0, 2147483647);
-	return dist(gen);
+// 地址是否属于本缓存的某个 slab
+bool SlabCache::Owns(long long Start) const {
+	return Slabs.count(Start & ~((long long)SLAB_SIZE - 1)) != 0;
 }
 
-// 输出函数
-void OS::Print(string& Text) {
-	Output.lock();
-	cout << Text << endl;
-	Output.unlock();
+// 释放一个对象，slab 全空且同类还有其他可用 slab 时归还全局内存
+void SlabCache::Free(long long Start) {
+
+	long long SlabStart = Start & ~((long long)SLAB_SIZE - 1);
+	Slab& Owner = Slabs[SlabStart];
+	vector<long long>& Partial = PartialSlabs[SlabSizeClass(Owner.ObjectSize)];
+
+	bool WasFull = Owner.IsFull();
+	Owner.FreeObjects.push_back(Start);
+	Owner.LiveObjects--;
+
+	if (WasFull) {
+		Partial.push_back(SlabStart);
+	}
+
+	if (Owner.LiveObjects == 0 && Partial.size() > 1) {
+		Partial.erase(find(Partial.begin(), Partial.end(), SlabStart));
+		Slabs.erase(SlabStart);
+		os.MEMORY.Release(SlabStart, SLAB_SIZE);
+	}
 }
 
-// 主函数
-int main() {
-	os.Init();
+// 把所有 slab 归还全局内存
+void SlabCache::Release() {
+	vector<pair<long long, long long>> Blocks;
+	for (auto& Entry : Slabs) {
+		Blocks.push_back({ Entry.first, SLAB_SIZE });
+	}
+	os.MEMORY.Release(Blocks);
+	Slabs.clear();
+	for (auto& Partial : PartialSlabs) {
+		Partial.clear();
+	}
+}
+
+// 构造函数
+Task::Task(int CPUNumber, int Index) {
+
+	Id = ((uint64_t)CPUNumber << 32) | (uint32_t)Index;
+
+	// 按比例随机决定内存大小
+	Size = RandomTaskSize();
+
+	// 随机时间，1-5秒
+	TotalTime = (GetRandomIntThreadSafe() % 5) + 1;
+	RemainingTime = TotalTime; // 初始化剩余时间
+
+	// 任务类型，没有 I/O 密集型任务时不取随机数
+	if (os.IoBoundPercent > 0 && GetRandomIntThreadSafe() % 100 < os.IoBoundPercent) {
+		Class = TaskClass::IoBound;
+	}
+}
+
+// 任务名称
+string Task::Name() const {
+	return NameOf(Id);
+}
+
+// 编号对应的任务名称，形如 "[CPU 0 的任务 3 ]"
+string Task::NameOf(uint64_t Id) {
+	return "[CPU " + to_string(Id >> 32) + " 的任务 " + to_string(Id & 0xFFFFFFFF) + " ]";
+}
+
+// 比较函数用于优先队列
+bool Task::operator<(const Task& other) const {
+	return RemainingTime > other.RemainingTime; // 小顶堆
+}
+
+// 就绪队列的堆比较：a 应排在 b 之后时返回 true，标准库大顶堆的堆顶就是最先执行的任务
+// SJF 按剩余时间，轮转按就绪序号，MLFQ 先比优先级，公平调度先比虚拟运行时间，相同时先进先出
+static bool TaskHeapLess(const Task* a, const Task* b) {
+	switch (os.Policy) {
+	case SchedulePolicy::RoundRobin:
+		return a->ReadySeq > b->ReadySeq;
+	case SchedulePolicy::Mlfq:
+		if (a->Level != b->Level) {
+			return a->Level > b->Level;
+		}
+		return a->ReadySeq > b->ReadySeq;
+	case SchedulePolicy::Fair:
+		if (a->VirtualRuntime != b->VirtualRuntime) {
+			return a->VirtualRuntime > b->VirtualRuntime;
+		}
+		return a->ReadySeq > b->ReadySeq;
+	default:
+		return *a < *b;
+	}
+}
+
+// 调度策略的名称
+static string PolicyName(SchedulePolicy Policy) {
+	switch (Policy) {
+	case SchedulePolicy::RoundRobin:
+		return "轮转（RR）";
+	case SchedulePolicy::Mlfq:
+		return "多级反馈队列（MLFQ）";
+	case SchedulePolicy::Fair:
+		return "公平调度（CFS）";
+	default:
+		return "最短作业优先（SJF）";
+	}
+}
+
+// 样本分布：平均、P50、P95、P99（最近秩）和最大值，会把 Samples 排序
+static string Distribution(vector<long long>& Samples) {
+
+	if (Samples.empty()) {
+		return "无样本";
+	}
+	sort(Samples.begin(), Samples.end());
+	long long Total = 0;
+	for (long long Sample : Samples) {
+		Total += Sample;
+	}
+	size_t Count = Samples.size();
+	auto Percentile = [&](int P) { return to_string(Samples[(Count * P + 99) / 100 - 1]); };
+	return "平均 " + to_string((double)Total / Count) + "，P50 " + Percentile(50) + "，P95 " + Percentile(95) +
+		"，P99 " + Percentile(99) + "，最大 " + to_string(Samples.back());
+}
+
+// 直方图的分布摘要，百分位取所在桶的下界（小于 64 时是精确值）
+static string Distribution(const LatencyHistogram& Histogram) {
+
+	if (Histogram.Total == 0) {
+		return "无样本";
+	}
+	return "平均 " + to_string((double)Histogram.Sum / Histogram.Total) + "，P50 " + to_string(Histogram.Percentile(0.50)) +
+		"，P95 " + to_string(Histogram.Percentile(0.95)) + "，P99 " + to_string(Histogram.Percentile(0.99)) +
+		"，最大 " + to_string(Histogram.Max);
+}
+
+// 解析逗号分隔的正整数时间片（如 "1,2,4"），级数超过 MLFQ_MAX_LEVELS 或格式错误返回 0
+static bool ParseQuanta(const string& Text, vector<int>& Quanta) {
+
+	Quanta.clear();
+	size_t Begin = 0;
+	while (Begin <= Text.size()) {
+		size_t End = Text.find(',', Begin);
+		if (End == string::npos) {
+			End = Text.size();
+		}
+		int Quantum = atoi(Text.substr(Begin, End - Begin).c_str());
+		if (Quantum <= 0) {
+			return 0;
+		}
+		Quanta.push_back(Quantum);
+		Begin = End + 1;
+	}
+	return Quanta.size() <= MLFQ_MAX_LEVELS;
+}
+
+// CPU 的初始化函数
+bool CPU::Init() {
+
+	string Console;
+	// 进入
+	Console = "CPU " + to_string(CPUNumber) + " 初始化开始。";
+	os.Print(Console);
+
+	// 初始化任务池，一次性分配，之后任务地址不再变化
+	TaskPool.reserve(os.TasksPerCPU);
+	for (int i = 0; i < os.TasksPerCPU; i++) {
+		TaskPool.emplace_back(CPUNumber, i);
+	}
+
+	// 所有任务进入就绪队列；队列预留好空间，调度循环中不再分配内存
+	ReadyQueue.clear();
+	ReadyQueue.reserve(TaskPool.size());
+	Blocked.reserve(TaskPool.size());
+	Retired.reserve(FREE_BATCH_TASKS);
+	ReleaseBuffer.reserve(FREE_BATCH_TASKS);
+	for (auto& task : TaskPool) {
+		task.ReadySeq = NextReadySeq++;
+		ReadyQueue.push_back(&task);
+	}
+	make_heap(ReadyQueue.begin(), ReadyQueue.end(), TaskHeapLess);
+
+	// 结束
+	Console = "CPU " + to_string(CPUNumber) + " 初始化完成。";
+	os.Print(Console);
+
+	return 1;
+}
+
+// 格式化结构化日志事件（在日志后台线程或 Sync 模式下调用），文本与逐条拼接时相同
+static void FormatLogEvent(const LogEvent& Event, string& Out) {
+	if (Event.Time >= 0) {
+		Out += "[T=";
+		Out += to_string(Event.Time);
+		Out += "] ";
+	}
+	LogEventKind Kind = (LogEventKind)Event.Kind;
+	Out += Kind == LogEventKind::Trap ? "中断：CPU " : "CPU ";
+	Out += to_string(Event.Source);
+	switch (Kind) {
+	case LogEventKind::Steal:
+		Out += " 窃取任务：";
+		Out += Task::NameOf(Event.Subject);
+		break;
+	case LogEventKind::Select:
+		Out += " 选择任务：";
+		Out += Task::NameOf(Event.Subject);
+		Out += " （剩余时间：";
+		Out += to_string(Event.Values[0]);
+		Out += " s）";
+		break;
+	case LogEventKind::AllocationFailed:
+		Out += " 内存分配失败，跳过任务：";
+		Out += Task::NameOf(Event.Subject);
+		break;
+	case LogEventKind::Allocated:
+		Out += " 分配内存起始地址：";
+		Out += to_string(Event.Values[0]);
+		Out += " (大小:";
+		Out += to_string(Event.Values[1]);
+		Out += " B)";
+		break;
+	case LogEventKind::Preempted:
+		Out += " 中断保存: ";
+		Out += Task::NameOf(Event.Subject);
+		Out += " (剩余:";
+		Out += to_string(Event.Values[0]);
+		Out += "s)";
+		break;
+	case LogEventKind::Completed:
+		Out += " 完成任务: ";
+		Out += Task::NameOf(Event.Subject);
+		break;
+	case LogEventKind::Trap:
+		Out += "，任务 ";
+		Out += Task::NameOf(Event.Subject);
+		Out += " （剩余：";
+		Out += to_string(Event.Values[0]);
+		Out += " s）。";
+		break;
+	}
+}
+
+// 解析命令行参数，参数非法时输出用法并返回 0
+bool OS::Configure(int argc, char* argv[]) {
+
+	vector<int> Quanta; // --mlfq-quanta 的解析结果
+	for (int i = 1; i < argc; i++) {
+		string Argument = argv[i];
+		if (Argument == "--slab=on") {
+			SlabEnabled = true;
+		}
+		else if (Argument == "--slab=off") {
+			SlabEnabled = false;
+		}
+		else if (Argument == "--memory=global") {
+			MEMORY.Mode = MemoryMode::GlobalLock;
+		}
+		else if (Argument == "--memory=concurrent") {
+			MEMORY.Mode = MemoryMode::Concurrent;
+		}
+		else if (Argument == "--memory=tlsf") {
+			MEMORY.Mode = MemoryMode::Tlsf;
+		}
+		else if (Argument == "--schedule=static") {
+			Schedule = ScheduleMode::Static;
+		}
+		else if (Argument == "--schedule=steal") {
+			Schedule = ScheduleMode::WorkStealing;
+		}
+		else if (Argument == "--log=sync") {
+			Log.Mode = LogMode::Sync;
+		}
+		else if (Argument == "--log=text") {
+			Log.Mode = LogMode::Text;
+		}
+		else if (Argument == "--log=binary") {
+			Log.Mode = LogMode::Binary;
+		}
+		else if (Argument == "--log-level=debug") {
+			Log.Level = LogLevel::Debug;
+		}
+		else if (Argument == "--log-level=info") {
+			Log.Level = LogLevel::Info;
+		}
+		else if (Argument == "--log-level=warn") {
+			Log.Level = LogLevel::Warn;
+		}
+		else if (Argument == "--log-level=off") {
+			Log.Level = LogLevel::Off;
+		}
+		else if (Argument == "--bench-memory") {
+			BenchMemory = true;
+		}
+		else if (Argument == "--virtual") {
+			VirtualTime = true;
+		}
+		else if (Argument.rfind("--tasks=", 0) == 0 && atoi(Argument.c_str() + 8) > 0) {
+			TasksPerCPU = atoi(Argument.c_str() + 8);
+		}
+		else if (Argument.rfind("--numa=", 0) == 0 && atoi(Argument.c_str() + 7) >= 1 && atoi(Argument.c_str() + 7) <= NUMA_MAX_NODES) {
+			MEMORY.NodeCount = atoi(Argument.c_str() + 7);
+		}
+		else if (Argument == "--numa-policy=local") {
+			Numa = NumaPolicy::Local;
+		}
+		else if (Argument == "--numa-policy=interleave") {
+			Numa = NumaPolicy::Interleave;
+		}
+		else if (Argument == "--pin=on") {
+			PinThreads = true;
+		}
+		else if (Argument == "--pin=off") {
+			PinThreads = false;
+		}
+		else if (Argument == "--scheduler=sjf") {
+			Policy = SchedulePolicy::Sjf;
+		}
+		else if (Argument == "--scheduler=rr") {
+			Policy = SchedulePolicy::RoundRobin;
+		}
+		else if (Argument == "--scheduler=mlfq") {
+			Policy = SchedulePolicy::Mlfq;
+		}
+		else if (Argument == "--scheduler=cfs") {
+			Policy = SchedulePolicy::Fair;
+		}
+		else if (Argument.rfind("--quantum=", 0) == 0 && atoi(Argument.c_str() + 10) > 0) {
+			Quantum = atoi(Argument.c_str() + 10);
+		}
+		else if (Argument.rfind("--mlfq-quanta=", 0) == 0 && ParseQuanta(Argument.substr(14), Quanta)) {
+			MlfqQuanta = Quanta;
+		}
+		else if (Argument.rfind("--mlfq-boost=", 0) == 0 && atoi(Argument.c_str() + 13) > 0) {
+			MlfqBoostPeriod = atoi(Argument.c_str() + 13);
+		}
+		else if (Argument.rfind("--io-percent=", 0) == 0 && Argument.size() > 13 && atoi(Argument.c_str() + 13) >= 0 && atoi(Argument.c_str() + 13) <= 100) {
+			IoBoundPercent = atoi(Argument.c_str() + 13);
+		}
+		else if (Argument == "--huge=on") {
+			MEMORY.HugePages = true;
+		}
+		else if (Argument == "--huge=off") {
+			MEMORY.HugePages = false;
+		}
+		else if (Argument == "--compact=on") {
+			CompactEnabled = true;
+		}
+		else if (Argument == "--compact=off") {
+			CompactEnabled = false;
+		}
+		else if (Argument.rfind("--pages=", 0) == 0 && atoll(Argument.c_str() + 8) > 1) {
+			MEMORY.InitPages = atoll(Argument.c_str() + 8);
+		}
+		else if (Argument == "--paging=off") {
+			PAGER.Enabled = false;
+		}
+		else if (Argument == "--paging=fifo" || Argument == "--paging=clock" || Argument == "--paging=lru" || Argument == "--paging=arc") {
+			PAGER.Enabled = true;
+			PAGER.Kind = Argument == "--paging=fifo" ? ReplacementKind::Fifo :
+				Argument == "--paging=clock" ? ReplacementKind::Clock :
+				Argument == "--paging=lru" ? ReplacementKind::Lru : ReplacementKind::Arc;
+		}
+		else if (Argument == "--cache=off") {
+			CacheModel = CacheModelMode::Off;
+		}
+		else if (Argument == "--cache=tlb") {
+			CacheModel = CacheModelMode::Tlb;
+		}
+		else if (Argument == "--cache=full") {
+			CacheModel = CacheModelMode::Full;
+		}
+		else if (Argument.rfind("--swap=", 0) == 0 && Argument.size() > 7) {
+			PAGER.SwapPath = Argument.substr(7);
+		}
+		else if (Argument.rfind("--record=", 0) == 0) {
+			if (!Recorder.Open(Argument.substr(9))) {
+				cout << "无法创建轨迹文件：" << Argument.substr(9) << endl;
+				return 0;
+			}
+		}
+		else if (!Bench.Parse(Argument)) {
+			cout << "使用方法: " << argv[0] << " [--slab=on|off] [--memory=global|concurrent|tlsf] [--bench-memory] [--virtual] [--tasks=N] [--schedule=static|steal] [--log=sync|text|binary] [--log-level=debug|info|warn|off] [--record=FILE] [--compact=on|off] [--pages=N] [--huge=on|off] [--numa=N] [--numa-policy=local|interleave] [--pin=on|off] [--scheduler=sjf|rr|mlfq|cfs] [--quantum=N] [--mlfq-quanta=N,N,...] [--mlfq-boost=N] [--io-percent=N] [--paging=off|fifo|clock|lru|arc] [--swap=FILE] [--cache=off|tlb|full]" << BenchOptions::Usage() << endl;
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+// OS 的初始化函数
+bool OS::Init() {
+
+	// 输出用
+	string Console;
+
+	Log.Formatter = FormatLogEvent; // 调度循环的结构化事件由后台线程格式化
+
+	Console = "OS初始化开始。";
+	Print(Console);
+
+	// 初始化内存
+	MEMORY.Init();
+
+	// 请求调页：除 0 号页外的所有页面都可以做页框
+	if (PAGER.Enabled) {
+		if (!PAGER.Init(MEMORY.Pages.PageCount() - 1)) {
+			Console = "无法创建交换文件：" + PAGER.SwapPath;
+			Print(LogLevel::Warn, Console);
+			return 0;
+		}
+		Console = "请求调页已启用，置换策略：" + PAGER.Policy->Name() + "，交换文件：" + PAGER.SwapPath;
+		Print(Console);
+	}
+
+	// 随机一个CPU数目
+	int NumberOfCPU = 0;
+	NumberOfCPU = GetRandomIntThreadSafe() % CPU_MAX_NUMBER + 1; // 保证结果为1~8
+
+	Console = "随机的CPU数目为：" + to_string(NumberOfCPU);
+	Print(Console);
+
+	// 初始化CPU，就地构造，避免拷贝使就绪队列中的任务指针失效
+	for (int i = 0; i < NumberOfCPU; i++) {
+		CPUS.emplace_back();
+		CPU& cpu = CPUS.back();
+		cpu.CPUNumber = i;
+		cpu.Init();
+		if (CacheModel != CacheModelMode::Off) {
+			cpu.Caches.Init(CacheModel == CacheModelMode::Full);
+		}
+	}
+
+	// 工作窃取时任务会迁移，队列按任务总数预留，调度循环中不再扩容
+	if (Schedule == ScheduleMode::WorkStealing) {
+		for (auto& cpu : CPUS) {
+			cpu.ReadyQueue.reserve((size_t)TasksPerCPU * NumberOfCPU);
+			cpu.Blocked.reserve((size_t)TasksPerCPU * NumberOfCPU);
+		}
+	}
+
+	// CPU 按编号平均分到各 NUMA 节点，slab 从所在节点补充
+	if (MEMORY.NodeCount > 1) {
+		for (auto& cpu : CPUS) {
+			cpu.HomeNode = cpu.CPUNumber * MEMORY.NodeCount / NumberOfCPU;
+			cpu.Slabs.HomeNode = cpu.HomeNode;
+			Console = "CPU " + to_string(cpu.CPUNumber) + " 属于 NUMA 节点 " + to_string(cpu.HomeNode);
+			Print(Console);
+		}
+	}
+
+	Console = "OS初始化完成。";
+	Print(Console);
+
+	return 1;
+}
+
+// 启动函数
+void OS::Run() {
+
+	StartTime = chrono::steady_clock::now();
+	if (VirtualTime) {
+		RunVirtual();
+		return;
+	}
+
+	// 开启 CPU 工作流
+	vector<thread>CpuThreads;
+	for (auto& cpu : CPUS) {
+		CpuThreads.push_back(std::thread(
+			[&cpu]() {
+				if (os.PinThreads) {
+					PinCurrentThread(cpu.CPUNumber);
+				}
+				cpu.CPUWork(); // thread 传入的函数必须显式指定对象实例
+			}
+		));
+	}
+
+	// 等待工作
+	for (auto& i : CpuThreads) {
+		i.join();
+	}
+
+	Report();
+
+}
+
+// 虚拟时间启动函数：离散事件模拟，每个事件让一个 CPU 执行一个时钟周期，不需要真实等待和 CPU 线程
+void OS::RunVirtual() {
+
+	priority_queue<Event> Events;
+
+	// 所有 CPU 在时刻 0 开始
+	for (auto& cpu : CPUS) {
+		cpu.BeginWork();
+		Events.push(Event{ 0, cpu.CPUNumber });
+	}
+
+	// 按时间顺序处理事件
+	while (!Events.empty()) {
+		Event Next = Events.top();
+		Events.pop();
+		VirtualNow = Next.Time;
+
+		CPU& cpu = CPUS[Next.CPUNumber];
+		if (cpu.Step()) {
+			// 远程访问的开销攒满一个时钟周期就顺延
+			long long Stall = cpu.StallPercent / 100;
+			cpu.StallPercent %= 100;
+			cpu.StallTicks += Stall;
+			Events.push(Event{ Next.Time + 1 + Stall, Next.CPUNumber });
+		}
+		else {
+			cpu.EndWork();
+		}
+	}
+
+	double Seconds = chrono::duration<double>(chrono::steady_clock::now() - StartTime).count();
+	string Console = "虚拟时间共 " + to_string(VirtualNow) + " 个时钟周期，实际耗时 " + to_string(Seconds) + " 秒。";
+	Print(LogLevel::Report, Console);
+
+	Report();
+
+}
+
+// 当前时间：虚拟时间模式下为虚拟时钟，否则为启动以来的秒数
+long long OS::Now() {
+	if (VirtualTime) {
+		return VirtualNow;
+	}
+	return chrono::duration_cast<chrono::seconds>(chrono::steady_clock::now() - StartTime).count();
+}
+
+// 为空闲的 CPU 窃取任务：按就绪任务数从多到少尝试其他 CPU，直到窃取到一个尚未开始的任务
+Task* OS::Steal(CPU& thief) {
+
+	bitset<CPU_MAX_NUMBER> Tried; // 在栈上，不分配内存
+	Tried[thief.CPUNumber] = true;
+
+	while (true) {
+		// 就绪任务最多的其他 CPU
+		CPU* Victim = nullptr;
+		size_t Most = 0;
+		for (auto& cpu : CPUS) {
+			if (Tried[cpu.CPUNumber]) {
+				continue;
+			}
+			size_t Count = cpu.ReadyCount();
+			if (Count > Most) {
+				Most = Count;
+				Victim = &cpu;
+			}
+		}
+		if (Victim == nullptr) {
+			return nullptr;
+		}
+
+		Task* task = Victim->StealReady();
+		if (task != nullptr) {
+			thief.StolenTasks++;
+			return task;
+		}
+		Tried[Victim->CPUNumber] = true;
+	}
+
+}
+
+// 输出完成时间（最后一个 CPU 结束的时间）和每个 CPU 的利用率
+void OS::Report() {
+
+	long long Makespan = 0;
+	for (auto& cpu : CPUS) {
+		Makespan = max(Makespan, cpu.FinishedAt);
+	}
+
+	string Console = string("调度模式：") + (Schedule == ScheduleMode::WorkStealing ? "工作窃取" : "静态划分") +
+		"，完成时间（makespan）：" + to_string(Makespan) + " 个时钟周期";
+	Print(LogLevel::Report, Console);
+
+	for (auto& cpu : CPUS) {
+		double Utilization = Makespan > 0 ? 100.0 * cpu.BusyTicks / Makespan : 0;
+		Console = "CPU " + to_string(cpu.CPUNumber) + " 执行 " + to_string(cpu.BusyTicks) + " 个时钟周期，窃取 " +
+			to_string(cpu.StolenTasks) + " 个任务，利用率 " + to_string(Utilization) + "%";
+		Print(LogLevel::Report, Console);
+	}
+
+	// 调度效果：任务都在时刻 0 到达，周转时间即完成时间，响应时间即第一次执行的时间
+	vector<long long> Turnaround, Response, IoTurnaround, CpuTurnaround;
+	LatencyHistogram WakeLatencies;
+	long long IdleTicks = 0, Boosts = 0;
+	for (auto& cpu : CPUS) {
+		for (auto& task : cpu.TaskPool) {
+			if (task.CompletedAt < 0) {
+				continue; // 分配失败被放弃
+			}
+			Turnaround.push_back(task.CompletedAt);
+			Response.push_back(task.FirstRunAt);
+			(task.Class == TaskClass::IoBound ? IoTurnaround : CpuTurnaround).push_back(task.CompletedAt);
+		}
+		WakeLatencies.Merge(cpu.WakeLatencies);
+		IdleTicks += cpu.IdleTicks;
+		Boosts += cpu.Boosts;
+	}
+	size_t Completed = Turnaround.size();
+	Console = "调度策略：" + PolicyName(Policy);
+	if (Policy == SchedulePolicy::RoundRobin) {
+		Console += "，时间片 " + to_string(Quantum);
+	}
+	else if (Policy == SchedulePolicy::Mlfq) {
+		Console += "，各级时间片";
+		for (int Quantum : MlfqQuanta) {
+			Console += " " + to_string(Quantum);
+		}
+		Console += "，每 " + to_string(MlfqBoostPeriod) + " 个时钟周期提升优先级（共 " + to_string(Boosts) + " 次）";
+	}
+	Console += "，完成 " + to_string(Completed) + " 个任务（I/O 密集型 " + to_string(IoTurnaround.size()) + " 个），吞吐量 " +
+		to_string(Makespan > 0 ? (double)Completed / Makespan : 0) + " 个/时钟周期，空转 " + to_string(IdleTicks) + " 个时钟周期";
+	Print(LogLevel::Report, Console);
+	Console = "周转时间：" + Distribution(Turnaround);
+	Print(LogLevel::Report, Console);
+	Console = "响应时间：" + Distribution(Response);
+	Print(LogLevel::Report, Console);
+	if (IoBoundPercent > 0) {
+		Console = "I/O 密集型任务周转时间：" + Distribution(IoTurnaround);
+		Print(LogLevel::Report, Console);
+		Console = "CPU 密集型任务周转时间：" + Distribution(CpuTurnaround);
+		Print(LogLevel::Report, Console);
+		Console = "I/O 完成到重新调度的等待：" + Distribution(WakeLatencies);
+		Print(LogLevel::Report, Console);
+	}
+
+	if (CompactEnabled) {
+		Console = "内存整理 " + to_string(CompactionRuns.load()) + " 次，搬移 " + to_string(CompactedBytes.load()) +
+			" 字节，挽救 " + to_string(RescuedAllocations.load()) + " 次分配";
+		Print(LogLevel::Report, Console);
+	}
+
+	if (MEMORY.NodeCount > 1) {
+		Console = to_string(MEMORY.NodeCount) + " 个 NUMA 节点，策略：" + (Numa == NumaPolicy::Local ? "本地优先" : "交错") +
+			"，本地分配 " + to_string(LocalAllocations.load()) + " 次，远程分配 " + to_string(RemoteAllocations.load()) + " 次";
+		Print(LogLevel::Report, Console);
+		for (auto& cpu : CPUS) {
+			Console = "CPU " + to_string(cpu.CPUNumber) + "（节点 " + to_string(cpu.HomeNode) + "）远程执行 " + to_string(cpu.RemoteTicks) +
+				" 个时钟周期，因远程访问多用 " + to_string(cpu.StallTicks) + " 个时钟周期";
+			Print(LogLevel::Report, Console);
+		}
+	}
+
+	if (MEMORY.HugePages) {
+		Console = "大页分配 " + to_string(MEMORY.HugeAllocations.load()) + " 次，回退到 4KB 页 " + to_string(MEMORY.HugeFallbacks.load()) +
+			" 次，拆分 " + to_string(MEMORY.HugeSplits.load()) + " 个，尾部浪费峰值 " + to_string(MEMORY.HugeSlackPeak.load() * PAGE_SIZE) + " 字节";
+		Print(LogLevel::Report, Console);
+	}
+
+	if (CacheModel != CacheModelMode::Off) {
+		long long Accesses = 0;
+		long long Cycles = 0;
+		for (auto& cpu : CPUS) {
+			MemoryHierarchy& Caches = cpu.Caches;
+			Console = "CPU " + to_string(cpu.CPUNumber) + " 访存 " + to_string(Caches.Accesses) + " 次，TLB 缺失率 " +
+				to_string(Caches.Tlb.MissRate()) + "%";
+			if (Caches.CachesEnabled) {
+				Console += "，L1 缺失率 " + to_string(Caches.L1.MissRate()) + "%，L2 缺失率 " + to_string(Caches.L2.MissRate()) + "%";
+			}
+			if (Caches.PageFaults > 0) {
+				Console += "，缺页 " + to_string(Caches.PageFaults) + " 次";
+			}
+			if (Caches.Shootdowns > 0) {
+				Console += "，TLB 击落 " + to_string(Caches.Shootdowns) + " 次";
+			}
+			Console += "，模拟 " + to_string(Caches.Cycles) + " 个周期";
+			Print(LogLevel::Report, Console);
+			Accesses += Caches.Accesses;
+			Cycles += Caches.Cycles;
+		}
+		double PerAccess = Accesses > 0 ? (double)Cycles / Accesses : 0;
+		Console = "访存共 " + to_string(Accesses) + " 次，模拟 " + to_string(Cycles) + " 个周期，平均每次 " + to_string(PerAccess) + " 个周期";
+		Print(LogLevel::Report, Console);
+	}
+
+	if (PAGER.Enabled) {
+		double FaultRate = PAGER.References > 0 ? 100.0 * PAGER.Faults / PAGER.References : 0;
+		Console = "请求调页（" + PAGER.Policy->Name() + "）：访问 " + to_string(PAGER.References) + " 次，缺页 " +
+			to_string(PAGER.Faults) + " 次（缺页率 " + to_string(FaultRate) + "%），淘汰 " + to_string(PAGER.Evictions) +
+			" 次，换出 " + to_string(PAGER.SwapOuts) + " 次，换入 " + to_string(PAGER.SwapIns) + " 次";
+		Print(LogLevel::Report, Console);
+		double AverageSet = PAGER.WorkingSetSamples > 0 ? (double)PAGER.WorkingSetTotal / PAGER.WorkingSetSamples : 0;
+		Console = "工作集（最近 " + to_string(WORKING_SET_WINDOW) + " 个时钟周期）：平均 " + to_string(AverageSet) + " 页，最大 " +
+			to_string(PAGER.WorkingSetPeak) + " 页，物理页框 " + to_string(PAGER.FrameCount) + " 页";
+		Print(LogLevel::Report, Console);
+	}
+
+}
+
+// 中断函数
+void OS::Trap(CPU& cpu) {
+
+	cpu.Current->LastTrapAt = Now();
+	if (Recorder.IsOpen()) {
+		Recorder.Record(TraceEvent::Trap, cpu.Current->LastTrapAt, cpu.CPUNumber, cpu.Current->TraceId, 0);
+	}
+
+	Print(LogLevel::Debug, LogEventKind::Trap, cpu, cpu.Current->RemainingTime);
+
+}
+
+// 访存模型：一半访问按缓存行顺序扫描任务的内存，其余大多落在开头 STREAM_HOT_BYTES 字节内，少数随机。
+// 连续分配时物理地址就是 Start 加偏移，TLB 按物理页查；请求调页时经 Pager::Reference 翻译，TLB 按（地址空间，虚拟页）查，
+// 不在内存中的页面缺页装入并计入 PAGE_FAULT_CYCLES；以大页分配的任务按 2MB 页查 TLB
+void OS::SimulateAccesses(CPU& cpu) {
+
+	Task& task = *cpu.Current;
+	long long Hot = min(task.Size, (long long)STREAM_HOT_BYTES);
+	bool Huge = task.SpaceId == 0 && MEMORY.HugePages && MEMORY.IsHuge(task.Start); // 大页一个 TLB 项覆盖 2MB
+
+	for (int i = 0; i < STREAM_ACCESSES_PER_TICK; i++) {
+		long long Offset = 0;
+		int Kind = GetRandomIntThreadSafe() % 100;
+		if (Kind < STREAM_SEQUENTIAL_PERCENT) {
+			Offset = task.StreamOffset;
+			task.StreamOffset = (task.StreamOffset + (1 << CACHE_LINE_SHIFT)) % task.Size;
+		}
+		else if (Kind < STREAM_SEQUENTIAL_PERCENT + (100 - STREAM_SEQUENTIAL_PERCENT) * 9 / 10) {
+			Offset = GetRandomIntThreadSafe() % Hot;
+		}
+		else {
+			Offset = GetRandomIntThreadSafe() % task.Size;
+		}
+
+		if (task.SpaceId != 0) {
+			// 只在翻译时持有 PAGER.Lock（其他 CPU 缺页时可能淘汰本任务的页面），TLB 和缓存模型在锁外
+			long long Page = Offset / PAGE_SIZE;
+			long long Frame = -1;
+			bool Resident = false;
+			{
+				lock_guard<mutex> PagerGuard(PAGER.Lock);
+				Resident = task.PageTable[Page].Frame >= 0;
+				Frame = PAGER.Reference(task, Page);
+			}
+			if (!Resident) {
+				cpu.Caches.Fault();
+			}
+			if (Frame < 0) {
+				continue; // 没有页框可用，这次访问只计缺页的周期
+			}
+			cpu.Caches.Access(Pager::KeyOf(task.SpaceId, Page), Frame * PAGE_SIZE + Offset % PAGE_SIZE);
+		}
+		else if (Huge) {
+			long long Address = task.Start + Offset;
+			cpu.Caches.Access(TLB_HUGE_TAG | (uint64_t)(Address / HUGE_PAGE_SIZE), Address);
+		}
+		else {
+			long long Address = task.Start + Offset;
+			cpu.Caches.Access(Address / PAGE_SIZE, Address);
+		}
+	}
+}
+
+// TLB 击落：请求放进每个 CPU 的待处理列表，由该 CPU 在下一次访问前处理
+void OS::ShootdownTlb(uint64_t FirstKey, uint64_t Count) {
+
+	if (CacheModel == CacheModelMode::Off) {
+		return;
+	}
+	for (auto& cpu : CPUS) {
+		cpu.Caches.Shootdown(FirstKey, Count);
+	}
+}
+
+// 申请内存，输入为CPU，成功返回 1。
+bool OS::New(CPU& cpu) {
+
+	Task& task = *cpu.Current;
+
+	// NUMA：本地优先从本 CPU 所在节点开始找，交错轮流从各节点开始找
+	int PreferredNode = -1;
+	if (MEMORY.NodeCount > 1) {
+		PreferredNode = Numa == NumaPolicy::Local ? cpu.HomeNode : NextInterleaveNode++ % MEMORY.NodeCount;
+	}
+	task.Node = PreferredNode; // 请求调页时页框优先从这个节点分配
+
+	// 请求调页：只建立地址空间，页框在访问时才分配，Start 是虚拟地址空间的起点（地址 0 表示未分配）
+	long long Start = 0;
+	if (PAGER.Enabled) {
+		PAGER.CreateSpace(task);
+		Start = PAGE_SIZE;
+	}
+
+	// 小对象走本 CPU 的 slab 缓存，不经过全局内存锁
+	if (Start == 0 && SlabEnabled && task.Size <= SLAB_MAX_OBJECT_SIZE) {
+		Start = cpu.Slabs.Allocate(task.Size);
+	}
+
+	if (Start == 0) {
+		Start = MEMORY.Allocate(task.Size, &task, PreferredNode);
+		if (Start == 0 && CompactEnabled) {
+			Start = Compact(task, PreferredNode); // 空闲页面够但不连续，整理后再试一次
+		}
+		if (Start == 0) {
+			return 0;
+		}
+	}
+
+	task.Start = Start;
+	task.AllocatedAt = Now();
+	if (task.SpaceId == 0) {
+		task.Node = MEMORY.NodeOf(Start / PAGE_SIZE);
+	}
+	if (MEMORY.NodeCount > 1) {
+		if (task.Node == cpu.HomeNode) {
+			LocalAllocations++;
+		}
+		else {
+			RemoteAllocations++;
+		}
+	}
+
+	// 录制轨迹
+	if (Recorder.IsOpen()) {
+		task.TraceId = Recorder.NextId();
+		Recorder.Record(TraceEvent::Allocate, task.AllocatedAt, cpu.CPUNumber, task.TraceId, (uint32_t)task.Size);
+	}
+
+	return 1;
+}
+
+// 内存整理后为任务重新分配，成功返回起始地址，失败返回 0。
+// 先取内存锁再取所有就绪队列锁（没有地方在持有队列锁时申请内存），队列里已分配内存的任务此时不会被取出执行，
+// 可以放心搬它们的页段、改 Start。只支持 GlobalLock：Concurrent 没有能让别人停下的锁，Tlsf 不能指定位置分配
+long long OS::Compact(Task& task, int PreferredNode) {
+
+	if (MEMORY.Mode != MemoryMode::GlobalLock) {
+		return 0;
+	}
+
+	lock_guard<mutex> MemoryGuard(MEMORY.MemoryLock);
+	vector<unique_lock<mutex>> QueueGuards;
+	unordered_set<Task*> Movable;
+	for (auto& cpu : CPUS) {
+		QueueGuards.emplace_back(cpu.QueueLock);
+		for (Task* Waiting : cpu.ReadyQueue) {
+			if (Waiting->Start != 0) {
+				Movable.insert(Waiting); // 被中断后在队列里等待的任务
+			}
+		}
+	}
+
+	CompactionRuns++;
+	long long MovedPages = 0;
+	bool Success = MEMORY.CompactLocked(task.Size, Movable, MovedPages);
+	CompactedBytes += MovedPages * PAGE_SIZE;
+	if (!Success) {
+		return 0;
+	}
+
+	long long Start = MEMORY.AllocateLocked(task.Size, &task, PreferredNode);
+	if (Start != 0) {
+		RescuedAllocations++;
+	}
+	return Start;
+}
+
+// 批量释放多个任务的内存，页段收集到 CPU 预留的缓冲区，合并成一批只加一次锁
+bool OS::Free(CPU& cpu, const vector<Task*>& Tasks) {
+
+	vector<pair<long long, long long>>& Blocks = cpu.ReleaseBuffer;
+	long long FreedAt = Now();
+	for (Task* task : Tasks) {
+		if (task->Start == 0) {
+			continue;
+		}
+		task->FreedAt = FreedAt;
+		if (task->TraceId != 0) {
+			Recorder.Record(TraceEvent::Free, FreedAt, cpu.CPUNumber, task->TraceId, (uint32_t)task->Size);
+			task->TraceId = 0;
+		}
+		if (task->SpaceId != 0) {
+			PAGER.DestroySpace(*task);
+		}
+		else if (cpu.Slabs.Owns(task->Start)) {
+			cpu.Slabs.Free(task->Start);
+		}
+		else {
+			Blocks.push_back({ task->Start, task->Size });
+		}
+		task->Start = 0;
+	}
+
+	MEMORY.Release(Blocks);
+	Blocks.clear();
+
+	return 1;
+}
+
+// 任务放回就绪队列
+void CPU::PushReady(Task* task) {
+	lock_guard<mutex> Guard(QueueLock);
+	task->ReadySeq = NextReadySeq++;
+	ReadyQueue.push_back(task);
+	push_heap(ReadyQueue.begin(), ReadyQueue.end(), TaskHeapLess);
+}
+
+// 取出按调度策略最优先的任务，队列为空返回 nullptr
+Task* CPU::PopReady() {
+	lock_guard<mutex> Guard(QueueLock);
+	if (ReadyQueue.empty()) {
+		return nullptr;
+	}
+	pop_heap(ReadyQueue.begin(), ReadyQueue.end(), TaskHeapLess);
+	Task* task = ReadyQueue.back();
+	ReadyQueue.pop_back();
+	return task;
+}
+
+// 被其他 CPU 窃取：从堆的叶子（另一端）取一个尚未分配内存的任务，
+// 已开始的任务可能持有本 CPU 的 slab 对象，只能由本 CPU 执行和释放
+Task* CPU::StealReady() {
+	lock_guard<mutex> Guard(QueueLock);
+	size_t Count = ReadyQueue.size();
+	for (size_t i = Count; i-- > Count / 2;) {
+		Task* task = ReadyQueue[i];
+		if (task->Start != 0) {
+			continue;
+		}
+		// 与末尾交换后删除，换过来的元素仍是叶子，上浮即可
+		ReadyQueue[i] = ReadyQueue.back();
+		ReadyQueue.pop_back();
+		if (i < ReadyQueue.size()) {
+			push_heap(ReadyQueue.begin(), ReadyQueue.begin() + i + 1, TaskHeapLess);
+		}
+		return task;
+	}
+	return nullptr;
+}
+
+// 就绪任务数
+size_t CPU::ReadyCount() {
+	lock_guard<mutex> Guard(QueueLock);
+	return ReadyQueue.size();
+}
+
+// CPU函数，实时模式下逐个时钟周期工作直到任务池为空
+void CPU::CPUWork() {
+	BeginWork();
+	while (Step()) {
+	}
+	EndWork();
+}
+
+// 开始工作
+void CPU::BeginWork() {
+	string Console = "CPU " + to_string(CPUNumber) + " 开始工作。";
+	os.Print(Console);
+}
+
+// 执行一个时钟周期，没有当前任务时先按调度策略选择任务并申请内存，任务池为空返回 0
+bool CPU::Step() {
+	// 唤醒 I/O 完成的任务；MLFQ 定期提升优先级，防止饿死
+	WakeBlocked();
+	if (os.Policy == SchedulePolicy::Mlfq && os.Now() - LastBoostAt >= os.MlfqBoostPeriod) {
+		BoostPriorities();
+	}
+
+	// 选择堆顶的任务
+	while (Current == nullptr) {
+		Current = PopReady();
+		if (Current == nullptr && os.Schedule == ScheduleMode::WorkStealing) {
+			Current = os.Steal(*this);
+			if (Current != nullptr) {
+				os.Print(LogLevel::Debug, LogEventKind::Steal, *this);
+				Current->VirtualRuntime = max(Current->VirtualRuntime, MinVruntime); // 公平调度：迁移来的任务不能独占 CPU
+			}
+		}
+		if (Current == nullptr) {
+			if (Blocked.empty()) {
+				return 0;
+			}
+			// 都在等 I/O，空转一个时钟周期，空转前归还已完成任务的内存
+			FreeRetired();
+			if (!os.VirtualTime) {
+				this_thread::sleep_for(chrono::seconds(1));
+			}
+			IdleTicks++;
+			return 1;
+		}
+
+		// 每次调度都会输出的细节，只记录结构化事件，输出时才格式化
+		os.Print(LogLevel::Debug, LogEventKind::Select, *this, Current->RemainingTime);
+
+		// 申请内存（如果尚未分配），失败的任务不再放回就绪队列
+		if (Current->Start == 0) {
+			bool Allocated = os.New(*this);
+			if (!Allocated && !Retired.empty()) {
+				FreeRetired(); // 先释放攒着的已完成任务再试一次
+				Allocated = os.New(*this);
+			}
+			if (!Allocated) {
+				os.Print(LogLevel::Warn, LogEventKind::AllocationFailed, *this);
+				Current = nullptr;
+				continue;
+			}
+			os.Print(LogLevel::Debug, LogEventKind::Allocated, *this, Current->Start, Current->Size);
+		}
+
+		// 记录第一次执行（响应时间）和 I/O 完成后的等待
+		SliceTicks = 0;
+		if (Current->FirstRunAt < 0) {
+			Current->FirstRunAt = os.Now();
+		}
+		if (Current->ReadySince >= 0) {
+			WakeLatencies.Add((uint32_t)(os.Now() - Current->ReadySince));
+			Current->ReadySince = -1;
+		}
+		MinVruntime = max(MinVruntime, Current->VirtualRuntime);
+	}
+
+	// 执行一个时钟周期，虚拟时间模式下由事件队列推进时钟；任务内存在其他 NUMA 节点时多花 NUMA_REMOTE_PENALTY_PERCENT%
+	bool Remote = os.MEMORY.NodeCount > 1 && Current->Node != HomeNode;
+	if (!os.VirtualTime) {
+		this_thread::sleep_for(chrono::milliseconds(Remote ? 1000 + 10 * NUMA_REMOTE_PENALTY_PERCENT : 1000));
+	}
+	if (Remote) {
+		RemoteTicks++;
+		StallPercent += NUMA_REMOTE_PENALTY_PERCENT;
+		if (!os.VirtualTime) {
+			StallTicks += StallPercent / 100; // 实时模式下已经多等了，只做统计
+			StallPercent %= 100;
+		}
+	}
+	Current->RemainingTime--;
+	BusyTicks++;
+	if (Current->SpaceId != 0) {
+		os.PAGER.Touch(*Current); // 按局部性访问页面，缺页时装入
+	}
+	if (Caches.Enabled) {
+		os.SimulateAccesses(*this);
+	}
+	SliceTicks++;
+	Current->LevelTicks++;
+	Current->VirtualRuntime++; // 权重相同，虚拟运行时间即执行的时钟周期数
+
+	// I/O 密集型任务发起 I/O，先于时钟中断主动让出 CPU
+	if (Current->RemainingTime > 0 && Current->Class == TaskClass::IoBound && GetRandomIntThreadSafe() % 100 < IO_BLOCK_PERCENT) {
+		Current->WakeAt = os.Now() + IO_WAIT_TICKS;
+		Blocked.push_back(Current);
+		Current = nullptr;
+		return 1;
+	}
+
+	// SJF 保持 30% 概率的随机中断，其他策略在时间片用完时抢占
+	bool Interrupted = os.Policy == SchedulePolicy::Sjf ? GetRandomIntThreadSafe() % 10 < 3 : SliceExpired();
+	if (Interrupted) {
+		os.Trap(*this);
+
+		// 如果还有剩余时间，放回就绪队列
+		if (Current->RemainingTime > 0) {
+			os.Print(LogLevel::Debug, LogEventKind::Preempted, *this, Current->RemainingTime);
+			PushReady(Current);
+			Current = nullptr;
+			return 1;
+		}
+	}
+
+	// 完成任务处理
+	if (Current->RemainingTime == 0) {
+		os.Print(LogLevel::Debug, LogEventKind::Completed, *this);
+		Current->CompletedAt = os.Now();
+		Retired.push_back(Current); // 攒够一批再释放内存
+		Current = nullptr;
+		if (Retired.size() >= FREE_BATCH_TASKS) {
+			FreeRetired();
+		}
+	}
+
+	return 1;
+}
+
+// 时间片是否用完：轮转用固定时间片，公平调度把调度周期按就绪任务数平分；
+// MLFQ 用完本级时间片就降一级（最低级只轮转），有更高优先级的任务就绪时也抢占
+bool CPU::SliceExpired() {
+
+	switch (os.Policy) {
+	case SchedulePolicy::RoundRobin:
+		return SliceTicks >= os.Quantum;
+	case SchedulePolicy::Fair: {
+		long long Slice = max((long long)FAIR_MIN_GRANULARITY, (long long)(FAIR_LATENCY_TICKS / (ReadyCount() + 1)));
+		return SliceTicks >= Slice;
+	}
+	case SchedulePolicy::Mlfq: {
+		int Lowest = (int)os.MlfqQuanta.size() - 1;
+		if (Current->LevelTicks >= os.MlfqQuanta[Current->Level]) {
+			if (Current->Level < Lowest) {
+				Current->Level++;
+			}
+			Current->LevelTicks = 0;
+			return 1;
+		}
+		lock_guard<mutex> Guard(QueueLock);
+		return !ReadyQueue.empty() && ReadyQueue.front()->Level < Current->Level;
+	}
+	default:
+		return 0;
+	}
+}
+
+// 把 I/O 已完成的任务放回就绪队列；睡眠回来的任务虚拟运行时间最多比下界少半个调度周期
+void CPU::WakeBlocked() {
+
+	long long Now = os.Now();
+	for (size_t i = 0; i < Blocked.size();) {
+		Task* task = Blocked[i];
+		if (task->WakeAt > Now) {
+			i++;
+			continue;
+		}
+		Blocked[i] = Blocked.back();
+		Blocked.pop_back();
+		task->ReadySince = Now;
+		task->VirtualRuntime = max(task->VirtualRuntime, MinVruntime - FAIR_LATENCY_TICKS / 2);
+		PushReady(task);
+	}
+}
+
+// MLFQ：正在执行、等待 I/O 和就绪的任务都回到最高优先级，然后重新建堆
+void CPU::BoostPriorities() {
+
+	LastBoostAt = os.Now();
+	Boosts++;
+	if (Current != nullptr) {
+		Current->Level = 0;
+		Current->LevelTicks = 0;
+	}
+	for (Task* task : Blocked) {
+		task->Level = 0;
+		task->LevelTicks = 0;
+	}
+
+	lock_guard<mutex> Guard(QueueLock);
+	for (Task* task : ReadyQueue) {
+		task->Level = 0;
+		task->LevelTicks = 0;
+	}
+	make_heap(ReadyQueue.begin(), ReadyQueue.end(), TaskHeapLess);
+}
+
+// 已完成任务的内存一起释放，页段只加一次内存锁
+void CPU::FreeRetired() {
+
+	if (Retired.empty()) {
+		return;
+	}
+	os.Free(*this, Retired);
+	Retired.clear();
+}
+
+// 结束工作
+void CPU::EndWork() {
+
+	// 剩下的已完成任务先释放（slab 对象要在归还 slab 缓存之前放回），再归还 slab 缓存占用的页面
+	FreeRetired();
+	Slabs.Release();
+
+	FinishedAt = os.Now();
+
+	string Console = "CPU " + to_string(CPUNumber) + " 工作结束。";
+	os.Print(Console);
+}
+
+// 事件按时间排序，时间早的先处理，同一时刻按 CPU 编号处理
+bool Event::operator<(const Event& other) const {
+	if (Time != other.Time) {
+		return Time > other.Time;
+	}
+	return CPUNumber > other.CPUNumber;
+}
+
+// 多线程安全的随机正int数生成器
+int GetRandomIntThreadSafe() {
+	thread_local mt19937 gen(random_device{}());
+	uniform_int_distribution<int> dist(0, 2147483647);
+	return dist(gen);
+}
+
+// 按任务的内存需求分布随机一个大小
+long long RandomTaskSize() {
+
+	// 随机决定分配哪种大小的内存
+	int RandType = GetRandomIntThreadSafe() % 100 + 1; // 1-100
+
+	if (RandType <= 60) {
+		// 小内存 (1-128字节)
+		return (GetRandomIntThreadSafe() % 128LL) + 1;
+	}
+	else if (RandType <= 95) {
+		// 中等内存 (4KB)
+		return 4LL * 1024;
+	}
+	else {
+		// 大内存 (4KB-16MB)
+		return (GetRandomIntThreadSafe() % (16LL * 1024 * 1024 - 4 * 1024 + 1)) + 4LL * 1024;
+	}
+}
+
+// 基准测试适配器：全局内存（两种分配模式，可选每线程 slab 缓存）
+class MemoryBenchAllocator : public BenchAllocator
+{
+public:
+	MemoryBenchAllocator(MemoryMode Mode, bool UseSlab, long long PageCount) : Mode(Mode), UseSlab(UseSlab), PageCount(PageCount) {}
+
+	string Name() const override {
+		string ModeName = Mode == MemoryMode::GlobalLock ? "全局锁" : Mode == MemoryMode::Concurrent ? "并发" : "TLSF";
+		return ModeName + (UseSlab ? " + slab 缓存" : "");
+	}
+
+	// 每轮固定 PageCount 个空闲页面
+	void Reset() override {
+		os.MEMORY.Mode = Mode;
+		os.MEMORY.Reset(PageCount);
+	}
+
+	long long Allocate(long long Size) override {
+		if (UseSlab && Size <= SLAB_MAX_OBJECT_SIZE) {
+			long long Start = LocalSlabs().Allocate(Size);
+			if (Start != 0) {
+				return Start;
+			}
+		}
+		return os.MEMORY.Allocate(Size, nullptr);
+	}
+
+	void Release(long long Handle, long long Size) override {
+		if (UseSlab && LocalSlabs().Owns(Handle)) {
+			LocalSlabs().Free(Handle);
+			return;
+		}
+		os.MEMORY.Release(Handle, Size);
+	}
+
+	void ThreadExit() override {
+		if (UseSlab) {
+			LocalSlabs().Release();
+		}
+	}
+
+	long long FootprintBytes() override {
+		return (os.MEMORY.Pages.PageCount() - os.MEMORY.Pages.CountFree()) * PAGE_SIZE;
+	}
+
+private:
+	MemoryMode Mode;
+	bool UseSlab;
+	long long PageCount;
+
+	// 每个测试线程一个 slab 缓存
+	static SlabCache& LocalSlabs() {
+		thread_local SlabCache Cache;
+		return Cache;
+	}
+};
+
+// 内存分配基准测试：固定种子，对三种模式（各自带或不带 slab 缓存）从 1 到 MaxThreads 个线程逐轮测试
+// --bench-capacity 调小内存容量时可比较各模式的失败次数
+void RunMemoryBenchmark() {
+
+	AllocBench Bench(os.Bench);
+	long long PageCount = os.Bench.CapacityMB > 0 ? os.Bench.CapacityMB * 1048576 / PAGE_SIZE : MAX_PAGES;
+	for (MemoryMode Mode : { MemoryMode::GlobalLock, MemoryMode::Concurrent, MemoryMode::Tlsf }) {
+		for (bool UseSlab : { false, true }) {
+			MemoryBenchAllocator Allocator(Mode, UseSlab, PageCount);
+			if (!Bench.Run(Allocator)) {
+				return;
+			}
+		}
+	}
+
+}
+
+// 输出函数，Info 级别
+void OS::Print(string& Text) {
+	Print(LogLevel::Info, Text);
+}
+
+// 按级别输出：写入本线程的日志缓冲区后立即返回，由后台线程批量输出
+void OS::Print(LogLevel Level, string& Text) {
+	if (!Log.Enabled(Level)) {
+		return;
+	}
+	if (VirtualTime) {
+		Log.Write(Level, "[T=" + to_string(VirtualNow) + "] " + Text);
+		return;
+	}
+	Log.Write(Level, Text);
+}
+
+// 输出 CPU 当前任务的结构化事件：只填定长记录交给日志，不拼接字符串也不分配内存，由 FormatLogEvent 输出
+void OS::Print(LogLevel Level, LogEventKind Kind, CPU& cpu, long long First, long long Second) {
+	if (!Log.Enabled(Level)) {
+		return;
+	}
+	LogEvent Event;
+	Event.Time = VirtualTime ? VirtualNow : -1;
+	Event.Subject = cpu.Current->Id;
+	Event.Values[0] = First;
+	Event.Values[1] = Second;
+	Event.Kind = (uint32_t)Kind;
+	Event.Source = cpu.CPUNumber;
+	Log.Write(Level, Event);
+}
+
+// 主函数
+int main(int argc, char* argv[]) {
+	if (!os.Configure(argc, argv)) {
+		return 1;
+	}
+	if (os.BenchMemory) {
+		RunMemoryBenchmark();
+		return 0;
+	}
+	if (!os.Init()) {
+		return 1;
+	}
 	os.Run();
+	os.Recorder.Close();
+	os.PAGER.Close();
 	return 0;
 }
\ No newline at end of file
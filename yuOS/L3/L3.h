@@ -8,6 +8,24 @@
 #include <string>
 #include <chrono>
 #include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <map>
+#include <bitset>
+#include <queue>
+#include <deque>
+#include <memory>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../common/PageBitmap.h"
+#include "../common/AsyncLog.h"
+#include "../common/AllocBench.h"
+#include "../common/AllocTrace.h"
+#include "../common/TlsfAllocator.h"
+#include "../common/PageReplacement.h"
+#include "../common/CacheModel.h"
+#include "../common/Affinity.h"
 
 using namespace std;
 
@@ -16,74 +34,453 @@ using namespace std;
 #define CPU_MAX_NUMBER 8 // 最大CPU数目
 #define TASK_OF_EACH_CPU 5 // 每个 CPU 的任务数（测试用）
 #define PAGE_SIZE 4096 // 单个页大小 4 KB
+#define SLAB_MIN_OBJECT_SIZE 16 // slab 最小大小类（字节）
+#define SLAB_MAX_OBJECT_SIZE 4096 // 走 slab 缓存的最大任务内存（字节）
+#define SLAB_SIZE 65536 // 每次从全局内存批量申请的 slab 大小（字节）
+#define SLAB_SIZE_CLASS_COUNT 9 // 大小类数量：16, 32, ..., 4096
+#define OWNER_SHARD_COUNT 64 // 占用者索引分片数
+#define OWNER_REGION_PAGES 4096 // 占用者索引每个区域的页面数（16 MB）
+#define HUGE_PAGE_SIZE 2097152 // 大页大小 2 MB
+#define HUGE_PAGE_PAGES 512 // 每个大页包含的 4 KB 页数
+#define HUGE_PAGE_MIN_SIZE 1048576 // 启用大页时，不小于该大小的请求按大页分配（更小的取整浪费超过一半）
+#define TLB_HUGE_TAG (1ULL << 63) // 大页 TLB 项的标记位，与 4KB 页的项区分
+#define NUMA_MAX_NODES 8 // 最大 NUMA 节点数
+#define NUMA_REMOTE_PENALTY_PERCENT 60 // 任务内存不在 CPU 所在节点时，每个时钟周期额外花费的百分比
+#define COMPACT_MAX_PAGES 4096 // 一次内存整理最多搬移的页面数（16 MB），限制整理时其他 CPU 等待的时间
+#define COMPACT_MAX_WINDOWS 1024 // 一次内存整理最多检查的候选窗口数，下次从停下的位置继续
+#define RR_QUANTUM 2 // 轮转调度默认的时间片（时钟周期）
+#define MLFQ_MAX_LEVELS 8 // MLFQ 最多的优先级数
+#define MLFQ_BOOST_PERIOD 20 // MLFQ 默认的优先级提升周期（时钟周期）
+#define FAIR_LATENCY_TICKS 6 // 公平调度的调度周期，按就绪任务数平分成时间片
+#define FAIR_MIN_GRANULARITY 1 // 公平调度的最小时间片
+#define IO_BLOCK_PERCENT 70 // I/O 密集型任务每执行一个时钟周期后阻塞的概率（%）
+#define IO_WAIT_TICKS 3 // 一次 I/O 阻塞的时钟周期数
+#define FREE_BATCH_TASKS 8 // 已完成的任务攒够这么多个再一起释放内存
+#define PAGING_TOUCHES_PER_TICK 16 // 请求调页：任务每个时钟周期访问的页面数（不超过任务的页数）
+#define PAGING_HOT_PERCENT 90 // 访问落在热点区域的百分比，其余均匀分布在整个地址空间
+#define PAGING_WRITE_PERCENT 30 // 写访问的百分比，写过的页面被淘汰时要写入交换文件
+#define WORKING_SET_WINDOW 2 // 工作集窗口：任务最近执行的多少个时钟周期内访问过的页面
+#define STREAM_ACCESSES_PER_TICK 512 // 访存模型：任务每个时钟周期产生的访问数
+#define STREAM_SEQUENTIAL_PERCENT 50 // 顺序扫描（每次前进一个缓存行）的百分比
+#define STREAM_HOT_BYTES 65536 // 其余访问中落在任务开头这么多字节内的占 9/10，剩下的均匀分布
 
 int GetRandomIntThreadSafe();
+long long RandomTaskSize();
+void RunMemoryBenchmark();
 
-struct Page;
+struct PageRun;
+struct OwnerShard;
 struct Memory;
+struct PageTableEntry;
+struct Pager;
 struct Task;
+struct Slab;
+struct SlabCache;
 struct CPU;
+struct Event;
 struct OS;
 
-// 页面结构体
-struct Page
+// 页段记录：一次分配占用的连续页面
+struct PageRun
+{
+	long long PageCount = 0; // 页面数
+	Task* OccupiedTask = nullptr; // 占用此页段的任务
+	bool Huge = false; // 是否以大页映射（页数为 HUGE_PAGE_PAGES 的整数倍，起始页按 2MB 对齐）
+	long long NeededPages = 0; // 请求实际需要的页数，大页尾部多出的页面在拆分时归还
+};
+
+// 占用者索引的一个分片，覆盖若干个区域，有自己的锁
+struct OwnerShard
+{
+	mutex Lock; // 分片锁
+	map<long long, PageRun>Runs; // 页段首页号到页段记录
+};
+
+// 内存分配模式
+enum class MemoryMode
+{
+	GlobalLock, // 搜索和修改都持有 MemoryLock，所有内存操作串行
+	Concurrent, // 不加全局锁：乐观搜索位图后用 CAS 占用页段，占用者索引按区域分片加锁
+	Tlsf // 持有 MemoryLock，以页为单位用两级分离适配（TLSF）分配，不要求按请求大小对齐
+};
+
+// 访存模型
+enum class CacheModelMode
+{
+	Off, // 不模拟
+	Tlb, // 只模拟每 CPU 的 TLB
+	Full // 模拟 TLB 和每 CPU 的 L1、L2 缓存
+};
+
+// NUMA 分配策略
+enum class NumaPolicy
+{
+	Local, // 优先在 CPU 所在节点分配，不足时依次使用其他节点
+	Interleave // 各次分配轮流从不同节点开始
+};
+
+// 调度策略
+enum class SchedulePolicy
+{
+	Sjf, // 最短作业优先，只靠 30% 的随机中断抢占
+	RoundRobin, // 轮转，时间片用完排到队尾
+	Mlfq, // 多级反馈队列：用完本级时间片降级，高优先级任务就绪时抢占，定期全部提升
+	Fair // 公平调度（类似 CFS）：虚拟运行时间最小的先执行
+};
+
+// 任务类型
+enum class TaskClass
+{
+	CpuBound, // CPU 密集型
+	IoBound // I/O 密集型：执行后有 IO_BLOCK_PERCENT 的概率阻塞 IO_WAIT_TICKS 个时钟周期
+};
+
+// 调度循环中的结构化日志事件，只记录编号和参数，输出时才格式化
+enum class LogEventKind : uint32_t
+{
+	Steal, // 窃取任务
+	Select, // 选择任务，参数为剩余时间
+	AllocationFailed, // 分配失败，跳过任务
+	Allocated, // 分配内存，参数为起始地址和大小
+	Preempted, // 中断保存，参数为剩余时间
+	Completed, // 完成任务
+	Trap // 中断，参数为剩余时间
+};
+
+// 调度模式
+enum class ScheduleMode
 {
-	int PageNumber = 0; // 页面编号，从零开始
-	const int Size = PAGE_SIZE; // 页面大小
-	Task* OccupiedTask = nullptr; // 占用此页的任务
+	Static, // 静态划分：每个 CPU 只执行 Init 时分给自己的任务
+	WorkStealing // 工作窃取：自己的就绪队列为空时，从就绪任务最多的 CPU 窃取尚未开始的任务
 };
 
 // 内存
 struct Memory
 {
-	vector<Page>Pages; // 页面
-	mutex MemoryLock; // 总的内存锁，将内存操作约束为串行防止不同步
+	PageBitmap Pages; // 页面占用位图
+	OwnerShard Owners[OWNER_SHARD_COUNT]; // 占用者索引：按页段首页号所在区域分片
+	mutex MemoryLock; // 总的内存锁，将内存操作约束为串行防止不同步（GlobalLock 模式）
+	MemoryMode Mode = MemoryMode::GlobalLock; // 分配模式
+	TlsfAllocator Tlsf[NUMA_MAX_NODES]; // Tlsf 模式下每个节点的空闲页段索引，受 MemoryLock 保护
+	int NodeCount = 1; // NUMA 节点数，页面按编号平均分成 NodeCount 段，须在 Init 前设置
+	long long InitPages = 0; // Init 使用的页面数，0 表示在 MIN_PAGES 到 MAX_PAGES 之间随机
+	bool HugePages = false; // 是否为大请求分配 2MB 大页
+	atomic<long long> HugeAllocations{ 0 }; // 按大页分配成功的次数
+	atomic<long long> HugeFallbacks{ 0 }; // 没有对齐的空闲大页、回退到 4KB 页的次数
+	atomic<long long> HugeSplits{ 0 }; // 为普通请求拆分的大页数
+	atomic<long long> HugeSlackPages{ 0 }; // 当前大页尾部多出的页数（内部碎片）
+	atomic<long long> HugeSlackPeak{ 0 }; // 大页尾部多出页数的峰值
+	long long CompactCursor = 0; // 内存整理下次开始检查的页号，受 MemoryLock 保护
 
 	// 内存的初始化函数
 	bool Init();
 
+	// 按给定页面数重置内存，所有页面空闲
+	void Reset(long long PageCount);
+
+	// 页段首页号所在的占用者索引分片
+	OwnerShard& ShardOf(long long FirstPage);
+
+	// 节点的第一个页号，Node 等于 NodeCount 时返回总页数
+	long long NodeFirstPage(int Node);
+
+	// 页面所在的节点
+	int NodeOf(long long Page);
+
 	bool CheckMemory(long long Start, long long Size);
 
+	// 按对齐约定分配一段内存并标记占用者，优先使用 PreferredNode（-1 表示不限），成功返回起始地址，失败返回 0
+	long long Allocate(long long Size, Task* Owner, int PreferredNode = -1);
+
+	// 同 Allocate，GlobalLock 和 Tlsf 模式下调用者需持有 MemoryLock
+	long long AllocateLocked(long long Size, Task* Owner, int PreferredNode = -1);
+
+	// 按当前模式占用 Count 个、起始页号按 Align 对齐且不小于 FirstPage 的页面，返回起始页号，失败返回 -1
+	// 先在 PreferredNode 内找，再依次尝试其他节点，页段不跨节点
+	long long ClaimRun(long long Count, long long Align, long long FirstPage, int PreferredNode);
+
+	// 在占用者索引中记录页段
+	void RecordRun(long long StartPageNumber, const PageRun& Run);
+
+	// 按需拆分尾部有多余页面的大页并归还多余页面，归还的尾部放得下 PageCount 页（按 PageAlign 对齐）时停止；
+	// 没有多余页面的大页保持不变。返回归还的页数
+	long long SplitHugePages(long long PageCount, long long PageAlign);
+
+	// 从 Start 开始的分配当前是否以大页映射
+	bool IsHuge(long long Start);
+
+	// 内存整理（GlobalLock 模式，调用者持有 MemoryLock）：选一段满足 Size 对齐要求、需要搬移的页面最少的窗口，
+	// 把其中属于 Movable 任务的页段搬到窗口外，使窗口整段空闲。搬移量超过 COMPACT_MAX_PAGES 或窗口中
+	// 有不能搬移的页段时放弃。每次最多检查 COMPACT_MAX_WINDOWS 个窗口，从 CompactCursor 继续。
+	// MovedPages 累加实际搬移的页面数，成功返回 1
+	bool CompactLocked(long long Size, const unordered_set<Task*>& Movable, long long& MovedPages);
+
+	// 按首页号顺序收集与页面区间 [From, To) 重叠的页段
+	void CollectRuns(long long From, long long To, vector<pair<long long, PageRun>>& Runs);
+
+	// 释放从 Start 开始、大小为 Size 的内存所覆盖的页面
+	void Release(long long Start, long long Size);
+
+	// 批量释放多个 (起始地址, 大小) 内存块，整批只加一次锁
+	void Release(const vector<pair<long long, long long>>& Blocks);
+
+	// 只清除该内存块自身覆盖的页面，GlobalLock 和 Tlsf 模式下调用者需持有 MemoryLock
+	void ReleaseLocked(long long Start, long long Size);
+
+};
+
+// 页表项：任务虚拟地址空间中的一页
+struct PageTableEntry
+{
+	long long Frame = -1; // 所在的物理页号，不在内存中为 -1
+	long long SwapSlot = -1; // 在交换文件中的槽号，从未换出过为 -1
+	bool Dirty = false; // 装入后是否写过（写过的页面淘汰时要写回交换文件）
+	int LastTouch = -1; // 最近一次访问时任务已执行的时钟周期数，用于统计工作集
+};
+
+// 请求调页：每个任务有自己的虚拟地址空间和页表，页面在第一次访问时才分配物理页框，
+// 页框用完时由置换策略选出页面淘汰，写过的页面写入交换文件，再次访问时读回。
+// 页框从 Memory 按页申请，所以位图照常反映物理内存的占用。所有操作持有 Lock（之后才取 MemoryLock）
+struct Pager
+{
+	mutex Lock; // 页表、置换策略和交换文件的锁
+	bool Enabled = false; // 是否启用请求调页
+	ReplacementKind Kind = ReplacementKind::Clock; // 置换策略
+	unique_ptr<ReplacementPolicy> Policy; // 置换策略实例
+	string SwapPath = "L3.swap"; // 交换文件路径，结束时删除
+	int SwapFile = -1; // 交换文件描述符
+	long long SwapSlots = 0; // 交换文件中用过的槽数
+	vector<long long>FreeSwapSlots; // 已归还、可复用的槽
+	vector<char>Buffer; // 换入换出用的一页缓冲区
+	unordered_map<uint32_t, Task*>Spaces; // 地址空间编号到任务
+	uint32_t LastSpaceId = 0; // 最后分出的地址空间编号
+	long long FrameCount = 0; // 可用的物理页框数
+
+	long long References = 0; // 访问次数
+	long long Faults = 0; // 缺页次数
+	long long SwapIns = 0; // 从交换文件读回的次数
+	long long SwapOuts = 0; // 写入交换文件的次数
+	long long Evictions = 0; // 淘汰次数
+	long long WorkingSetSamples = 0; // 工作集采样次数
+	long long WorkingSetTotal = 0; // 工作集大小之和（页）
+	long long WorkingSetPeak = 0; // 最大工作集（页）
+
+	// 创建交换文件和置换策略，Frames 为物理页框数，失败返回 0
+	bool Init(long long Frames);
+
+	// 关闭并删除交换文件
+	void Close();
+
+	// 为任务建立虚拟地址空间，所有页面都不在内存中
+	void CreateSpace(Task& task);
+
+	// 销毁任务的地址空间，归还页框和交换槽
+	void DestroySpace(Task& task);
+
+	// 任务执行一个时钟周期：按局部性访问若干页面，缺页时装入，并采样工作集
+	void Touch(Task& task);
+
+	// 访存模型的一次访问，调用者持有 Lock：计入引用和工作集，页面不在内存中时缺页装入。
+	// 返回页框号，没有页框可用时返回 -1
+	long long Reference(Task& task, long long Page);
+
+	// 缺页处理：取得页框（必要时淘汰），从交换文件读回，成功返回 1
+	bool Fault(Task& task, long long Page);
+
+	// 把被淘汰的页面写入交换文件
+	void SwapOut(uint64_t Key, PageTableEntry& Entry);
+
+	// 页面的键：地址空间编号和虚拟页号
+	static uint64_t KeyOf(uint32_t SpaceId, long long Page);
 };
 
 // 任务结构体
 struct Task
 {
-	string TaskId; // 任务 ID，便于输出
+	uint64_t Id = 0; // 任务编号：高 32 位为 CPU 编号，低 32 位为任务池中的序号
 	int TotalTime = 0; // 任务总需要时间（不变）
 	int RemainingTime = 0; // 剩余执行时间（动态更新）
 	long long Size = 0; // 任务需要的内存大小
 
 	long long Start = 0; // 任务分配的堆栈起始位置，也作为中断时的上下文保存点
 
+	long long AllocatedAt = -1; // 最近一次 New 的时间（虚拟时间模式下为虚拟时钟）
+	long long FreedAt = -1; // Free 的时间
+	long long LastTrapAt = -1; // 最近一次中断的时间
+	uint32_t TraceId = 0; // 当前分配在轨迹中的编号，未录制时为 0
+	uint32_t SpaceId = 0; // 请求调页时的地址空间编号，没有为 0
+	vector<PageTableEntry>PageTable; // 请求调页时的页表
+	long long StreamOffset = 0; // 访存模型中顺序扫描的当前位置
+	int Node = -1; // 内存所在的 NUMA 节点，未分配时为 -1
+	TaskClass Class = TaskClass::CpuBound; // 任务类型
+	long long FirstRunAt = -1; // 第一次执行的时间（任务都在时刻 0 到达，即响应时间）
+	long long CompletedAt = -1; // 完成的时间（即周转时间）
+	long long ReadySeq = 0; // 进入就绪队列的序号，同级先进先出
+	long long ReadySince = -1; // I/O 完成、重新就绪的时间
+	long long WakeAt = 0; // I/O 阻塞结束的时间
+	int Level = 0; // MLFQ 优先级，0 最高
+	int LevelTicks = 0; // 在当前优先级已执行的时钟周期，阻塞不清零
+	long long VirtualRuntime = 0; // 公平调度的虚拟运行时间
+
 	// 构造函数
-	Task(string s);
+	Task(int CPUNumber, int Index);
+
+	// 任务名称，输出时才格式化
+	string Name() const;
+
+	// 编号对应的任务名称
+	static string NameOf(uint64_t Id);
 
 	// 比较函数用于优先队列
 	bool operator<(const Task& other) const;
 
 };
 
+// slab：一次从全局内存批量申请的连续页面，切分成同一大小类的对象
+struct Slab
+{
+	long long Start = 0; // slab 起始地址，按 SLAB_SIZE 对齐
+	long long ObjectSize = 0; // 对象大小（大小类）
+	int LiveObjects = 0; // 已分配出去的对象数
+	long long NextUnused = 0; // 尚未切分过的下一个对象地址
+	vector<long long>FreeObjects; // 已释放、可复用的对象地址
+
+	// 是否已没有可分配的对象
+	bool IsFull() const;
+};
+
+// 每个 CPU 独占的小对象缓存，分配和释放不经过 MemoryLock
+struct SlabCache
+{
+	vector<long long>PartialSlabs[SLAB_SIZE_CLASS_COUNT]; // 每个大小类中尚有空闲对象的 slab 起始地址
+	unordered_map<long long, Slab>Slabs; // slab 起始地址到 slab 的映射
+	int HomeNode = -1; // 补充 slab 时优先使用的 NUMA 节点，-1 表示不限
+
+	// 分配一个不超过 SLAB_MAX_OBJECT_SIZE 的对象，失败返回 0
+	long long Allocate(long long Size);
+
+	// 判断地址是否属于本缓存的某个 slab
+	bool Owns(long long Start) const;
+
+	// 释放一个对象
+	void Free(long long Start);
+
+	// 把所有 slab 归还全局内存
+	void Release();
+};
+
 // CPU
 struct CPU
 {
 	int CPUNumber = 0; // 编号，从零开始
-	vector<Task>TaskPool; // 任务池
-	int TaskNumber = 0; // 当前正在执行的任务（从TaskPool）
+	vector<Task>TaskPool; // 任务存储，Init 之后不再增删，Task* 始终有效
+	vector<Task*>ReadyQueue; // 就绪队列：按调度策略排列的堆，堆顶是下一个要执行的任务
+	vector<Task*>Blocked; // 等待 I/O 的任务，只由本 CPU 访问
+	long long NextReadySeq = 0; // 下一个就绪序号，受 QueueLock 保护
+	Task* Current = nullptr; // 当前正在执行的任务，没有时为空
+	mutex QueueLock; // 就绪队列的锁，工作窃取时其他 CPU 也会访问
+	SlabCache Slabs; // 本 CPU 的小对象 slab 缓存
+	long long BusyTicks = 0; // 执行任务的时钟周期数
+	int StolenTasks = 0; // 从其他 CPU 窃取的任务数
+	MemoryHierarchy Caches; // 本 CPU 的 TLB 和缓存模型，只由本 CPU 访问
+	int HomeNode = 0; // 所在的 NUMA 节点
+	long long RemoteTicks = 0; // 执行内存在其他节点的任务的时钟周期数
+	long long StallPercent = 0; // 远程访问累计的额外开销（时钟周期的百分之一）
+	long long StallTicks = 0; // 因远程访问额外花费的时钟周期数
+	int SliceTicks = 0; // 当前任务这次被调度后已连续执行的时钟周期数
+	long long MinVruntime = 0; // 公平调度：已调度任务的虚拟运行时间下界
+	long long LastBoostAt = 0; // MLFQ 上次提升优先级的时间
+	long long Boosts = 0; // MLFQ 提升优先级的次数
+	long long IdleTicks = 0; // 所有任务都在等待 I/O 的空转时钟周期数
+	LatencyHistogram WakeLatencies; // I/O 完成到重新被调度的等待时间，定长直方图
+	vector<Task*>Retired; // 已完成、内存尚未释放的任务
+	vector<pair<long long, long long>>ReleaseBuffer; // 批量释放时收集的 (起始地址, 大小)，每批用完清空
+	long long FinishedAt = -1; // 工作结束的时间
 
 	// CPU 的初始化函数
 	bool Init();
 
+	// 任务放入就绪队列，O(log n)
+	void PushReady(Task* task);
+
+	// 取出按调度策略最优先的任务，O(log n)
+	Task* PopReady();
+
+	// 被窃取：从堆的叶子中取出一个尚未开始的任务，没有时返回 nullptr
+	Task* StealReady();
+
+	// 就绪任务数
+	size_t ReadyCount();
+
 	// 工作函数
 	void CPUWork();
+
+	// 开始工作
+	void BeginWork();
+
+	// 执行一个时钟周期，任务池已空时返回 0
+	bool Step();
+
+	// 当前任务是否应被时钟中断抢占（SJF 以外），MLFQ 在这里降级
+	bool SliceExpired();
+
+	// 把 I/O 已完成的任务放回就绪队列
+	void WakeBlocked();
+
+	// MLFQ：本 CPU 的所有任务提升到最高优先级
+	void BoostPriorities();
+
+	// 批量释放已完成任务的内存
+	void FreeRetired();
+
+	// 结束工作，归还 CPU 持有的资源
+	void EndWork();
+};
+
+// 虚拟时间事件：某个 CPU 在 Time 时刻执行它的下一个时钟周期
+struct Event
+{
+	long long Time = 0; // 虚拟时间
+	int CPUNumber = 0; // 事件所属 CPU
+
+	// 比较函数用于优先队列，时间早的先处理，同一时刻按 CPU 编号
+	bool operator<(const Event& other) const;
 };
 
 // 操作系统
 struct OS
 {
-	vector<CPU>CPUS; // CPU
+	deque<CPU>CPUS; // CPU，就地构造且地址不变
+	ScheduleMode Schedule = ScheduleMode::Static; // 调度模式
+	SchedulePolicy Policy = SchedulePolicy::Sjf; // 调度策略
+	int Quantum = RR_QUANTUM; // 轮转调度的时间片
+	vector<int>MlfqQuanta{ 1, 2, 4 }; // MLFQ 每级的时间片，级数即元素个数
+	int MlfqBoostPeriod = MLFQ_BOOST_PERIOD; // MLFQ 提升优先级的周期
+	int IoBoundPercent = 0; // I/O 密集型任务的百分比
 	Memory MEMORY; // 内存
-	mutex Output; // 输出函数的锁
+	Pager PAGER; // 请求调页
+	CacheModelMode CacheModel = CacheModelMode::Off; // 访存模型
+	AsyncLog Log; // 异步批量日志
+	bool SlabEnabled = true; // 是否启用每 CPU 的小对象 slab 缓存
+	bool BenchMemory = false; // 是否只运行内存分配基准测试
+	BenchOptions Bench; // 内存分配基准测试的参数
+	TraceWriter Recorder; // 分配轨迹录制
+	bool VirtualTime = false; // 是否使用离散事件虚拟时钟代替真实的 sleep
+	long long VirtualNow = 0; // 当前虚拟时间（时钟周期）
+	chrono::steady_clock::time_point StartTime; // 实时模式下的启动时刻
+	int TasksPerCPU = TASK_OF_EACH_CPU; // 每个 CPU 的任务数
+	NumaPolicy Numa = NumaPolicy::Local; // NUMA 分配策略
+	atomic<int> NextInterleaveNode{ 0 }; // 交错策略下一次分配的起始节点
+	atomic<long long> LocalAllocations{ 0 }; // 内存落在 CPU 所在节点的分配次数
+	atomic<long long> RemoteAllocations{ 0 }; // 内存落在其他节点的分配次数
+	bool PinThreads = false; // 实时模式下是否把 CPU 线程绑定到主机核
+	bool CompactEnabled = false; // 分配失败时是否先整理内存再重试
+	atomic<long long> CompactionRuns{ 0 }; // 内存整理次数
+	atomic<long long> CompactedBytes{ 0 }; // 整理时搬移的字节数
+	atomic<long long> RescuedAllocations{ 0 }; // 整理后重试成功的分配次数
+
+	// 解析命令行参数，参数非法时输出用法并返回 0
+	bool Configure(int argc, char* argv[]);
 
 	// OS 的初始化函数
 	bool Init();
@@ -91,18 +488,46 @@ struct OS
 	// 启动函数
 	void Run();
 
+	// 虚拟时间模式的启动函数，在单个线程中按事件时间顺序推进所有 CPU
+	void RunVirtual();
+
+	// 当前时间：虚拟时间模式下为虚拟时钟，否则为启动以来的秒数
+	long long Now();
+
+	// 为空闲的 CPU 从就绪任务最多的其他 CPU 窃取一个任务，没有可窃取的任务时返回 nullptr
+	Task* Steal(CPU& thief);
+
+	// 输出完成时间（makespan）和每个 CPU 的利用率
+	void Report();
+
 	// 中断函数
 	void Trap(CPU& cpu);
 
+	// 访存模型：当前任务在一个时钟周期内产生一串访问，经 TLB 和缓存累计模拟的周期数
+	void SimulateAccesses(CPU& cpu);
+
+	// TLB 击落：通知所有 CPU 的 TLB 模型，FirstKey 起的 Count 个键映射的页已失效（淘汰或搬移）
+	void ShootdownTlb(uint64_t FirstKey, uint64_t Count);
+
 	// 申请内存，输入为CPU，成功返回 1。
 	bool New(CPU& cpu);
 
-	// 释放内存，输入为CPU，成功返回 1。
-	bool Free(CPU& cpu);
+	// 内存整理后为任务重新分配，成功返回起始地址，失败返回 0。
+	// 整理期间持有内存锁和所有 CPU 的就绪队列锁，只搬移在就绪队列中等待的任务的页段；重新分配时优先 PreferredNode 节点
+	long long Compact(Task& task, int PreferredNode = -1);
+
+	// 批量释放多个任务的内存，输入为CPU及其已完成的任务，成功返回 1。
+	bool Free(CPU& cpu, const vector<Task*>& Tasks);
 
-	// 输出函数
+	// 输出函数，Info 级别
 	void Print(string& Text);
 
+	// 按级别输出
+	void Print(LogLevel Level, string& Text);
+
+	// 按级别输出 CPU 当前任务的结构化事件，不拼接字符串
+	void Print(LogLevel Level, LogEventKind Kind, CPU& cpu, long long First = 0, long long Second = 0);
+
 };
 
 OS os; // 全局操作系统实例
\ No newline at end of file
@@ -0,0 +1,34 @@
+﻿#pragma once
+
+#include <sched.h>
+#include <pthread.h>
+
+using namespace std;
+
+// 把当前线程绑定到本进程允许使用的第 Index 个主机核（Index 超过核数时取模），成功返回 1。
+// 可用核从进程当前的亲和性掩码中取，因此在 taskset、cgroup 限制下也只会绑定到允许的核上
+inline bool PinCurrentThread(int Index) {
+	cpu_set_t Allowed;
+	CPU_ZERO(&Allowed);
+	if (sched_getaffinity(0, sizeof(Allowed), &Allowed) != 0) {
+		return 0;
+	}
+	int Count = CPU_COUNT(&Allowed);
+	if (Count == 0) {
+		return 0;
+	}
+
+	// 找到第 Index % Count 个允许的核
+	int Target = Index % Count;
+	int Core = 0;
+	for (; Core < CPU_SETSIZE; Core++) {
+		if (CPU_ISSET(Core, &Allowed) && Target-- == 0) {
+			break;
+		}
+	}
+
+	cpu_set_t Single;
+	CPU_ZERO(&Single);
+	CPU_SET(Core, &Single);
+	return pthread_setaffinity_np(pthread_self(), sizeof(Single), &Single) == 0;
+}
@@ -0,0 +1,478 @@
+﻿#pragma once
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <random>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+#include <functional>
+#include <mutex>
+
+#include "AllocTrace.h"
+#include "Affinity.h"
+#include <unordered_map>
+
+using namespace std;
+
+#define BENCH_DEFAULT_SEED 20250101 // 默认随机种子
+#define BENCH_DEFAULT_OPS 200000 // 默认每线程操作数
+#define BENCH_LIVE_LIMIT 256 // 每线程最多同时存活的块数
+#define BENCH_SAMPLE_US 1000 // 占用采样间隔（微秒）
+#define BENCH_SAMPLE_OPS 1024 // 每个测试线程每执行这么多次操作额外采样一次占用
+#define BENCH_LARGE_BYTES 1048576 // 不小于这个大小的请求单独统计失败次数（字节）
+
+// 请求大小的分布
+enum class BenchDistribution
+{
+	Mix, // 任务的原始分布：60% 为 1-128 字节，35% 为 4KB，5% 为 4KB-16MB
+	Uniform, // [UniformMin, UniformMax] 内均匀分布
+	Trace // 回放 AllocTrace 格式的轨迹文件，记录按线程编号分给各个测试线程
+};
+
+// 基准测试参数，由 --bench-* 命令行参数设置
+struct BenchOptions
+{
+	BenchDistribution Distribution = BenchDistribution::Mix; // 大小分布
+	uint64_t Seed = BENCH_DEFAULT_SEED; // 随机种子，线程 t 使用 Seed + t
+	long long OpsPerThread = BENCH_DEFAULT_OPS; // 每线程操作数（分配和释放各算一次，轨迹模式不用）
+	int MaxThreads = 8; // 线程数从 1 扫描到 MaxThreads
+	long long UniformMin = 16; // 均匀分布下限（字节）
+	long long UniformMax = 65536; // 均匀分布上限（字节）
+	string TracePath; // 轨迹文件（由各实验的 --record 录制）
+	long long CapacityMB = 0; // 被测内存容量（MB），0 表示使用各实验的最大内存容量
+	bool Pin = false; // 是否把测试线程 t 绑定到第 t 个主机核
+
+	// 解析一个 --bench-* 参数，不认识的参数返回 0
+	bool Parse(const string& Argument) {
+		if (Argument == "--bench-dist=mix") {
+			Distribution = BenchDistribution::Mix;
+		}
+		else if (Argument == "--bench-dist=uniform") {
+			Distribution = BenchDistribution::Uniform;
+		}
+		else if (Argument.rfind("--bench-trace=", 0) == 0) {
+			Distribution = BenchDistribution::Trace;
+			TracePath = Argument.substr(14);
+		}
+		else if (Argument.rfind("--bench-seed=", 0) == 0) {
+			Seed = strtoull(Argument.c_str() + 13, nullptr, 10);
+		}
+		else if (Argument.rfind("--bench-ops=", 0) == 0 && atoll(Argument.c_str() + 12) > 0) {
+			OpsPerThread = atoll(Argument.c_str() + 12);
+		}
+		else if (Argument.rfind("--bench-threads=", 0) == 0 && atoi(Argument.c_str() + 16) > 0) {
+			MaxThreads = atoi(Argument.c_str() + 16);
+		}
+		else if (Argument.rfind("--bench-min=", 0) == 0 && atoll(Argument.c_str() + 12) > 0) {
+			UniformMin = atoll(Argument.c_str() + 12);
+		}
+		else if (Argument.rfind("--bench-max=", 0) == 0 && atoll(Argument.c_str() + 12) > 0) {
+			UniformMax = atoll(Argument.c_str() + 12);
+		}
+		else if (Argument.rfind("--bench-capacity=", 0) == 0 && atoll(Argument.c_str() + 17) > 0) {
+			CapacityMB = atoll(Argument.c_str() + 17);
+		}
+		else if (Argument == "--bench-pin") {
+			Pin = true;
+		}
+		else {
+			return 0;
+		}
+		return 1;
+	}
+
+	// 参数说明，附在各实验的使用方法后面
+	static const char* Usage() {
+		return " [--bench-dist=mix|uniform] [--bench-trace=FILE] [--bench-seed=N] [--bench-ops=N]"
+			" [--bench-threads=N] [--bench-min=BYTES] [--bench-max=BYTES] [--bench-capacity=MB] [--bench-pin]";
+	}
+};
+
+// 被测分配器的适配器，每个实验把自己的分配器包装成这个接口
+class BenchAllocator
+{
+public:
+	virtual ~BenchAllocator() {}
+
+	// 名称，用于输出
+	virtual string Name() const = 0;
+
+	// 恢复到全部空闲的初始状态，每轮开始前在主线程调用
+	virtual void Reset() = 0;
+
+	// 分配 Size 字节，返回非 0 的句柄，失败返回 0；多个线程并发调用
+	virtual long long Allocate(long long Size) = 0;
+
+	// 释放 Allocate 返回的句柄，由分配它的线程调用
+	virtual void Release(long long Handle, long long Size) = 0;
+
+	// 工作线程退出前调用，归还线程本地缓存
+	virtual void ThreadExit() {}
+
+	// 分配器当前从底层内存占用的字节数（含对齐、取整和缓存），可与分配并发调用
+	virtual long long FootprintBytes() = 0;
+};
+
+// 一轮测试的结果
+struct BenchResult
+{
+	int Threads = 0; // 线程数
+	long long Ops = 0; // 总操作数
+	double Seconds = 0; // 耗时
+	long long P50 = 0; // 单次操作延迟的 50/99/99.9 百分位（纳秒）
+	long long P99 = 0;
+	long long P999 = 0;
+	long long PeakFootprint = 0; // 采样到的最大占用（字节）
+	long long PeakRequested = 0; // 采样到的存活块请求总字节数的最大值
+	long long Failures = 0; // 分配失败次数
+	long long LargeFailures = 0; // 其中不小于 BENCH_LARGE_BYTES 的请求的失败次数
+};
+
+// 一个测试线程的分配失败计数
+struct BenchFailures
+{
+	long long All = 0; // 失败次数
+	long long Large = 0; // 其中不小于 BENCH_LARGE_BYTES 的请求
+};
+
+// 延迟直方图：64 ns 以下每纳秒一个桶，以上每个 2 的幂区间分 32 个桶，相对误差不超过 1/32。
+// 大小固定，回放上亿条记录的轨迹时也不需要保存每次操作的延迟
+struct LatencyHistogram
+{
+	static const int BucketCount = 64 + 26 * 32; // 覆盖 uint32_t 全部取值
+
+	uint64_t Counts[BucketCount] = {}; // 每个桶的次数
+	uint64_t Total = 0; // 总次数
+	uint64_t Sum = 0; // 所有取值之和，用于平均值
+	uint32_t Max = 0; // 最大值
+
+	void Add(uint32_t Nanoseconds) {
+		Counts[Index(Nanoseconds)]++;
+		Total++;
+		Sum += Nanoseconds;
+		Max = max(Max, Nanoseconds);
+	}
+
+	void Merge(const LatencyHistogram& Other) {
+		for (int i = 0; i < BucketCount; i++) {
+			Counts[i] += Other.Counts[i];
+		}
+		Total += Other.Total;
+		Sum += Other.Sum;
+		Max = max(Max, Other.Max);
+	}
+
+	// 百分位对应桶的下界（纳秒）
+	long long Percentile(double Rank) const {
+		uint64_t Target = max<uint64_t>(1, (uint64_t)(Rank * Total + 0.999999));
+		uint64_t Seen = 0;
+		for (int i = 0; i < BucketCount; i++) {
+			Seen += Counts[i];
+			if (Seen >= Target) {
+				return LowerBound(i);
+			}
+		}
+		return 0;
+	}
+
+	static int Index(uint32_t Value) {
+		if (Value < 64) {
+			return Value;
+		}
+		int Exponent = 31 - __builtin_clz(Value);
+		return 64 + (Exponent - 6) * 32 + (int)((Value >> (Exponent - 5)) & 31);
+	}
+
+	static long long LowerBound(int Bucket) {
+		if (Bucket < 64) {
+			return Bucket;
+		}
+		int Exponent = (Bucket - 64) / 32 + 6;
+		int Mantissa = (Bucket - 64) % 32;
+		return (1LL << Exponent) + ((long long)Mantissa << (Exponent - 5));
+	}
+};
+
+// 分配器基准测试
+// 每个线程用固定种子生成操作序列：存活块少于 BENCH_LIVE_LIMIT 时以 1/2 概率分配，否则释放一个随机存活块。
+// 轨迹模式下计时前先把记录按测试线程划分一次：分配按线程编号取模，释放跟随对应的分配，
+// 每个测试线程只按顺序回放自己的记录，回放的代价不随线程数增长。
+// 每次操作单独计时得到延迟分布；后台线程定时采样分配器占用和存活请求量，
+// 碎片率 = 峰值占用 / 存活块请求字节数的峰值，反映取整、对齐和缓存带来的额外占用。
+class AllocBench
+{
+public:
+	explicit AllocBench(const BenchOptions& Options) : Options(Options) {}
+
+	// 对一个分配器从 1 到 MaxThreads 个线程逐轮测试并输出结果，轨迹读取失败返回 0
+	bool Run(BenchAllocator& Allocator) {
+		if (Options.Distribution == BenchDistribution::Trace && !Trace.IsOpen() && !Trace.Open(Options.TracePath)) {
+			cout << "无法读取轨迹文件：" << Options.TracePath << endl;
+			return 0;
+		}
+		if (Options.Distribution == BenchDistribution::Trace && Trace.Count() > UINT32_MAX) {
+			cout << "轨迹记录超过 " << UINT32_MAX << " 条，无法划分：" << Options.TracePath << endl;
+			return 0;
+		}
+
+		cout << "分配器：" << Allocator.Name() << "，分布：" << DistributionName();
+		if (Options.Distribution == BenchDistribution::Trace) {
+			cout << "，轨迹 " << Trace.Count() << " 条记录" << endl;
+		}
+		else {
+			cout << "，种子：" << Options.Seed << "，每线程 " << Options.OpsPerThread << " 次操作" << endl;
+		}
+		cout << "线程\t百万次/秒\tp50(ns)\tp99(ns)\tp999(ns)\t峰值占用(MB)\t碎片率\t失败\t大块失败" << endl;
+
+		for (int Threads = 1; Threads <= Options.MaxThreads; Threads++) {
+			BenchResult Result = RunOnce(Allocator, Threads);
+			double Fragmentation = Result.PeakRequested > 0 ?
+				(double)Result.PeakFootprint / Result.PeakRequested : 0;
+			cout << Result.Threads << "\t" << to_string(Result.Ops / Result.Seconds / 1e6) << "\t"
+				<< Result.P50 << "\t" << Result.P99 << "\t" << Result.P999 << "\t"
+				<< to_string(Result.PeakFootprint / 1048576.0) << "\t" << to_string(Fragmentation) << "\t"
+				<< Result.Failures << "\t" << Result.LargeFailures << endl;
+		}
+		return 1;
+	}
+
+private:
+	// 每个线程的存活请求量，按缓存行对齐避免伪共享
+	struct alignas(64) LiveCounter
+	{
+		atomic<long long> Bytes{ 0 };
+	};
+
+	BenchOptions Options; // 参数
+	TraceReader Trace; // 轨迹
+
+	const char* DistributionName() const {
+		switch (Options.Distribution) {
+		case BenchDistribution::Mix:
+			return "mix";
+		case BenchDistribution::Uniform:
+			return "uniform";
+		default:
+			return "trace";
+		}
+	}
+
+	// 按分布生成一个请求大小
+	long long NextSize(mt19937_64& Gen) const {
+		if (Options.Distribution == BenchDistribution::Uniform) {
+			uniform_int_distribution<long long> Dist(Options.UniformMin, max(Options.UniformMin, Options.UniformMax));
+			return Dist(Gen);
+		}
+		long long RandType = (long long)(Gen() % 100) + 1;
+		if (RandType <= 60) {
+			return (long long)(Gen() % 128) + 1;
+		}
+		else if (RandType <= 95) {
+			return 4LL * 1024;
+		}
+		else {
+			return (long long)(Gen() % (16LL * 1024 * 1024 - 4 * 1024 + 1)) + 4LL * 1024;
+		}
+	}
+
+	// 一轮测试
+	BenchResult RunOnce(BenchAllocator& Allocator, int Threads) {
+		Allocator.Reset();
+
+		vector<LatencyHistogram> Latencies(Threads);
+		vector<BenchFailures> Failures(Threads);
+		unique_ptr<LiveCounter[]> Live(new LiveCounter[Threads]);
+		atomic<bool> Done{ false };
+
+		BenchResult Result;
+		Result.Threads = Threads;
+
+		// 轨迹在计时之前划分好
+		vector<vector<uint32_t>> Parts;
+		if (Options.Distribution == BenchDistribution::Trace) {
+			Parts = PartitionTrace(Threads);
+		}
+
+		// 采样一次占用，记录最大值；工作线程在释放剩余块之前也各采样一次，避免短测试漏掉峰值
+		mutex SampleLock;
+		function<void()> Sample = [&]() {
+			lock_guard<mutex> Guard(SampleLock);
+			long long Requested = 0;
+			for (int t = 0; t < Threads; t++) {
+				Requested += Live[t].Bytes.load(memory_order_relaxed);
+			}
+			Result.PeakFootprint = max(Result.PeakFootprint, Allocator.FootprintBytes());
+			Result.PeakRequested = max(Result.PeakRequested, Requested);
+		};
+
+		// 占用采样线程
+		thread Sampler([&]() {
+			while (true) {
+				bool Last = Done.load(memory_order_acquire);
+				Sample();
+				if (Last) {
+					break;
+				}
+				this_thread::sleep_for(chrono::microseconds(BENCH_SAMPLE_US));
+			}
+		});
+
+		auto Begin = chrono::steady_clock::now();
+		vector<thread> Workers;
+		for (int t = 0; t < Threads; t++) {
+			Workers.push_back(thread([&, t]() {
+				if (Options.Pin) {
+					PinCurrentThread(t); // 固定在一个核上，结果反映真实的缓存局部性
+				}
+				if (Options.Distribution == BenchDistribution::Trace) {
+					ReplayTrace(Allocator, Parts[t], Latencies[t], Failures[t], Live[t].Bytes, Sample);
+				}
+				else {
+					RunRandom(Allocator, Options.Seed + t, Latencies[t], Failures[t], Live[t].Bytes, Sample);
+				}
+				Allocator.ThreadExit();
+			}));
+		}
+		for (auto& Worker : Workers) {
+			Worker.join();
+		}
+		Result.Seconds = chrono::duration<double>(chrono::steady_clock::now() - Begin).count();
+		Done.store(true, memory_order_release);
+		Sampler.join();
+
+		// 合并延迟并取百分位
+		LatencyHistogram All;
+		for (auto& Histogram : Latencies) {
+			All.Merge(Histogram);
+		}
+		for (auto& Count : Failures) {
+			Result.Failures += Count.All;
+			Result.LargeFailures += Count.Large;
+		}
+		Result.Ops = (long long)All.Total;
+		Result.P50 = All.Percentile(0.5);
+		Result.P99 = All.Percentile(0.99);
+		Result.P999 = All.Percentile(0.999);
+		return Result;
+	}
+
+	// 计时执行一次分配。存活请求量在分配前增加、释放后减少，采样时请求量不会落后于占用
+	static long long TimedAllocate(BenchAllocator& Allocator, long long Size, LatencyHistogram& Latency,
+		BenchFailures& Failures, atomic<long long>& LiveBytes) {
+		LiveBytes.store(LiveBytes.load(memory_order_relaxed) + Size, memory_order_relaxed);
+		auto Begin = chrono::steady_clock::now();
+		long long Handle = Allocator.Allocate(Size);
+		Latency.Add(Elapsed(Begin));
+		if (Handle == 0) {
+			Failures.All++;
+			if (Size >= BENCH_LARGE_BYTES) {
+				Failures.Large++;
+			}
+			LiveBytes.store(LiveBytes.load(memory_order_relaxed) - Size, memory_order_relaxed);
+		}
+		return Handle;
+	}
+
+	// 计时执行一次释放
+	static void TimedRelease(BenchAllocator& Allocator, long long Handle, long long Size, LatencyHistogram& Latency,
+		atomic<long long>& LiveBytes) {
+		auto Begin = chrono::steady_clock::now();
+		Allocator.Release(Handle, Size);
+		Latency.Add(Elapsed(Begin));
+		LiveBytes.store(LiveBytes.load(memory_order_relaxed) - Size, memory_order_relaxed);
+	}
+
+	// 随机分布的操作序列
+	void RunRandom(BenchAllocator& Allocator, uint64_t Seed, LatencyHistogram& Latency, BenchFailures& Failures,
+		atomic<long long>& LiveBytes, const function<void()>& Sample) const {
+		mt19937_64 Gen(Seed);
+		vector<pair<long long, long long>> Blocks; // 存活块：句柄和大小
+		for (long long i = 0; i < Options.OpsPerThread; i++) {
+			if (Blocks.empty() || (Blocks.size() < BENCH_LIVE_LIMIT && Gen() % 2 == 0)) {
+				long long Size = NextSize(Gen);
+				long long Handle = TimedAllocate(Allocator, Size, Latency, Failures, LiveBytes);
+				if (Handle != 0) {
+					Blocks.push_back({ Handle, Size });
+				}
+				if (i % BENCH_SAMPLE_OPS == 0) {
+					Sample();
+				}
+			}
+			else {
+				size_t Victim = Gen() % Blocks.size();
+				TimedRelease(Allocator, Blocks[Victim].first, Blocks[Victim].second, Latency, LiveBytes);
+				Blocks[Victim] = Blocks.back();
+				Blocks.pop_back();
+			}
+		}
+		Sample();
+		for (auto& Block : Blocks) {
+			TimedRelease(Allocator, Block.first, Block.second, Latency, LiveBytes);
+		}
+	}
+
+	// 把轨迹记录的下标分给 Threads 个测试线程：分配按记录的线程编号取模，释放分给分配了该块的测试线程，
+	// 没有对应分配的释放丢弃。各部分保持轨迹中的顺序
+	vector<vector<uint32_t>> PartitionTrace(int Threads) const {
+		vector<vector<uint32_t>> Parts(Threads);
+		unordered_map<uint32_t, int> Owners; // 存活的分配编号到测试线程
+		uint64_t Count = Trace.Count();
+		for (uint64_t i = 0; i < Count; i++) {
+			const TraceRecord& Record = Trace.At(i);
+			if (Record.Type() == TraceEvent::Allocate) {
+				int Worker = (int)(Record.Thread() % Threads);
+				Owners[Record.Id] = Worker;
+				Parts[Worker].push_back((uint32_t)i);
+			}
+			else if (Record.Type() == TraceEvent::Free) {
+				auto Found = Owners.find(Record.Id);
+				if (Found != Owners.end()) {
+					Parts[Found->second].push_back((uint32_t)i);
+					Owners.erase(Found);
+				}
+			}
+		}
+		return Parts;
+	}
+
+	// 回放分给本线程的轨迹记录，结束时释放轨迹中没有释放的块
+	void ReplayTrace(BenchAllocator& Allocator, const vector<uint32_t>& Indices, LatencyHistogram& Latency,
+		BenchFailures& Failures, atomic<long long>& LiveBytes, const function<void()>& Sample) const {
+		unordered_map<uint32_t, pair<long long, long long>> Blocks; // 分配编号到句柄和大小
+		long long Ops = 0;
+		for (uint32_t i : Indices) {
+			const TraceRecord& Record = Trace.At(i);
+			if (Record.Type() == TraceEvent::Allocate) {
+				long long Handle = TimedAllocate(Allocator, Record.Size, Latency, Failures, LiveBytes);
+				if (Handle != 0) {
+					Blocks[Record.Id] = { Handle, Record.Size };
+				}
+				if (Ops++ % BENCH_SAMPLE_OPS == 0) {
+					Sample();
+				}
+			}
+			else if (Record.Type() == TraceEvent::Free) {
+				auto Found = Blocks.find(Record.Id);
+				if (Found != Blocks.end()) {
+					TimedRelease(Allocator, Found->second.first, Found->second.second, Latency, LiveBytes);
+					Blocks.erase(Found);
+				}
+			}
+		}
+		Sample();
+		for (auto& Block : Blocks) {
+			TimedRelease(Allocator, Block.second.first, Block.second.second, Latency, LiveBytes);
+		}
+	}
+
+	static uint32_t Elapsed(chrono::steady_clock::time_point Begin) {
+		long long Nanoseconds = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - Begin).count();
+		return (uint32_t)min(Nanoseconds, (long long)UINT32_MAX);
+	}
+};
@@ -0,0 +1,209 @@
+﻿#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+#define TRACE_MAGIC "YUTRACE1" // 轨迹文件头的魔数（8 字节）
+#define TRACE_BUFFER_RECORDS 4096 // 写轨迹时每批写入文件的记录数
+
+// 轨迹事件类型
+enum class TraceEvent : uint8_t
+{
+	Allocate = 1, // 分配成功，Size 为请求的字节数
+	Free = 2, // 释放，Id 引用之前的分配
+	Trap = 3 // 中断，Id 为被中断任务当前分配的编号（没有时为 0）
+};
+
+// 一条 16 字节的轨迹记录（小端）
+// 第一个字：高 48 位为时间戳（虚拟时间或毫秒），中间 8 位为线程（CPU）编号，低 8 位为事件类型
+struct TraceRecord
+{
+	uint64_t Word = 0; // 时间戳、线程、类型
+	uint32_t Id = 0; // 分配编号，从 1 开始，在一个轨迹内唯一
+	uint32_t Size = 0; // 分配大小（字节）
+
+	uint64_t Time() const {
+		return Word >> 16;
+	}
+
+	uint32_t Thread() const {
+		return (uint32_t)(Word >> 8) & 0xFF;
+	}
+
+	TraceEvent Type() const {
+		return (TraceEvent)(Word & 0xFF);
+	}
+};
+
+static_assert(sizeof(TraceRecord) == 16, "TraceRecord 必须是 16 字节");
+
+// 文件头，之后紧跟若干条记录，记录数由文件大小得出
+struct TraceHeader
+{
+	char Magic[8]; // TRACE_MAGIC
+	uint32_t Version; // 格式版本，当前为 1
+	uint32_t RecordSize; // sizeof(TraceRecord)
+};
+
+// 轨迹写入器：多个线程可同时记录，记录先进缓冲区，满一批后加锁写入文件
+class TraceWriter
+{
+public:
+	~TraceWriter() {
+		Close();
+	}
+
+	// 创建轨迹文件并写入文件头，失败返回 0
+	bool Open(const string& Path) {
+		File = fopen(Path.c_str(), "wb");
+		if (File == nullptr) {
+			return 0;
+		}
+		TraceHeader Header;
+		memcpy(Header.Magic, TRACE_MAGIC, 8);
+		Header.Version = 1;
+		Header.RecordSize = sizeof(TraceRecord);
+		fwrite(&Header, sizeof(Header), 1, File);
+		Buffer.reserve(TRACE_BUFFER_RECORDS);
+		return 1;
+	}
+
+	// 是否正在记录
+	bool IsOpen() const {
+		return File != nullptr;
+	}
+
+	// 为一次分配取得新的编号
+	uint32_t NextId() {
+		return LastId.fetch_add(1, memory_order_relaxed) + 1;
+	}
+
+	// 记录一个事件
+	void Record(TraceEvent Type, uint64_t Time, uint32_t Thread, uint32_t Id, uint32_t Size) {
+		TraceRecord Entry;
+		Entry.Word = (Time << 16) | ((uint64_t)(Thread & 0xFF) << 8) | (uint64_t)Type;
+		Entry.Id = Id;
+		Entry.Size = Size;
+
+		lock_guard<mutex> Guard(Lock);
+		if (File == nullptr) {
+			return;
+		}
+		Buffer.push_back(Entry);
+		if (Buffer.size() >= TRACE_BUFFER_RECORDS) {
+			FlushLocked();
+		}
+	}
+
+	// 写出剩余记录并关闭文件
+	void Close() {
+		lock_guard<mutex> Guard(Lock);
+		if (File == nullptr) {
+			return;
+		}
+		FlushLocked();
+		fclose(File);
+		File = nullptr;
+	}
+
+private:
+	FILE* File = nullptr; // 轨迹文件
+	mutex Lock; // 保护 Buffer 和 File
+	vector<TraceRecord> Buffer; // 尚未写入文件的记录
+	atomic<uint32_t> LastId{ 0 }; // 最后分出的分配编号
+
+	void FlushLocked() {
+		if (!Buffer.empty()) {
+			fwrite(Buffer.data(), sizeof(TraceRecord), Buffer.size(), File);
+			Buffer.clear();
+		}
+	}
+};
+
+// 轨迹读取器：把整个文件映射到内存，按顺序访问时由内核预读并回收已读过的页面，
+// 因此上亿条记录的轨迹也不需要全部装入内存
+class TraceReader
+{
+public:
+	TraceReader() = default;
+	TraceReader(const TraceReader&) = delete;
+	TraceReader& operator=(const TraceReader&) = delete;
+
+	~TraceReader() {
+		Close();
+	}
+
+	// 打开并校验轨迹文件，失败返回 0
+	bool Open(const string& Path) {
+		Close();
+		int Descriptor = open(Path.c_str(), O_RDONLY);
+		if (Descriptor < 0) {
+			return 0;
+		}
+		struct stat Info;
+		if (fstat(Descriptor, &Info) != 0 || (size_t)Info.st_size < sizeof(TraceHeader)) {
+			close(Descriptor);
+			return 0;
+		}
+		void* Address = mmap(nullptr, Info.st_size, PROT_READ, MAP_PRIVATE, Descriptor, 0);
+		close(Descriptor); // 映射建立后不再需要文件描述符
+		if (Address == MAP_FAILED) {
+			return 0;
+		}
+		Mapping = (const char*)Address;
+		MappingBytes = Info.st_size;
+
+		const TraceHeader* Header = (const TraceHeader*)Mapping;
+		if (memcmp(Header->Magic, TRACE_MAGIC, 8) != 0 || Header->RecordSize != sizeof(TraceRecord)) {
+			Close();
+			return 0;
+		}
+		madvise(Address, MappingBytes, MADV_SEQUENTIAL);
+		Records = (const TraceRecord*)(Mapping + sizeof(TraceHeader));
+		RecordCount = (MappingBytes - sizeof(TraceHeader)) / sizeof(TraceRecord);
+		return 1;
+	}
+
+	// 是否已打开
+	bool IsOpen() const {
+		return Mapping != nullptr;
+	}
+
+	// 记录数
+	uint64_t Count() const {
+		return RecordCount;
+	}
+
+	// 第 Index 条记录
+	const TraceRecord& At(uint64_t Index) const {
+		return Records[Index];
+	}
+
+	// 解除映射
+	void Close() {
+		if (Mapping != nullptr) {
+			munmap((void*)Mapping, MappingBytes);
+			Mapping = nullptr;
+			Records = nullptr;
+			MappingBytes = 0;
+			RecordCount = 0;
+		}
+	}
+
+private:
+	const char* Mapping = nullptr; // 映射的起始地址
+	size_t MappingBytes = 0; // 映射的字节数
+	const TraceRecord* Records = nullptr; // 第一条记录
+	uint64_t RecordCount = 0; // 记录数
+};
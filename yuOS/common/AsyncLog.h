@@ -0,0 +1,427 @@
+﻿#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+#include <sys/uio.h>
+#include <unistd.h>
+
+using namespace std;
+
+#define LOG_RING_BYTES 65536 // 每个线程的日志环形缓冲区大小（字节）
+#define LOG_MAX_IOVECS 256 // 一次 writev 最多提交的缓冲区段数
+#define LOG_DRAIN_IDLE_US 500 // 后台线程没有日志可输出时的休眠时间（微秒）
+#define LOG_EVENT_MARKER '\0' // 文本模式下结构化记录的起始字节，文本行中不会出现
+
+// 日志级别，低于当前级别的日志在写入前就被丢弃
+enum class LogLevel
+{
+	Debug, // 每个时钟周期的细节：选择任务、分配地址、中断、完成和窃取任务
+	Info, // 初始化、开始和结束工作
+	Warn, // 分配失败等异常情况
+	Report, // 运行结束时的统计报告，只有 off 时才不输出
+	Off // 不输出任何日志
+};
+
+// 日志输出方式
+enum class LogMode
+{
+	Sync, // 每行加锁后直接写 cout 并刷新（原来的做法）
+	Text, // 写入本线程的环形缓冲区，由后台线程用 writev 批量输出文本行
+	Binary // 同 Text，但每条记录是定长头部加消息字节的紧凑格式
+};
+
+// 结构化日志记录：写日志的线程只填几个整数，不拼接字符串，输出时才由 Formatter 格式化成文本
+// 各字段的含义由使用者按 Kind 约定
+struct LogEvent
+{
+	int64_t Time = -1; // 事件时间（如虚拟时钟），没有为 -1
+	uint64_t Subject = 0; // 事件涉及的对象（如任务编号）
+	int64_t Values[2] = { 0, 0 }; // 事件参数
+	uint32_t Kind = 0; // 事件类型
+	int32_t Source = 0; // 事件来源（如 CPU 编号）
+};
+
+// 把一条结构化记录格式化成一行文本（不含换行），追加到 Out
+typedef void (*LogFormatter)(const LogEvent& Event, string& Out);
+
+// 二进制模式的记录头，其后紧跟 Length 字节的消息（不含换行）
+struct LogRecordHeader
+{
+	uint64_t Time; // 自日志启动以来的纳秒数
+	uint32_t Length; // 消息字节数
+	uint16_t Thread; // 写日志线程的编号，按首次写日志的顺序从 0 开始
+	uint8_t Level; // LogLevel
+	uint8_t Format; // 0：消息是文本；1：消息是一个 LogEvent，读取时再格式化
+};
+
+// 单生产者单消费者字节环：生产者是写日志的线程，消费者是后台输出线程。
+// Head、Tail 是累计字节数，只增不减，取模得到缓冲区内的位置。
+struct LogRing
+{
+	alignas(64) atomic<uint64_t> Head{ 0 }; // 已写入的字节数，只由生产者更新
+	alignas(64) atomic<uint64_t> Tail{ 0 }; // 已输出的字节数，只由消费者更新
+	uint16_t Thread = 0; // 所属线程编号
+	thread::id Owner; // 所属线程，线程在同一个日志实例上再次查找缓冲区时用
+	char Buffer[LOG_RING_BYTES]; // 数据
+};
+
+// 异步批量日志
+// 写日志的线程只把整条记录拷贝进自己的环形缓冲区，不加锁、不做系统调用；
+// 后台线程轮询所有缓冲区，把可输出的区段收集成 iovec，一次 writev 写到标准输出。
+// 每条记录在完整写入后才对消费者可见，所以不同线程的行不会互相截断；
+// 同一线程的日志保持顺序，不同线程之间只保证大致的时间顺序（二进制模式带时间戳）。
+// 结构化记录（LogEvent）按原样进入缓冲区：文本模式下由后台线程调用 Formatter 格式化，
+// 二进制模式下不格式化，Sync 模式下立即格式化输出，因此写日志的一方不需要分配内存。
+class AsyncLog
+{
+public:
+	LogLevel Level = LogLevel::Debug; // 输出级别
+	LogMode Mode = LogMode::Text; // 输出方式，须在第一次写日志前设置
+	LogFormatter Formatter = nullptr; // 结构化记录的格式化函数，须在第一次写结构化记录前设置
+
+	AsyncLog() : StartTime(chrono::steady_clock::now()), Id(NewId()) {}
+
+	~AsyncLog() {
+		Stop();
+	}
+
+	// 该级别的日志是否会被输出，调用者可据此跳过拼接字符串
+	bool Enabled(LogLevel L) const {
+		return L >= Level;
+	}
+
+	// 写一条日志
+	void Write(LogLevel L, const string& Text) {
+		if (!Enabled(L)) {
+			return;
+		}
+		if (Mode == LogMode::Sync) {
+			lock_guard<mutex> Guard(SyncLock);
+			cout << Text << endl;
+			return;
+		}
+
+		// 单条记录最多占半个缓冲区，过长的消息被截断
+		size_t Overhead = Mode == LogMode::Binary ? sizeof(LogRecordHeader) : 1;
+		size_t Length = min(Text.size(), (size_t)LOG_RING_BYTES / 2 - Overhead);
+		Append(L, 0, Text.data(), Length, "\n");
+	}
+
+	// 写一条结构化记录
+	void Write(LogLevel L, const LogEvent& Event) {
+		if (!Enabled(L)) {
+			return;
+		}
+		if (Mode == LogMode::Sync) {
+			string Text;
+			Format(Event, Text);
+			lock_guard<mutex> Guard(SyncLock);
+			cout << Text << endl;
+			return;
+		}
+		Append(L, 1, &Event, sizeof(Event), nullptr);
+	}
+
+	// 等待已写入的日志全部输出
+	void Flush() {
+		for (LogRing* Ring : Snapshot()) {
+			while (Ring->Tail.load(memory_order_acquire) != Ring->Head.load(memory_order_acquire)) {
+				this_thread::yield();
+			}
+		}
+	}
+
+	// 输出剩余日志并结束后台线程
+	void Stop() {
+		if (Drainer.joinable()) {
+			Stopping.store(true, memory_order_release);
+			Drainer.join();
+		}
+	}
+
+private:
+	chrono::steady_clock::time_point StartTime; // 时间戳的起点
+	const uint64_t Id; // 实例编号，线程缓存的缓冲区按它核对（地址可能被之后的实例复用）
+	mutex SyncLock; // Sync 模式的输出锁
+	mutex RegistryLock; // 保护 Rings 和后台线程的启动
+	vector<unique_ptr<LogRing>> Rings; // 所有线程的缓冲区，线程结束后仍保留到输出完毕
+	thread Drainer; // 后台输出线程
+	vector<string> Rendered; // 文本模式下展开结构化记录用的缓冲区，只由后台线程使用，容量重复利用
+	atomic<bool> Stopping{ false }; // 通知后台线程输出完剩余日志后退出
+
+	// 分配实例编号，从 1 开始
+	static uint64_t NewId() {
+		static atomic<uint64_t> Next{ 0 };
+		return ++Next;
+	}
+
+	// 当前线程在本实例中的缓冲区，第一次写日志时注册，并在需要时启动后台线程。
+	// 线程只缓存最近使用的实例和缓冲区，按实例编号核对；同一线程交替使用多个实例时，
+	// 缓存不命中就在本实例已注册的缓冲区中按线程查找，不会写进其他实例的缓冲区
+	LogRing& LocalRing() {
+		thread_local uint64_t CachedLog = 0;
+		thread_local LogRing* Ring = nullptr;
+		if (CachedLog != Id) {
+			lock_guard<mutex> Guard(RegistryLock);
+			Ring = nullptr;
+			for (auto& Existing : Rings) {
+				if (Existing->Owner == this_thread::get_id()) {
+					Ring = Existing.get();
+					break;
+				}
+			}
+			if (Ring == nullptr) {
+				Rings.push_back(unique_ptr<LogRing>(new LogRing()));
+				Ring = Rings.back().get();
+				Ring->Thread = (uint16_t)(Rings.size() - 1);
+				Ring->Owner = this_thread::get_id();
+			}
+			CachedLog = Id;
+			if (!Drainer.joinable()) {
+				cout.flush(); // 之前直接写 cout 的内容先输出，保证先后顺序
+				Drainer = thread([this]() { DrainLoop(); });
+			}
+		}
+		return *Ring;
+	}
+
+	// 把一条记录写入本线程的缓冲区：二进制模式为记录头加消息；文本模式下文本为消息加换行，
+	// 结构化记录（Format 为 1）为 LOG_EVENT_MARKER 加 LogEvent
+	// Stop 之后后台线程已经退出，记录改为直接输出（见 WriteDirect）
+	void Append(LogLevel L, uint8_t Format, const void* Data, size_t Length, const char* Newline) {
+		if (Stopping.load(memory_order_acquire)) {
+			WriteDirect(L, Format, Data, Length);
+			return;
+		}
+		LogRing& Ring = LocalRing();
+		size_t Overhead = Mode == LogMode::Binary ? sizeof(LogRecordHeader) : 1;
+
+		// 等待消费者腾出空间（只在后台线程跟不上时发生）；等待期间开始停止的，不再等消费者
+		uint64_t Head = Ring.Head.load(memory_order_relaxed);
+		while (LOG_RING_BYTES - (Head - Ring.Tail.load(memory_order_acquire)) < Length + Overhead) {
+			if (Stopping.load(memory_order_acquire)) {
+				WriteDirect(L, Format, Data, Length);
+				return;
+			}
+			this_thread::yield();
+		}
+
+		if (Mode == LogMode::Binary) {
+			LogRecordHeader Header = MakeHeader(L, Format, Length, Ring.Thread);
+			Head = CopyIn(Ring, Head, &Header, sizeof(Header));
+			Head = CopyIn(Ring, Head, Data, Length);
+		}
+		else if (Format == 1) {
+			char Marker = LOG_EVENT_MARKER;
+			Head = CopyIn(Ring, Head, &Marker, 1);
+			Head = CopyIn(Ring, Head, Data, Length);
+		}
+		else {
+			Head = CopyIn(Ring, Head, Data, Length);
+			Head = CopyIn(Ring, Head, Newline, 1);
+		}
+
+		// 整条记录写完后才发布
+		Ring.Head.store(Head, memory_order_release);
+	}
+
+	// 二进制模式的记录头
+	LogRecordHeader MakeHeader(LogLevel L, uint8_t Format, size_t Length, uint16_t Thread) const {
+		LogRecordHeader Header;
+		Header.Time = (uint64_t)chrono::duration_cast<chrono::nanoseconds>(
+			chrono::steady_clock::now() - StartTime).count();
+		Header.Length = (uint32_t)Length;
+		Header.Thread = Thread;
+		Header.Level = (uint8_t)L;
+		Header.Format = Format;
+		return Header;
+	}
+
+	// 不经过缓冲区，加锁后直接写标准输出，格式与后台线程输出的相同。
+	// 用于 Stop 之后的记录：后台线程已经退出，写进缓冲区的记录不会再被输出，缓冲区满时还会永远等待
+	void WriteDirect(LogLevel L, uint8_t RecordFormat, const void* Data, size_t Length) {
+		lock_guard<mutex> Guard(SyncLock);
+		if (Mode == LogMode::Binary) {
+			LogRecordHeader Header = MakeHeader(L, RecordFormat, Length, 0);
+			iovec Segments[2] = { { &Header, sizeof(Header) }, { const_cast<void*>(Data), Length } };
+			WriteAll(Segments, 2);
+			return;
+		}
+		string Text;
+		if (RecordFormat == 1) {
+			Format(*(const LogEvent*)Data, Text);
+		}
+		else {
+			Text.assign((const char*)Data, Length);
+		}
+		Text += '\n';
+		iovec Segment = { &Text[0], Text.size() };
+		WriteAll(&Segment, 1);
+	}
+
+	// 格式化一条结构化记录，没有设置 Formatter 时只输出类型和参数
+	void Format(const LogEvent& Event, string& Out) const {
+		if (Formatter != nullptr) {
+			Formatter(Event, Out);
+			return;
+		}
+		Out += "事件 " + to_string(Event.Kind) + " " + to_string(Event.Source) + " " + to_string(Event.Subject) +
+			" " + to_string(Event.Values[0]) + " " + to_string(Event.Values[1]);
+	}
+
+	// 把 Length 字节拷贝到环中 Head 处，处理回绕，返回新的 Head
+	static uint64_t CopyIn(LogRing& Ring, uint64_t Head, const void* Data, size_t Length) {
+		size_t Offset = Head % LOG_RING_BYTES;
+		size_t First = min(Length, (size_t)LOG_RING_BYTES - Offset);
+		memcpy(Ring.Buffer + Offset, Data, First);
+		memcpy(Ring.Buffer, (const char*)Data + First, Length - First);
+		return Head + Length;
+	}
+
+	// 从环中 Tail 处拷出 Length 字节，处理回绕
+	static void CopyOut(const LogRing& Ring, uint64_t Tail, void* Data, size_t Length) {
+		size_t Offset = Tail % LOG_RING_BYTES;
+		size_t First = min(Length, (size_t)LOG_RING_BYTES - Offset);
+		memcpy(Data, Ring.Buffer + Offset, First);
+		memcpy((char*)Data + First, Ring.Buffer, Length - First);
+	}
+
+	// 在环的 [From, To) 中找第一个结构化记录的起始字节，没有返回 To
+	static uint64_t FindMarker(const LogRing& Ring, uint64_t From, uint64_t To) {
+		while (From < To) {
+			size_t Offset = From % LOG_RING_BYTES;
+			size_t Span = min(To - From, (uint64_t)(LOG_RING_BYTES - Offset));
+			const void* Found = memchr(Ring.Buffer + Offset, LOG_EVENT_MARKER, Span);
+			if (Found != nullptr) {
+				return From + ((const char*)Found - (Ring.Buffer + Offset));
+			}
+			From += Span;
+		}
+		return To;
+	}
+
+	// 文本模式下把 [Tail, Head) 展开成文本：文本原样拷贝，结构化记录格式化成一行
+	void Render(const LogRing& Ring, uint64_t Tail, uint64_t Head, string& Out) const {
+		while (Tail < Head) {
+			uint64_t Marker = FindMarker(Ring, Tail, Head);
+			size_t Length = Marker - Tail;
+			size_t Old = Out.size();
+			Out.resize(Old + Length);
+			CopyOut(Ring, Tail, &Out[Old], Length);
+			Tail = Marker;
+			if (Tail < Head) {
+				LogEvent Event;
+				CopyOut(Ring, Tail + 1, &Event, sizeof(Event));
+				Format(Event, Out);
+				Out += '\n';
+				Tail += 1 + sizeof(Event);
+			}
+		}
+	}
+
+	// 当前已注册的缓冲区
+	vector<LogRing*> Snapshot() {
+		lock_guard<mutex> Guard(RegistryLock);
+		vector<LogRing*> Result;
+		for (auto& Ring : Rings) {
+			Result.push_back(Ring.get());
+		}
+		return Result;
+	}
+
+	// 后台线程：反复批量输出，收到停止通知后把剩余日志输出完再退出
+	void DrainLoop() {
+		while (true) {
+			bool Last = Stopping.load(memory_order_acquire);
+			if (DrainOnce() == 0) {
+				if (Last) {
+					break;
+				}
+				this_thread::sleep_for(chrono::microseconds(LOG_DRAIN_IDLE_US));
+			}
+		}
+	}
+
+	// 收集所有缓冲区中已发布的区段，用一次 writev 输出，返回输出的字节数。
+	// 文本模式下含结构化记录的区段先展开成文本，只含文本的区段直接从环中输出
+	size_t DrainOnce() {
+		vector<LogRing*> Sources = Snapshot();
+		iovec Segments[LOG_MAX_IOVECS];
+		vector<pair<LogRing*, uint64_t>> Consumed; // 每个缓冲区输出后的新 Tail
+		if (Rendered.size() < Sources.size()) {
+			Rendered.resize(Sources.size()); // 每个缓冲区一个，输出前不再移动
+		}
+		size_t Used = 0;
+		int Count = 0;
+		size_t Total = 0;
+
+		for (LogRing* Ring : Sources) {
+			if (Count + 2 > LOG_MAX_IOVECS) {
+				break; // 剩下的留到下一批
+			}
+			uint64_t Tail = Ring->Tail.load(memory_order_relaxed);
+			uint64_t Head = Ring->Head.load(memory_order_acquire);
+			if (Head == Tail) {
+				continue;
+			}
+			if (Mode == LogMode::Text && FindMarker(*Ring, Tail, Head) != Head) {
+				string& Text = Rendered[Used++];
+				Text.clear(); // 保留上次的容量
+				Render(*Ring, Tail, Head, Text);
+				Segments[Count++] = iovec{ &Text[0], Text.size() };
+				Consumed.push_back({ Ring, Head });
+				Total += Head - Tail;
+				continue;
+			}
+			// 回绕时分成两段
+			size_t Offset = Tail % LOG_RING_BYTES;
+			size_t Length = Head - Tail;
+			size_t First = min(Length, (size_t)LOG_RING_BYTES - Offset);
+			Segments[Count++] = iovec{ Ring->Buffer + Offset, First };
+			if (Length > First) {
+				Segments[Count++] = iovec{ Ring->Buffer, Length - First };
+			}
+			Consumed.push_back({ Ring, Head });
+			Total += Length;
+		}
+
+		if (Count > 0) {
+			WriteAll(Segments, Count);
+		}
+		for (auto& Item : Consumed) {
+			Item.first->Tail.store(Item.second, memory_order_release);
+		}
+		return Total;
+	}
+
+	// writev 到标准输出，处理部分写入和信号中断
+	static void WriteAll(iovec* Segments, int Count) {
+		while (Count > 0) {
+			ssize_t Written = writev(STDOUT_FILENO, Segments, Count);
+			if (Written < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				return; // 输出失败时丢弃这一批，避免写日志的线程永远等待
+			}
+			while (Count > 0 && (size_t)Written >= Segments->iov_len) {
+				Written -= Segments->iov_len;
+				Segments++;
+				Count--;
+			}
+			if (Count > 0) {
+				Segments->iov_base = (char*)Segments->iov_base + Written;
+				Segments->iov_len -= Written;
+			}
+		}
+	}
+};
@@ -0,0 +1,180 @@
+﻿#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <mutex>
+#include <atomic>
+
+using namespace std;
+
+#define CACHE_LINE_SHIFT 6 // 缓存行 64 字节
+#define TLB_ENTRIES 64 // TLB 表项数
+#define TLB_WAYS 4 // TLB 相联度
+#define L1_CACHE_LINES 512 // L1 数据缓存行数（32 KB）
+#define L1_CACHE_WAYS 8 // L1 相联度
+#define L2_CACHE_LINES 16384 // L2 缓存行数（1 MB）
+#define L2_CACHE_WAYS 16 // L2 相联度
+#define ACCESS_CYCLES 1 // 只模拟 TLB 时每次访问的基本周期数
+#define TLB_MISS_CYCLES 30 // TLB 缺失时查页表的周期数
+#define L1_HIT_CYCLES 4 // L1 命中延迟
+#define L2_HIT_CYCLES 14 // L2 命中延迟
+#define MEMORY_CYCLES 200 // 访问内存的延迟
+#define TLB_SHOOTDOWN_RESERVE 64 // 每个 CPU 预留的待处理 TLB 击落请求数
+#define PAGE_FAULT_CYCLES 5000 // 访问的页面不在内存中时，缺页处理（分配页框、必要时读回交换文件）的周期数
+
+// 组相联缓存，组内按最近使用时间替换（LRU）。
+// 只记录标签不保存数据：缓存用物理地址的行号做键，TLB 用（地址空间，虚拟页号）做键。
+// 组数取不小于 Entries / Ways 的 2 的幂，用键的低位选组
+class SetAssociativeCache
+{
+public:
+	long long Hits = 0; // 命中次数
+	long long Misses = 0; // 缺失次数
+
+	// 设置容量并清空
+	void Init(long long Entries, int Ways) {
+		this->Ways = Ways;
+		Sets = 1;
+		while (Sets * Ways < (uint64_t)Entries) {
+			Sets *= 2;
+		}
+		Lines.assign(Sets * Ways, Line());
+		Clock = 0;
+		Hits = 0;
+		Misses = 0;
+	}
+
+	// 访问一个键，命中返回 1；缺失时替换组内最久未用的一路并返回 0
+	bool Access(uint64_t Key) {
+		Line* Set = &Lines[(Key & (Sets - 1)) * Ways];
+		Line* Oldest = Set;
+		Clock++;
+		for (int w = 0; w < Ways; w++) {
+			if (Set[w].Valid && Set[w].Key == Key) {
+				Set[w].LastUse = Clock;
+				Hits++;
+				return 1;
+			}
+			if (!Set[w].Valid || (Oldest->Valid && Set[w].LastUse < Oldest->LastUse)) {
+				Oldest = &Set[w];
+			}
+		}
+		*Oldest = Line{ Key, Clock, true };
+		Misses++;
+		return 0;
+	}
+
+	// 使一个键失效，不在缓存中时什么也不做
+	void Invalidate(uint64_t Key) {
+		Line* Set = &Lines[(Key & (Sets - 1)) * Ways];
+		for (int w = 0; w < Ways; w++) {
+			if (Set[w].Valid && Set[w].Key == Key) {
+				Set[w].Valid = false;
+			}
+		}
+	}
+
+	// 缺失率（%）
+	double MissRate() const {
+		return Hits + Misses > 0 ? 100.0 * Misses / (Hits + Misses) : 0;
+	}
+
+private:
+	struct Line
+	{
+		uint64_t Key = 0; // 标签
+		uint64_t LastUse = 0; // 最近一次使用的时刻
+		bool Valid = false; // 是否有效
+	};
+
+	vector<Line> Lines; // Sets 组，每组 Ways 路
+	uint64_t Sets = 1; // 组数
+	int Ways = 1; // 相联度
+	uint64_t Clock = 0; // 访问计数，作为 LRU 的时间
+};
+
+// 一个 CPU 的访存模型：TLB，加上可选的 L1、L2 缓存，累计模拟的周期数
+struct MemoryHierarchy
+{
+	bool Enabled = false; // 是否模拟
+	bool CachesEnabled = false; // 是否模拟 L1、L2（否则只模拟 TLB）
+	SetAssociativeCache Tlb; // TLB
+	SetAssociativeCache L1; // L1 数据缓存
+	SetAssociativeCache L2; // L2 缓存
+	long long Accesses = 0; // 访问次数
+	long long Cycles = 0; // 模拟的周期数
+	long long PageFaults = 0; // 访问时页面不在内存中的次数
+	long long Shootdowns = 0; // 处理的 TLB 击落请求数
+
+	// 按默认参数初始化
+	void Init(bool Caches) {
+		Enabled = true;
+		CachesEnabled = Caches;
+		Tlb.Init(TLB_ENTRIES, TLB_WAYS);
+		L1.Init(L1_CACHE_LINES, L1_CACHE_WAYS);
+		L2.Init(L2_CACHE_LINES, L2_CACHE_WAYS);
+		Accesses = 0;
+		Cycles = 0;
+		PageFaults = 0;
+		Shootdowns = 0;
+		PendingShootdowns.reserve(TLB_SHOOTDOWN_RESERVE);
+	}
+
+	// TLB 击落（其他 CPU 调用）：键 FirstKey 起的 Count 个连续键所在的页不再有效，
+	// 请求先放进待处理列表，本 CPU 在下一次访问前处理，相当于处理器间中断
+	void Shootdown(uint64_t FirstKey, uint64_t Count) {
+		lock_guard<mutex> Guard(ShootdownLock);
+		PendingShootdowns.push_back({ FirstKey, Count });
+		ShootdownPending.store(true, memory_order_release);
+	}
+
+	// 访问的页面不在内存中：计入缺页处理的周期，页面装入后的访问仍由 Access 计算
+	void Fault() {
+		PageFaults++;
+		Cycles += PAGE_FAULT_CYCLES;
+	}
+
+	// 一次访问：TlbKey 标识所在的页（含地址空间），PhysicalAddress 为翻译后的物理地址，返回花费的周期数
+	long long Access(uint64_t TlbKey, uint64_t PhysicalAddress) {
+		if (ShootdownPending.load(memory_order_acquire)) {
+			ApplyShootdowns();
+		}
+		long long Cost = Tlb.Access(TlbKey) ? 0 : TLB_MISS_CYCLES;
+		if (!CachesEnabled) {
+			Cost += ACCESS_CYCLES;
+		}
+		else {
+			uint64_t Block = PhysicalAddress >> CACHE_LINE_SHIFT;
+			if (L1.Access(Block)) {
+				Cost += L1_HIT_CYCLES;
+			}
+			else if (L2.Access(Block)) {
+				Cost += L2_HIT_CYCLES;
+			}
+			else {
+				Cost += MEMORY_CYCLES;
+			}
+		}
+		Accesses++;
+		Cycles += Cost;
+		return Cost;
+	}
+
+private:
+	mutex ShootdownLock; // 保护待处理的击落请求
+	vector<pair<uint64_t, uint64_t>> PendingShootdowns; // 待处理的（首个键，键数）
+	atomic<bool> ShootdownPending{ false }; // 有待处理的请求，访问时不用加锁就能判断
+
+	// 处理其他 CPU 发来的击落请求
+	void ApplyShootdowns() {
+		lock_guard<mutex> Guard(ShootdownLock);
+		for (auto& Request : PendingShootdowns) {
+			for (uint64_t k = 0; k < Request.second; k++) {
+				Tlb.Invalidate(Request.first + k);
+			}
+			Shootdowns++;
+		}
+		PendingShootdowns.clear();
+		ShootdownPending.store(false, memory_order_relaxed);
+	}
+};
@@ -0,0 +1,225 @@
+﻿#pragma once
+
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <algorithm>
+
+using namespace std;
+
+// 两级页面占用位图
+// 第一级每个 64 位字记录 64 个页面是否被占用（1 为占用），
+// 第二级（摘要）每一位记录对应的第一级字是否已全部占用，搜索空闲页时整字跳过已满区域。
+// 找空闲页和找占用页都用 ctz 在字内定位，因此查找 N 个连续空闲页是逐字扫描而不是逐页扫描。
+// 所有字都是原子变量：持有外部锁时按普通位图使用；不加锁时可先乐观搜索，
+// 再用 TryClaimRange 以 CAS 逐字占用，失败时回滚，由调用者重新搜索。
+class PageBitmap
+{
+public:
+	// 初始化为 Count 个空闲页面；末尾不足一个字的多余位视为占用，保证永远不会被分配
+	void Init(long long Count) {
+		Pages = Count;
+		WordCount = (Count + 63) / 64;
+		SummaryCount = (WordCount + 63) / 64;
+		Words.reset(new atomic<uint64_t>[WordCount]);
+		Summary.reset(new atomic<uint64_t>[SummaryCount]);
+		for (long long w = 0; w < WordCount; w++) {
+			Words[w].store(0, memory_order_relaxed);
+		}
+		for (long long w = 0; w < SummaryCount; w++) {
+			Summary[w].store(0, memory_order_relaxed);
+		}
+		if (Count % 64 != 0) {
+			Words[WordCount - 1].store(~0ULL << (Count % 64), memory_order_relaxed);
+			UpdateSummary(WordCount - 1);
+		}
+	}
+
+	// 页面总数
+	long long PageCount() const {
+		return Pages;
+	}
+
+	// 单个页面是否空闲
+	bool IsFree(long long Page) const {
+		return (Load(Page >> 6) & (1ULL << (Page & 63))) == 0;
+	}
+
+	// [First, First + Count) 是否全部空闲
+	bool IsRangeFree(long long First, long long Count) const {
+		return NextOccupied(First, First + Count) < 0;
+	}
+
+	// 把 [First, First + Count) 标记为占用
+	void SetRange(long long First, long long Count) {
+		ForEachWord(First, Count, [this](long long w, uint64_t Mask) {
+			Words[w].fetch_or(Mask);
+			UpdateSummary(w);
+			return true;
+		});
+	}
+
+	// 把 [First, First + Count) 标记为空闲
+	void ClearRange(long long First, long long Count) {
+		ForEachWord(First, Count, [this](long long w, uint64_t Mask) {
+			Words[w].fetch_and(~Mask);
+			UpdateSummary(w);
+			return true;
+		});
+	}
+
+	// 不加锁地占用 [First, First + Count)：逐字 CAS，只要有一位已被占用就回滚已占用的字
+	// 返回是否占用成功
+	bool TryClaimRange(long long First, long long Count) {
+		long long Claimed = First; // [First, Claimed) 已成功占用
+		bool Success = ForEachWord(First, Count, [this, &Claimed](long long w, uint64_t Mask) {
+			uint64_t Expected = Words[w].load();
+			do {
+				if ((Expected & Mask) != 0) {
+					return false; // 被其他线程抢先
+				}
+			} while (!Words[w].compare_exchange_weak(Expected, Expected | Mask));
+			UpdateSummary(w);
+			Claimed += __builtin_popcountll(Mask);
+			return true;
+		});
+		if (!Success && Claimed > First) {
+			ClearRange(First, Claimed - First);
+		}
+		return Success;
+	}
+
+	// 在 [From, Limit) 内查找第一个起始页号按 Align 对齐、长度为 Count 的空闲页段
+	// 返回起始页号，找不到返回 -1
+	long long FindFreeRun(long long Count, long long Align, long long From, long long Limit) const {
+		long long Page = RoundUp(From, Align);
+		while (Page + Count <= Limit) {
+			// 跳到下一个空闲页，再对齐
+			long long Free = NextFree(Page);
+			if (Free < 0) {
+				return -1;
+			}
+			Page = RoundUp(Free, Align);
+			if (Page + Count > Limit) {
+				return -1;
+			}
+
+			// 检查整段是否空闲，否则从第一个占用页之后继续
+			long long Occupied = NextOccupied(Page, Page + Count);
+			if (Occupied < 0) {
+				return Page;
+			}
+			Page = RoundUp(Occupied + 1, Align);
+		}
+		return -1;
+	}
+
+	// 空闲页面数
+	long long CountFree() const {
+		long long Used = 0;
+		for (long long w = 0; w < WordCount; w++) {
+			Used += __builtin_popcountll(Load(w));
+		}
+		long long Padding = WordCount * 64 - Pages;
+		return Pages - (Used - Padding);
+	}
+
+	// 位图本身占用的字节数
+	long long FootprintBytes() const {
+		return (WordCount + SummaryCount) * (long long)sizeof(uint64_t);
+	}
+
+private:
+	unique_ptr<atomic<uint64_t>[]>Words; // 第一级：每位一个页面
+	unique_ptr<atomic<uint64_t>[]>Summary; // 第二级：每位一个第一级字，1 表示该字已满
+	long long WordCount = 0; // 第一级字数
+	long long SummaryCount = 0; // 第二级字数
+	long long Pages = 0; // 页面总数
+
+	uint64_t Load(long long w) const {
+		return Words[w].load(memory_order_relaxed);
+	}
+
+	static long long RoundUp(long long Value, long long Align) {
+		return (Value + Align - 1) / Align * Align;
+	}
+
+	// 根据第一级字是否已满更新摘要位
+	// 置满标记后再读一次该字：若期间有其他线程释放了页面就撤销标记，保证摘要不会把有空位的字标成已满
+	void UpdateSummary(long long w) {
+		uint64_t Bit = 1ULL << (w & 63);
+		if (Words[w].load() == ~0ULL) {
+			Summary[w >> 6].fetch_or(Bit);
+			if (Words[w].load() != ~0ULL) {
+				Summary[w >> 6].fetch_and(~Bit);
+			}
+		}
+		else {
+			Summary[w >> 6].fetch_and(~Bit);
+		}
+	}
+
+	// 把 [First, First + Count) 拆成若干 (字下标, 字内掩码) 依次交给 Apply，Apply 返回 false 时停止
+	// 返回是否处理完整个区间
+	template <typename F>
+	static bool ForEachWord(long long First, long long Count, F Apply) {
+		long long End = First + Count;
+		while (First < End) {
+			long long w = First >> 6;
+			long long Bit = First & 63;
+			long long Bits = min(64 - Bit, End - First);
+			uint64_t Mask = (Bits == 64) ? ~0ULL : (((1ULL << Bits) - 1) << Bit);
+			if (!Apply(w, Mask)) {
+				return false;
+			}
+			First += Bits;
+		}
+		return true;
+	}
+
+	// 从 Page 开始的第一个空闲页，没有返回 -1
+	long long NextFree(long long Page) const {
+		if (Page >= Pages) {
+			return -1;
+		}
+		long long w = Page >> 6;
+		uint64_t Candidates = ~Load(w) & (~0ULL << (Page & 63));
+		if (Candidates != 0) {
+			return w * 64 + __builtin_ctzll(Candidates);
+		}
+
+		// 借助摘要跳过已满的字
+		for (long long Next = w + 1; Next < WordCount; ) {
+			uint64_t NotFull = ~Summary[Next >> 6].load(memory_order_relaxed) & (~0ULL << (Next & 63));
+			if (NotFull == 0) {
+				Next = ((Next >> 6) + 1) << 6;
+				continue;
+			}
+			long long Found = ((Next >> 6) << 6) + __builtin_ctzll(NotFull);
+			if (Found >= WordCount) {
+				return -1;
+			}
+			uint64_t FreeBits = ~Load(Found);
+			if (FreeBits == 0) {
+				Next = Found + 1; // 并发占用后摘要尚未更新，继续向后找
+				continue;
+			}
+			return Found * 64 + __builtin_ctzll(FreeBits);
+		}
+		return -1;
+	}
+
+	// [Page, End) 内的第一个占用页，没有返回 -1
+	long long NextOccupied(long long Page, long long End) const {
+		while (Page < End) {
+			long long w = Page >> 6;
+			uint64_t Occupied = Load(w) & (~0ULL << (Page & 63));
+			if (Occupied != 0) {
+				long long Found = w * 64 + __builtin_ctzll(Occupied);
+				return Found < End ? Found : -1;
+			}
+			Page = (w + 1) * 64;
+		}
+		return -1;
+	}
+};
@@ -0,0 +1,397 @@
+﻿#pragma once
+
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+using namespace std;
+
+#define AGING_INTERVAL 64 // LRU 近似：每多少次访问把所有页面的年龄右移一位
+
+// 页面置换策略
+enum class ReplacementKind
+{
+	Fifo, // 先进先出
+	Clock, // 时钟（二次机会）
+	Lru, // 老化计数器近似 LRU
+	Arc // 自适应替换缓存
+};
+
+// 页面置换策略：记录哪些页面常驻内存，缺页而没有空闲页框时选出被淘汰的页面。
+// 页面由调用者给出的非 0 键标识（例如地址空间编号和虚拟页号拼成的 64 位数）。
+// 不是线程安全的，调用者需自己加锁。
+class ReplacementPolicy
+{
+public:
+	virtual ~ReplacementPolicy() = default;
+
+	// 策略名称，用于输出
+	virtual string Name() const = 0;
+
+	// 页面装入内存后调用
+	virtual void Admit(uint64_t Key) = 0;
+
+	// 常驻页面被访问时调用
+	virtual void Access(uint64_t Key) = 0;
+
+	// 选出一个常驻页面并把它移出常驻集合，返回它的键，没有常驻页面时返回 0
+	// Incoming 是即将装入的页面，只有 ARC 用它调整目标
+	virtual uint64_t Evict(uint64_t Incoming) = 0;
+
+	// 页面所属的地址空间已销毁，从所有记录（包括 ARC 的历史）中删除
+	virtual void Forget(uint64_t Key) = 0;
+};
+
+// 先进先出：淘汰最早装入的页面，不关心访问
+class FifoPolicy : public ReplacementPolicy
+{
+public:
+	string Name() const override {
+		return "FIFO";
+	}
+
+	void Admit(uint64_t Key) override {
+		Order.push_back(Key);
+		Where[Key] = prev(Order.end());
+	}
+
+	void Access(uint64_t) override {}
+
+	uint64_t Evict(uint64_t) override {
+		if (Order.empty()) {
+			return 0;
+		}
+		uint64_t Key = Order.front();
+		Order.pop_front();
+		Where.erase(Key);
+		return Key;
+	}
+
+	void Forget(uint64_t Key) override {
+		auto Found = Where.find(Key);
+		if (Found != Where.end()) {
+			Order.erase(Found->second);
+			Where.erase(Found);
+		}
+	}
+
+private:
+	list<uint64_t> Order; // 按装入顺序排列
+	unordered_map<uint64_t, list<uint64_t>::iterator> Where; // 键在 Order 中的位置
+};
+
+// 时钟：常驻页面排成一圈，指针扫过时清除访问位，淘汰第一个访问位已清除的页面
+class ClockPolicy : public ReplacementPolicy
+{
+public:
+	string Name() const override {
+		return "CLOCK";
+	}
+
+	void Admit(uint64_t Key) override {
+		size_t Index = TakeSlot();
+		Ring[Index] = Slot{ Key, true };
+		Where[Key] = Index;
+	}
+
+	void Access(uint64_t Key) override {
+		Ring[Where[Key]].Referenced = true;
+	}
+
+	uint64_t Evict(uint64_t) override {
+		if (Where.empty()) {
+			return 0;
+		}
+		while (true) {
+			Slot& Candidate = Ring[Hand];
+			Hand = (Hand + 1) % Ring.size();
+			if (Candidate.Key == 0) {
+				continue; // 空位
+			}
+			if (Candidate.Referenced) {
+				Candidate.Referenced = false; // 给第二次机会
+				continue;
+			}
+			uint64_t Key = Candidate.Key;
+			ReleaseSlot(Key);
+			return Key;
+		}
+	}
+
+	void Forget(uint64_t Key) override {
+		if (Where.count(Key) != 0) {
+			ReleaseSlot(Key);
+		}
+	}
+
+private:
+	struct Slot
+	{
+		uint64_t Key = 0; // 0 表示空位
+		bool Referenced = false; // 访问位
+	};
+
+	vector<Slot> Ring; // 时钟圈
+	vector<size_t> FreeSlots; // 空位下标
+	unordered_map<uint64_t, size_t> Where; // 键所在的位置
+	size_t Hand = 0; // 时钟指针
+
+	size_t TakeSlot() {
+		if (!FreeSlots.empty()) {
+			size_t Index = FreeSlots.back();
+			FreeSlots.pop_back();
+			return Index;
+		}
+		Ring.push_back(Slot());
+		return Ring.size() - 1;
+	}
+
+	void ReleaseSlot(uint64_t Key) {
+		size_t Index = Where[Key];
+		Where.erase(Key);
+		Ring[Index] = Slot();
+		FreeSlots.push_back(Index);
+	}
+};
+
+// 老化计数器近似 LRU：每个页面有 8 位年龄，每 AGING_INTERVAL 次访问所有年龄右移一位并把访问位移入最高位，
+// 淘汰年龄最小的页面。右移是惰性的：记下每个页面上次更新时的周期，用到时再补齐，
+// 这样访问是常数时间，只有淘汰需要扫描（遇到年龄为 0 的页面立即停止）
+class LruPolicy : public ReplacementPolicy
+{
+public:
+	string Name() const override {
+		return "LRU（老化近似）";
+	}
+
+	void Admit(uint64_t Key) override {
+		size_t Index = TakeSlot();
+		Ring[Index] = Slot{ Key, 0, true, Epoch };
+		Where[Key] = Index;
+		Advance();
+	}
+
+	void Access(uint64_t Key) override {
+		Slot& Page = Ring[Where[Key]];
+		Age(Page);
+		Page.Referenced = true;
+		Advance();
+	}
+
+	uint64_t Evict(uint64_t) override {
+		if (Where.empty()) {
+			return 0;
+		}
+		// 从上次停下的位置开始扫描，年龄相同时依次淘汰不同的页面
+		size_t Best = Ring.size();
+		unsigned BestValue = ~0U;
+		for (size_t n = 0; n < Ring.size(); n++) {
+			size_t Index = (Hand + n) % Ring.size();
+			Slot& Page = Ring[Index];
+			if (Page.Key == 0) {
+				continue;
+			}
+			Age(Page);
+			unsigned Value = ((unsigned)Page.Referenced << 8) | Page.Counter; // 本周期访问过的比任何年龄都新
+			if (Value < BestValue) {
+				Best = Index;
+				BestValue = Value;
+				if (Value == 0) {
+					break;
+				}
+			}
+		}
+		Hand = (Best + 1) % Ring.size();
+		uint64_t Key = Ring[Best].Key;
+		ReleaseSlot(Key);
+		return Key;
+	}
+
+	void Forget(uint64_t Key) override {
+		if (Where.count(Key) != 0) {
+			ReleaseSlot(Key);
+		}
+	}
+
+private:
+	struct Slot
+	{
+		uint64_t Key = 0; // 0 表示空位
+		uint8_t Counter = 0; // 年龄，越大越近被访问过
+		bool Referenced = false; // 当前周期是否访问过
+		uint64_t Epoch = 0; // 上次更新年龄时的周期
+	};
+
+	vector<Slot> Ring; // 所有页面
+	vector<size_t> FreeSlots; // 空位下标
+	unordered_map<uint64_t, size_t> Where; // 键所在的位置
+	size_t Hand = 0; // 下次淘汰扫描的起点
+	uint64_t Epoch = 0; // 当前周期
+	uint64_t Accesses = 0; // 当前周期内的访问次数
+
+	// 补齐自上次更新以来错过的右移
+	void Age(Slot& Page) {
+		uint64_t Shifts = Epoch - Page.Epoch;
+		if (Shifts == 0) {
+			return;
+		}
+		unsigned Counter = (Page.Counter >> 1) | ((unsigned)Page.Referenced << 7);
+		Page.Counter = Shifts > 8 ? 0 : (uint8_t)(Counter >> (Shifts - 1));
+		Page.Referenced = false;
+		Page.Epoch = Epoch;
+	}
+
+	void Advance() {
+		if (++Accesses >= AGING_INTERVAL) {
+			Accesses = 0;
+			Epoch++;
+		}
+	}
+
+	size_t TakeSlot() {
+		if (!FreeSlots.empty()) {
+			size_t Index = FreeSlots.back();
+			FreeSlots.pop_back();
+			return Index;
+		}
+		Ring.push_back(Slot());
+		return Ring.size() - 1;
+	}
+
+	void ReleaseSlot(uint64_t Key) {
+		size_t Index = Where[Key];
+		Where.erase(Key);
+		Ring[Index] = Slot();
+		FreeSlots.push_back(Index);
+	}
+};
+
+// 自适应替换缓存（ARC，Megiddo 和 Modha）：常驻页面分成只访问过一次的 T1 和访问过多次的 T2，
+// 另外各保留一份最近被淘汰页面的历史 B1、B2（不占页框）。缺页的页面如果在 B1 中，说明 T1 给得太少，
+// 目标 P 增大；在 B2 中则 P 减小。淘汰时 T1 超过 P 就淘汰 T1 最久未用的页面，否则淘汰 T2 的。
+// 这样既能抵抗一次性的顺序扫描，又能在近期性和频率之间自动调整。Capacity 为页框总数
+class ArcPolicy : public ReplacementPolicy
+{
+public:
+	explicit ArcPolicy(long long Capacity) : Capacity(max(1LL, Capacity)) {}
+
+	string Name() const override {
+		return "ARC";
+	}
+
+	void Admit(uint64_t Key) override {
+		auto Found = Where.find(Key);
+		if (Found != Where.end()) {
+			// 历史命中：调整目标（Evict 已经调整过的不再重复），移入 T2
+			if (Key != Adapted) {
+				AdaptTarget(Found->second.first);
+			}
+			Remove(Found);
+			Push(T2Id, Key);
+		}
+		else {
+			// 全新页面：限制历史长度，|T1| + |B1| 不超过 Capacity，总数不超过 2 * Capacity
+			if (Size(T1Id) + Size(B1Id) >= Capacity && Size(B1Id) > 0) {
+				Drop(B1Id);
+			}
+			else if (Size(T1Id) + Size(T2Id) + Size(B1Id) + Size(B2Id) >= 2 * Capacity && Size(B2Id) > 0) {
+				Drop(B2Id);
+			}
+			Push(T1Id, Key);
+		}
+		Adapted = 0;
+	}
+
+	void Access(uint64_t Key) override {
+		auto Found = Where.find(Key);
+		Remove(Found);
+		Push(T2Id, Key); // 再次访问，移到 T2 最近端
+	}
+
+	uint64_t Evict(uint64_t Incoming) override {
+		if (Size(T1Id) + Size(T2Id) == 0) {
+			return 0;
+		}
+		// 原算法先根据缺页页面是否在历史中调整目标，再选择淘汰哪一边
+		auto Found = Where.find(Incoming);
+		bool InB2 = Found != Where.end() && Found->second.first == B2Id;
+		if (Found != Where.end() && Found->second.first != T1Id && Found->second.first != T2Id) {
+			AdaptTarget(Found->second.first);
+			Adapted = Incoming;
+		}
+
+		int From = T2Id;
+		if (Size(T1Id) > 0 && (Size(T1Id) > Target || (InB2 && Size(T1Id) == Target))) {
+			From = T1Id;
+		}
+		if (Size(From) == 0) {
+			From = From == T1Id ? T2Id : T1Id;
+		}
+		uint64_t Key = Lists[From].front();
+		Remove(Where.find(Key));
+		Push(From == T1Id ? B1Id : B2Id, Key); // 只保留历史
+		return Key;
+	}
+
+	void Forget(uint64_t Key) override {
+		auto Found = Where.find(Key);
+		if (Found != Where.end()) {
+			Remove(Found);
+		}
+	}
+
+private:
+	enum { T1Id, T2Id, B1Id, B2Id };
+	typedef unordered_map<uint64_t, pair<int, list<uint64_t>::iterator>> Index;
+
+	long long Capacity; // 页框总数
+	long long Target = 0; // T1 的目标长度 P
+	list<uint64_t> Lists[4]; // T1、T2、B1、B2，front 是最久未用的一端
+	Index Where; // 键所在的表和位置
+	uint64_t Adapted = 0; // Evict 已为其调整过目标的页面
+
+	long long Size(int Id) const {
+		return (long long)Lists[Id].size();
+	}
+
+	void AdaptTarget(int Id) {
+		if (Id == B1Id) {
+			Target = min(Capacity, Target + max(1LL, Size(B2Id) / max(1LL, Size(B1Id))));
+		}
+		else if (Id == B2Id) {
+			Target = max(0LL, Target - max(1LL, Size(B1Id) / max(1LL, Size(B2Id))));
+		}
+	}
+
+	void Push(int Id, uint64_t Key) {
+		Lists[Id].push_back(Key);
+		Where[Key] = { Id, prev(Lists[Id].end()) };
+	}
+
+	void Remove(Index::iterator Found) {
+		Lists[Found->second.first].erase(Found->second.second);
+		Where.erase(Found);
+	}
+
+	// 丢弃一份最旧的历史
+	void Drop(int Id) {
+		Remove(Where.find(Lists[Id].front()));
+	}
+};
+
+// 按种类创建置换策略，Capacity 为页框总数
+inline unique_ptr<ReplacementPolicy> MakeReplacementPolicy(ReplacementKind Kind, long long Capacity) {
+	switch (Kind) {
+	case ReplacementKind::Fifo:
+		return unique_ptr<ReplacementPolicy>(new FifoPolicy());
+	case ReplacementKind::Lru:
+		return unique_ptr<ReplacementPolicy>(new LruPolicy());
+	case ReplacementKind::Arc:
+		return unique_ptr<ReplacementPolicy>(new ArcPolicy(Capacity));
+	default:
+		return unique_ptr<ReplacementPolicy>(new ClockPolicy());
+	}
+}
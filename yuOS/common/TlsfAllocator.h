@@ -0,0 +1,186 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+
+using namespace std;
+
+#define TLSF_SL_LOG2 4 // 每个一级区间再分成 2^TLSF_SL_LOG2 个二级区间
+#define TLSF_SL_COUNT (1 << TLSF_SL_LOG2)
+#define TLSF_FL_COUNT 64 // 一级区间数，覆盖 64 位长度
+
+// 两级分离适配（TLSF）分配器
+// 空闲块按长度分到 (一级, 二级) 链表：一级是长度的最高位，二级是最高位之后的 TLSF_SL_LOG2 位。
+// 两级各有一个位图记录哪些链表非空，分配时把请求长度向上取到所在二级区间的上界，
+// 再用 ctz 找到第一个不小于它的非空链表，取链表头即可，链表里的块一定放得下，不需要遍历。
+// 释放时按起止地址找到前后相邻的空闲块立即合并。分配和释放都是常数次操作，
+// 因取整浪费的空间不超过请求的 1/2^TLSF_SL_LOG2，外部碎片也比按对齐槽位的首次适应小得多。
+// 地址和长度的单位由调用者决定（字节、16 字节或页面）；块的元数据保存在哈希表中，不占被管理的空间。
+// 不是线程安全的，调用者需自己加锁。
+class TlsfAllocator
+{
+public:
+	// 管理 [Base, Base + Length) 这一段，全部空闲
+	void Init(long long Base, long long Length) {
+		Blocks.clear();
+		StartOfEnd.clear();
+		FirstLevelMap = 0;
+		for (int f = 0; f < TLSF_FL_COUNT; f++) {
+			SecondLevelMap[f] = 0;
+			for (int s = 0; s < TLSF_SL_COUNT; s++) {
+				Heads[f][s] = -1;
+			}
+		}
+		if (Length > 0) {
+			InsertFree(Base, Length);
+		}
+	}
+
+	// 分配 Length 个单位，起始地址按 Align（2 的幂）对齐，返回起始地址，失败返回 -1
+	// Align 大于 1 时按 Length + Align - 1 查找，对齐前后剩下的部分放回
+	long long Allocate(long long Length, long long Align = 1) {
+		if (Length <= 0) {
+			return -1;
+		}
+		long long SearchLength = Length + Align - 1;
+		int FirstLevel, SecondLevel;
+		if (!FindSuitable(SearchLength, FirstLevel, SecondLevel)) {
+			// 没有更大的链表时，请求所在链表的头块也可能放得下（只看一个块，仍是常数时间）
+			Mapping(SearchLength, FirstLevel, SecondLevel);
+			long long Head = Heads[FirstLevel][SecondLevel];
+			if (Head < 0 || Blocks[Head].Length < SearchLength) {
+				return -1;
+			}
+		}
+		long long BlockStart = Heads[FirstLevel][SecondLevel];
+		long long BlockEnd = BlockStart + Blocks[BlockStart].Length;
+		long long Start = (BlockStart + Align - 1) & ~(Align - 1);
+		RemoveFree(BlockStart);
+		if (Start > BlockStart) {
+			InsertFree(BlockStart, Start - BlockStart);
+		}
+		if (BlockEnd > Start + Length) {
+			InsertFree(Start + Length, BlockEnd - Start - Length); // 剩余部分放回
+		}
+		return Start;
+	}
+
+	// 释放从 Start 开始的 Length 个单位，与前后相邻的空闲块合并
+	void Release(long long Start, long long Length) {
+		long long End = Start + Length;
+		auto Next = Blocks.find(End);
+		if (Next != Blocks.end()) {
+			Length += Next->second.Length;
+			RemoveFree(End);
+		}
+		auto Previous = StartOfEnd.find(Start);
+		if (Previous != StartOfEnd.end()) {
+			long long PreviousStart = Previous->second;
+			Length += Start - PreviousStart;
+			Start = PreviousStart;
+			RemoveFree(PreviousStart);
+		}
+		InsertFree(Start, Length);
+	}
+
+	// 空闲块数
+	long long FreeBlockCount() const {
+		return (long long)Blocks.size();
+	}
+
+private:
+	// 空闲块，按起始地址索引，同一链表中的块用起始地址双向链接
+	struct FreeBlock
+	{
+		long long Length = 0; // 长度
+		long long Previous = -1; // 链表中的前一个块，没有为 -1
+		long long Next = -1; // 链表中的后一个块，没有为 -1
+	};
+
+	unordered_map<long long, FreeBlock> Blocks; // 起始地址到空闲块
+	unordered_map<long long, long long> StartOfEnd; // 空闲块结束地址（不含）到起始地址，用于向前合并
+	uint64_t FirstLevelMap = 0; // 第 f 位表示一级区间 f 中有非空链表
+	uint32_t SecondLevelMap[TLSF_FL_COUNT]; // 第 s 位表示链表 (f, s) 非空
+	long long Heads[TLSF_FL_COUNT][TLSF_SL_COUNT]; // 每个链表的头块，空链表为 -1
+
+	static int HighestBit(uint64_t Value) {
+		return 63 - __builtin_clzll(Value);
+	}
+
+	// 长度所在的链表
+	static void Mapping(long long Length, int& FirstLevel, int& SecondLevel) {
+		if (Length < TLSF_SL_COUNT) {
+			FirstLevel = 0;
+			SecondLevel = (int)Length;
+			return;
+		}
+		int High = HighestBit((uint64_t)Length);
+		FirstLevel = High - TLSF_SL_LOG2 + 1;
+		SecondLevel = (int)(Length >> (High - TLSF_SL_LOG2)) - TLSF_SL_COUNT;
+	}
+
+	// 找到第一个其中每个块都不短于 Length 的非空链表，没有返回 0
+	bool FindSuitable(long long Length, int& FirstLevel, int& SecondLevel) const {
+		if (Length >= TLSF_SL_COUNT) {
+			Length += (1LL << (HighestBit((uint64_t)Length) - TLSF_SL_LOG2)) - 1; // 取到二级区间的上界
+		}
+		Mapping(Length, FirstLevel, SecondLevel);
+		if (FirstLevel >= TLSF_FL_COUNT) {
+			return 0;
+		}
+
+		// 先在同一个一级区间里找更大的二级链表，再找更大的一级区间
+		uint32_t SecondCandidates = SecondLevelMap[FirstLevel] & (~0U << SecondLevel);
+		if (SecondCandidates == 0) {
+			uint64_t FirstCandidates = FirstLevel + 1 < TLSF_FL_COUNT ? FirstLevelMap & (~0ULL << (FirstLevel + 1)) : 0;
+			if (FirstCandidates == 0) {
+				return 0;
+			}
+			FirstLevel = __builtin_ctzll(FirstCandidates);
+			SecondCandidates = SecondLevelMap[FirstLevel];
+		}
+		SecondLevel = __builtin_ctz(SecondCandidates);
+		return 1;
+	}
+
+	void InsertFree(long long Start, long long Length) {
+		int FirstLevel, SecondLevel;
+		Mapping(Length, FirstLevel, SecondLevel);
+		FreeBlock& Block = Blocks[Start];
+		Block.Length = Length;
+		Block.Previous = -1;
+		Block.Next = Heads[FirstLevel][SecondLevel];
+		if (Block.Next >= 0) {
+			Blocks[Block.Next].Previous = Start;
+		}
+		Heads[FirstLevel][SecondLevel] = Start;
+		StartOfEnd[Start + Length] = Start;
+		FirstLevelMap |= 1ULL << FirstLevel;
+		SecondLevelMap[FirstLevel] |= 1U << SecondLevel;
+	}
+
+	void RemoveFree(long long Start) {
+		auto Found = Blocks.find(Start);
+		FreeBlock Block = Found->second;
+		Blocks.erase(Found);
+		StartOfEnd.erase(Start + Block.Length);
+
+		int FirstLevel, SecondLevel;
+		Mapping(Block.Length, FirstLevel, SecondLevel);
+		if (Block.Previous >= 0) {
+			Blocks[Block.Previous].Next = Block.Next;
+		}
+		else {
+			Heads[FirstLevel][SecondLevel] = Block.Next;
+		}
+		if (Block.Next >= 0) {
+			Blocks[Block.Next].Previous = Block.Previous;
+		}
+		if (Heads[FirstLevel][SecondLevel] < 0) {
+			SecondLevelMap[FirstLevel] &= ~(1U << SecondLevel);
+			if (SecondLevelMap[FirstLevel] == 0) {
+				FirstLevelMap &= ~(1ULL << FirstLevel);
+			}
+		}
+	}
+};